@@ -16,6 +16,8 @@ pid_t producer_pids[MAX_CHILD_PROCESSES] = {0};
 pid_t consumer_pids[MAX_CHILD_PROCESSES] = {0};
 size_t active_producers_count = 0;
 size_t active_consumers_count = 0;
+// Формат сообщений новых производителей (наследуется при fork).
+uint8_t producer_msg_format = MSG_FORMAT_DJB2;
 
 
 static const char command_options_text[] = {
@@ -25,9 +27,17 @@ static const char command_options_text[] = {
     "[C] - Create Consumer Process\n"
     "[c] - Terminate Last Consumer Process\n"
     "[s] - Show Current Status\n"
+    "[f] - Toggle Checksum Format for New Producers (djb2/CRC32C)\n"
     "[q] - Quit Program"
 };
 
+static const char *checksum_format_name(uint8_t format) {
+    if (format == MSG_FORMAT_CRC32C) {
+        return crc32c_hardware() ? "CRC32C (SSE4.2)" : "CRC32C (table)";
+    }
+    return "djb2";
+}
+
 void display_current_status() {
     semaphore_wait(QUEUE_MUTEX_IDX);
 
@@ -37,6 +47,7 @@ void display_current_status() {
     printf("Messages in Buffer: %zu/%d\n", shared_queue_ptr->current_msg_count, BUFFER_CAPACITY);
     printf("Total Messages Added: %zu\n", shared_queue_ptr->total_added_count);
     printf("Total Messages Extracted: %zu\n", shared_queue_ptr->total_extracted_count);
+    printf("Checksum Format for New Producers: %s\n", checksum_format_name(producer_msg_format));
     printf("---------------------------\n");
 
     semaphore_signal(QUEUE_MUTEX_IDX);
@@ -104,6 +115,12 @@ int main(void) {
                     display_current_status();
                     break;
 
+                case 'f':
+                    producer_msg_format = producer_msg_format == MSG_FORMAT_DJB2 ? MSG_FORMAT_CRC32C
+                                                                                 : MSG_FORMAT_DJB2;
+                    printf("New producers will use %s checksums.\n", checksum_format_name(producer_msg_format));
+                    break;
+
                 case 'q':
                     system_cleanup();
                     configure_terminal_input(0);
@@ -0,0 +1,126 @@
+#include "shared_buffer_types.h"
+
+#include <time.h>
+
+// Определены в app.c; shared_buffer_types.o ссылается на них, но замер
+// очереди не трогает.
+QueueBuffer *shared_queue_ptr = NULL;
+int semaphore_set_id = -1;
+
+#define BENCH_MESSAGES 4096
+#define BENCH_ROUNDS 200
+
+// Прежняя побайтовая реализация compute_checksum - эталон для сверки.
+static uint16_t checksum_djb2_bytewise(const MsgPayload *msg) {
+    uint32_t hash_val = 5381;
+    const uint8_t *byte_ptr = (const uint8_t*)msg;
+
+    size_t data_to_hash_size = sizeof(msg->msg_type) + sizeof(msg->data_len_bytes) + msg->data_len_bytes;
+    size_t hash_field_offset = offsetof(MsgPayload, msg_hash);
+
+    for (size_t i = 0; i < data_to_hash_size; ++i) {
+        if (i >= hash_field_offset && i < hash_field_offset + sizeof(msg->msg_hash)) {
+            continue;
+        }
+        hash_val = ((hash_val << 5) + hash_val) + byte_ptr[i];
+    }
+    return (uint16_t)(hash_val & 0xFFFF);
+}
+
+// Побитовый CRC32C по тем же байтам - эталон для обеих реализаций.
+static uint16_t checksum_crc32c_bitwise(const MsgPayload *msg) {
+    const uint8_t *byte_ptr = (const uint8_t*)msg;
+    size_t data_to_hash_size = sizeof(msg->msg_type) + sizeof(msg->data_len_bytes) + msg->data_len_bytes;
+    size_t hash_field_offset = offsetof(MsgPayload, msg_hash);
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < data_to_hash_size; ++i) {
+        if (i >= hash_field_offset && i < hash_field_offset + sizeof(msg->msg_hash)) {
+            continue;
+        }
+        crc ^= byte_ptr[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78u : 0);
+        }
+    }
+    crc = ~crc;
+    return (uint16_t)(crc ^ (crc >> 16));
+}
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Случайное сообщение; байт формата и хвост payload тоже случайные, чтобы
+// сверка не зависела от того, что они обычно нулевые.
+static void fill_random(MsgPayload *msg, int len) {
+    uint8_t *bytes = (uint8_t *)msg;
+    for (size_t i = 0; i < sizeof(MsgPayload); ++i) {
+        bytes[i] = (uint8_t)(rand() % 256);
+    }
+    msg->data_len_bytes = (uint8_t)len;
+}
+
+static size_t verify(MsgPayload *msgs, size_t count) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (checksum_djb2(&msgs[i]) != checksum_djb2_bytewise(&msgs[i])) mismatches++;
+        if (checksum_crc32c(&msgs[i]) != checksum_crc32c_bitwise(&msgs[i])) mismatches++;
+    }
+    return mismatches;
+}
+
+static volatile uint16_t sink;
+
+static double time_ns_per_msg(uint16_t (*fn)(const MsgPayload *), const MsgPayload *msgs, size_t count) {
+    uint16_t acc = 0;
+    long start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            acc ^= fn(&msgs[i]);
+        }
+    }
+    long elapsed = now_ns() - start;
+    sink = acc;
+    return (double)elapsed / ((double)BENCH_ROUNDS * count);
+}
+
+int main(void) {
+    srand(1);
+    static MsgPayload msgs[BENCH_MESSAGES];
+
+    // Сверка: каждая длина 0..255 по 16 раз.
+    size_t checked = 0, mismatches = 0;
+    for (int len = 0; len <= 255; ++len) {
+        for (int k = 0; k < 16; ++k) fill_random(&msgs[k], len);
+        mismatches += verify(msgs, 16);
+        checked += 16;
+    }
+    printf("Verified %zu messages: %zu mismatches against byte-serial references.\n", checked, mismatches);
+
+    printf("%-8s %12s %12s %12s %12s\n", "length", "djb2 bytes", "djb2 words", "crc32c", "crc32c MB/s");
+    const int lengths[] = {8, 32, 128, 255, -1};
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        for (size_t i = 0; i < BENCH_MESSAGES; ++i) {
+            fill_random(&msgs[i], lengths[l] >= 0 ? lengths[l] : rand() % 256);
+        }
+        size_t bytes = 0;
+        for (size_t i = 0; i < BENCH_MESSAGES; ++i) bytes += 2 + msgs[i].data_len_bytes;
+
+        double bytewise = time_ns_per_msg(checksum_djb2_bytewise, msgs, BENCH_MESSAGES);
+        double words = time_ns_per_msg(checksum_djb2, msgs, BENCH_MESSAGES);
+        double crc = time_ns_per_msg(checksum_crc32c, msgs, BENCH_MESSAGES);
+        char label[16];
+        if (lengths[l] >= 0) {
+            snprintf(label, sizeof(label), "%d", lengths[l]);
+        } else {
+            snprintf(label, sizeof(label), "random");
+        }
+        printf("%-8s %12.1f %12.1f %12.1f %12.0f\n", label, bytewise, words, crc,
+               (double)bytes / BENCH_MESSAGES / crc * 1000.0);
+    }
+    printf("Times in ns per message, CRC32C: %s.\n", crc32c_hardware() ? "SSE4.2" : "table");
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -60,6 +60,10 @@ void terminate_last_consumer(void) {
 }
 
 void process_and_verify_message(MsgPayload *msg) {
+    if (msg->msg_format != MSG_FORMAT_DJB2 && msg->msg_format != MSG_FORMAT_CRC32C) {
+        fprintf(stderr, "Unknown message format %" PRIu8 ", checksum not verified\n", msg->msg_format);
+        return;
+    }
     uint16_t original_msg_hash = msg->msg_hash;
     msg->msg_hash = 0;
 
@@ -5,6 +5,7 @@ extern QueueBuffer *shared_queue_ptr;
 extern int semaphore_set_id;
 extern pid_t producer_pids[];
 extern size_t active_producers_count;
+extern uint8_t producer_msg_format;
 
 
 void spawn_producer_process(void) {
@@ -76,6 +77,7 @@ void generate_and_fill_message(MsgPayload *msg) {
         msg->payload_data[i] = (char)(rand() % 256);
     }
 
+    msg->msg_format = producer_msg_format;
     msg->msg_hash = 0;
     msg->msg_hash = compute_checksum(msg);
 }
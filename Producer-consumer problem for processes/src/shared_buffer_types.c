@@ -1,25 +1,144 @@
 #include "shared_buffer_types.h"
 #include <stddef.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_SSE42 1
+#endif
+
 extern QueueBuffer *shared_queue_ptr;
 extern int semaphore_set_id;
 
-uint16_t compute_checksum(MsgPayload *msg) {
-    uint32_t hash_val = 5381;
-    const uint8_t *byte_ptr = (const uint8_t*)msg;
+// msg_format лёг в бывший байт выравнивания: раскладка и, для
+// MSG_FORMAT_DJB2, значение суммы прежние.
+_Static_assert(offsetof(MsgPayload, msg_format) == 1 && offsetof(MsgPayload, msg_hash) == 2,
+               "MsgPayload layout changed");
 
-    size_t data_to_hash_size = sizeof(msg->msg_type) + sizeof(msg->data_len_bytes) + msg->data_len_bytes;
-    size_t hash_field_offset = offsetof(MsgPayload, msg_hash);
+// Сумма идёт по началу структуры длиной 2 + data_len_bytes в обход msg_hash:
+// [0, hash_off) и [hash_off + 2, end).
+static size_t checksum_end(const MsgPayload *msg) {
+    return sizeof(msg->msg_type) + sizeof(msg->data_len_bytes) + msg->data_len_bytes;
+}
 
-    for (size_t i = 0; i < data_to_hash_size; ++i) {
-        if (i >= hash_field_offset && i < hash_field_offset + sizeof(msg->msg_hash)) {
-            continue;
-        }
-        hash_val = ((hash_val << 5) + hash_val) + byte_ptr[i];
+// Степени 33 по модулю 2^32.
+#define P1 33u
+#define P2 (P1 * P1)
+#define P3 (P2 * P1)
+#define P4 (P2 * P2)
+#define P5 (P4 * P1)
+#define P6 (P4 * P2)
+#define P7 (P4 * P3)
+#define P8 (P4 * P4)
+
+// djb2 (h = h * 33 + b) по 8 байт за шаг: h * 33^8 + b0 * 33^7 + ... + b7 -
+// то же значение по модулю 2^32, но восемь умножений не ждут друг друга.
+static uint32_t djb2_update(uint32_t h, const uint8_t *p, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        h = h * P8 + p[i] * P7 + p[i + 1] * P6 + p[i + 2] * P5 + p[i + 3] * P4 +
+            p[i + 4] * P3 + p[i + 5] * P2 + p[i + 6] * P1 + p[i + 7];
+    }
+    for (; i < len; ++i) {
+        h = h * 33 + p[i];
+    }
+    return h;
+}
+
+uint16_t checksum_djb2(const MsgPayload *msg) {
+    const uint8_t *byte_ptr = (const uint8_t *)msg;
+    size_t end = checksum_end(msg);
+    size_t hash_off = offsetof(MsgPayload, msg_hash);
+    size_t rest = hash_off + sizeof(msg->msg_hash);
+
+    uint32_t hash_val = djb2_update(5381, byte_ptr, end < hash_off ? end : hash_off);
+    if (end > rest) {
+        hash_val = djb2_update(hash_val, byte_ptr + rest, end - rest);
     }
     return (uint16_t)(hash_val & 0xFFFF);
 }
 
+// Отражённый полином Кастаньоли, как у инструкции crc32.
+#define CRC32C_POLY 0x82F63B78u
+
+static uint32_t crc32c_table[256];
+static int crc32c_table_ready;
+
+static uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *p, size_t len) {
+    if (!crc32c_table_ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c >> 1) ^ (c & 1 ? CRC32C_POLY : 0);
+            }
+            crc32c_table[i] = c;
+        }
+        crc32c_table_ready = 1;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ p[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+    }
+    crc = (uint32_t)c;
+    for (; len > 0; ++p, --len) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+#endif
+
+int crc32c_hardware(void) {
+#ifdef HAVE_CRC32C_SSE42
+    static int supported = -1;
+    if (supported < 0) {
+        supported = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    return supported;
+#else
+    return 0;
+#endif
+}
+
+static uint32_t crc32c_update(uint32_t crc, const uint8_t *p, size_t len) {
+#ifdef HAVE_CRC32C_SSE42
+    if (crc32c_hardware()) {
+        return crc32c_update_hw(crc, p, len);
+    }
+#endif
+    return crc32c_update_sw(crc, p, len);
+}
+
+uint16_t checksum_crc32c(const MsgPayload *msg) {
+    const uint8_t *byte_ptr = (const uint8_t *)msg;
+    size_t end = checksum_end(msg);
+    size_t hash_off = offsetof(MsgPayload, msg_hash);
+    size_t rest = hash_off + sizeof(msg->msg_hash);
+
+    uint32_t crc = crc32c_update(0xFFFFFFFFu, byte_ptr, end < hash_off ? end : hash_off);
+    if (end > rest) {
+        crc = crc32c_update(crc, byte_ptr + rest, end - rest);
+    }
+    crc = ~crc;
+    return (uint16_t)(crc ^ (crc >> 16));
+}
+
+uint16_t compute_checksum(MsgPayload *msg) {
+    if (msg->msg_format == MSG_FORMAT_CRC32C) {
+        return checksum_crc32c(msg);
+    }
+    return checksum_djb2(msg);
+}
+
 void initialize_queue(void) {
     shared_queue_ptr->total_added_count = 0;
     shared_queue_ptr->total_extracted_count = 0;
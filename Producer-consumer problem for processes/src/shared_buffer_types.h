@@ -22,10 +22,14 @@
 #define EMPTY_SEM_NAME "free_buffer_slots"
 #define FILLED_SEM_NAME "messages_in_queue"
 
+// Версии формата сообщения: чем считается msg_hash.
+#define MSG_FORMAT_DJB2 0       // исходный djb2, младшие 16 бит
+#define MSG_FORMAT_CRC32C 1     // CRC32C (SSE4.2, если есть), свёрнутый до 16 бит
 
 typedef struct
 {
     int8_t msg_type;
+    uint8_t msg_format;     // MSG_FORMAT_*; занимает бывший байт выравнивания
     uint16_t msg_hash;
     uint8_t data_len_bytes;
     char payload_data[MAX_PAYLOAD_SIZE];
@@ -50,7 +54,14 @@ extern int semaphore_set_id;
 void semaphore_wait(int sem_num);
 void semaphore_signal(int sem_num);
 
+// Контрольная сумма по версии msg->msg_format. Покрывает те же байты, что
+// и прежняя побайтовая реализация: начало структуры длиной
+// 2 + data_len_bytes, кроме поля msg_hash.
 uint16_t compute_checksum(MsgPayload *msg);
+uint16_t checksum_djb2(const MsgPayload *msg);
+uint16_t checksum_crc32c(const MsgPayload *msg);
+// 1 - CRC32C считается инструкцией SSE4.2.
+int crc32c_hardware(void);
 
 void initialize_queue(void);
 
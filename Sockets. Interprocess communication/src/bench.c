@@ -0,0 +1,510 @@
+// Нагрузочный клиент для протокола myserver.
+// N соединений распределяются по нескольким потокам с epoll; каждый поток
+// воспроизводит смесь команд (ECHO разных размеров, LIST в заданных каталогах,
+// цепочки CD) в закрытом (следующая команда сразу после ответа) или открытом
+// (заданная частота, задержка считается от запланированного момента) цикле.
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "unixaddr.h"
+
+#define BENCH_MAX_ITEMS   32
+#define BENCH_MAX_STEPS   (BENCH_MAX_ITEMS + 2)
+#define BENCH_CMD_MAX     4096
+#define BENCH_STEP_MAX    512
+#define BENCH_IN_SIZE     65536
+#define BENCH_PENDING_MAX 1024
+#define BENCH_MAX_EVENTS  256
+
+typedef enum { OP_ECHO = 0, OP_INFO, OP_LIST, OP_CD, OP_COUNT } bench_op_t;
+typedef enum { KIND_ECHO = 0, KIND_INFO, KIND_LIST, KIND_CD, KIND_COUNT } bench_kind_t;
+
+static const char *const op_names[OP_COUNT] = { "echo", "info", "list", "cd" };
+static const char *const kind_names[KIND_COUNT] = { "ECHO", "INFO", "LIST", "CD" };
+
+typedef struct {
+    const char *host;
+    const char *port;
+    int conns;
+    int threads;
+    double duration;
+    double rate;          // 0 - закрытый цикл
+    int weights[OP_COUNT];
+    int echo_sizes[BENCH_MAX_ITEMS];
+    int echo_size_count;
+    const char *list_dirs[BENCH_MAX_ITEMS];
+    int list_dir_count;
+    const char *cd_chain[BENCH_MAX_ITEMS];
+    int cd_chain_len;
+} bench_config_t;
+
+typedef struct {
+    int fd;
+    int ready;            // получено приветствие
+    int busy;             // ждём ответ на команду
+    int step, step_count;
+    char steps[BENCH_MAX_STEPS][BENCH_STEP_MAX];
+    bench_kind_t kinds[BENCH_MAX_STEPS];
+    int echo_size;        // для ECHO текст команды собирается при отправке
+    uint64_t cmd_start;
+    char out[BENCH_CMD_MAX + 2];
+    size_t out_len, out_off;
+    int want_out;         // подписаны на EPOLLOUT
+    char prev;            // последний прочитанный байт (для строк на стыке чтений)
+    uint64_t pending[BENCH_PENDING_MAX]; // открытый цикл: запланированные моменты
+    int pend_head, pend_count;
+} bench_conn_t;
+
+typedef struct {
+    int epfd;
+    bench_conn_t *conns;
+    int conn_count;
+    unsigned int seed;
+    histogram_t hist[KIND_COUNT];
+    unsigned long long completed;
+    unsigned long long errors;
+    unsigned long long overflow;  // открытый цикл: очередь соединения переполнена
+    pthread_t tid;
+} bench_thread_t;
+
+static bench_config_t cfg;
+static uint64_t bench_start_ns, bench_end_ns;
+static char echo_payload[BENCH_CMD_MAX];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int split_list(char *s, const char **out, int max) {
+    int n = 0;
+    for (char *tok = strtok(s, ","); tok && n < max; tok = strtok(NULL, ",")) out[n++] = tok;
+    return n;
+}
+
+static int parse_mix(char *s) {
+    memset(cfg.weights, 0, sizeof(cfg.weights));
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if (!eq) return -1;
+        *eq = '\0';
+        int i;
+        for (i = 0; i < OP_COUNT; ++i) if (strcasecmp(tok, op_names[i]) == 0) break;
+        if (i == OP_COUNT) return -1;
+        cfg.weights[i] = atoi(eq + 1);
+    }
+    return 0;
+}
+
+static int connect_server(void) {
+    if (cfg.port == NULL) {  // unix:/path или unix:@name
+        struct sockaddr_un addr;
+        socklen_t alen;
+        if (unix_addr_parse(cfg.host, &addr, &alen) < 0) return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr *)&addr, alen) < 0) {
+            close(fd);
+            return -1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return fd;
+    }
+    struct addrinfo hints, *res, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rc = getaddrinfo(cfg.host, cfg.port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
+        return -1;
+    }
+    int fd = -1;
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Формирует последовательность команд для одной операции смеси.
+static void plan_op(bench_thread_t *t, bench_conn_t *c) {
+    int total = 0;
+    for (int i = 0; i < OP_COUNT; ++i) total += cfg.weights[i];
+    int r = (int)(rand_r(&t->seed) % (unsigned)total);
+    bench_op_t op = OP_ECHO;
+    for (int i = 0; i < OP_COUNT; ++i) {
+        if (r < cfg.weights[i]) { op = (bench_op_t)i; break; }
+        r -= cfg.weights[i];
+    }
+
+    c->step = 0;
+    c->step_count = 0;
+    switch (op) {
+        case OP_ECHO: {
+            c->echo_size = cfg.echo_sizes[rand_r(&t->seed) % (unsigned)cfg.echo_size_count];
+            c->kinds[0] = KIND_ECHO;
+            c->step_count = 1;
+            break;
+        }
+        case OP_INFO:
+            strcpy(c->steps[0], "INFO");
+            c->kinds[0] = KIND_INFO;
+            c->step_count = 1;
+            break;
+        case OP_LIST: {
+            const char *dir = cfg.list_dirs[rand_r(&t->seed) % (unsigned)cfg.list_dir_count];
+            snprintf(c->steps[0], BENCH_STEP_MAX, "CD /%s", strcmp(dir, ".") == 0 ? "" : dir);
+            c->kinds[0] = KIND_CD;
+            strcpy(c->steps[1], "LIST");
+            c->kinds[1] = KIND_LIST;
+            c->step_count = 2;
+            break;
+        }
+        case OP_CD:
+            for (int i = 0; i < cfg.cd_chain_len; ++i) {
+                snprintf(c->steps[i], BENCH_STEP_MAX, "CD %s", cfg.cd_chain[i]);
+                c->kinds[i] = KIND_CD;
+            }
+            strcpy(c->steps[cfg.cd_chain_len], "CD /");
+            c->kinds[cfg.cd_chain_len] = KIND_CD;
+            c->step_count = cfg.cd_chain_len + 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static int flush_out(bench_thread_t *t, bench_conn_t *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!c->want_out) {
+                    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+                    epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+                    c->want_out = 1;
+                }
+                return 0;
+            }
+            return -1;
+        }
+        c->out_off += (size_t)n;
+    }
+    if (c->want_out) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = 0;
+    }
+    return 0;
+}
+
+static int send_step(bench_thread_t *t, bench_conn_t *c, uint64_t start) {
+    size_t len;
+    if (c->kinds[c->step] == KIND_ECHO) {
+        len = (size_t)snprintf(c->out, sizeof(c->out), "ECHO %.*s", c->echo_size, echo_payload);
+    } else {
+        len = strlen(c->steps[c->step]);
+        memcpy(c->out, c->steps[c->step], len);
+    }
+    c->out[len] = '\n';
+    c->out_len = len + 1;
+    c->out_off = 0;
+    c->cmd_start = start;
+    c->busy = 1;
+    return flush_out(t, c);
+}
+
+static int start_op(bench_thread_t *t, bench_conn_t *c, uint64_t scheduled) {
+    plan_op(t, c);
+    return send_step(t, c, scheduled);
+}
+
+// Ответ на текущую команду завершён (получено приглашение).
+static int on_prompt(bench_thread_t *t, bench_conn_t *c, uint64_t now) {
+    if (!c->ready) {
+        c->ready = 1;
+    } else if (c->busy) {
+        hist_record(&t->hist[c->kinds[c->step]], now - c->cmd_start);
+        t->completed++;
+        c->busy = 0;
+        if (++c->step < c->step_count) return send_step(t, c, now);
+    }
+    if (now >= bench_end_ns) return 0;
+    if (cfg.rate <= 0) return start_op(t, c, now);
+    if (c->pend_count > 0) {
+        uint64_t sched = c->pending[c->pend_head];
+        c->pend_head = (c->pend_head + 1) % BENCH_PENDING_MAX;
+        c->pend_count--;
+        return start_op(t, c, sched);
+    }
+    return 0;
+}
+
+static int on_readable(bench_thread_t *t, bench_conn_t *c) {
+    char buf[BENCH_IN_SIZE];
+    for (;;) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        uint64_t now = now_ns();
+        const char *p = buf, *end = buf + n;
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            if (!nl) {
+                c->prev = end[-1];
+                break;
+            }
+            char last = nl > p ? nl[-1] : c->prev;
+            if (last == '>' && on_prompt(t, c, now) < 0) return -1;
+            c->prev = '\n';
+            p = nl + 1;
+        }
+    }
+}
+
+static void *bench_thread_main(void *arg) {
+    bench_thread_t *t = arg;
+    struct epoll_event events[BENCH_MAX_EVENTS];
+    double thread_rate = cfg.rate / cfg.threads;
+    uint64_t interval = thread_rate > 0 ? (uint64_t)(1e9 / thread_rate) : 0;
+    uint64_t next_arrival = bench_start_ns;
+    int rr = 0;
+
+    for (;;) {
+        uint64_t now = now_ns();
+        int active = 0;
+        for (int i = 0; i < t->conn_count; ++i) if (t->conns[i].fd >= 0 && t->conns[i].busy) active = 1;
+        if (now >= bench_end_ns && (!active || now >= bench_end_ns + 1000000000ULL)) break;
+
+        // Открытый цикл: раздаём наступившие моменты по соединениям.
+        if (interval > 0) {
+            while (next_arrival <= now && next_arrival < bench_end_ns) {
+                bench_conn_t *c = &t->conns[rr];
+                rr = (rr + 1) % t->conn_count;
+                if (c->fd < 0) { t->errors++; }
+                else if (c->ready && !c->busy && c->pend_count == 0) {
+                    if (start_op(t, c, next_arrival) < 0) t->errors++;
+                } else if (c->pend_count < BENCH_PENDING_MAX) {
+                    c->pending[(c->pend_head + c->pend_count) % BENCH_PENDING_MAX] = next_arrival;
+                    c->pend_count++;
+                } else {
+                    t->overflow++;
+                }
+                next_arrival += interval;
+            }
+        }
+
+        int timeout_ms = 100;
+        if (interval > 0 && next_arrival > now) {
+            uint64_t wait = (next_arrival - now + 999999) / 1000000;
+            if (wait < (uint64_t)timeout_ms) timeout_ms = (int)wait;
+        }
+        int n = epoll_wait(t->epfd, events, BENCH_MAX_EVENTS, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            bench_conn_t *c = events[i].data.ptr;
+            int rc = 0;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) rc = -1;
+            if (rc == 0 && (events[i].events & EPOLLOUT)) rc = flush_out(t, c);
+            if (rc == 0 && (events[i].events & EPOLLIN)) rc = on_readable(t, c);
+            if (rc < 0) {
+                t->errors++;
+                epoll_ctl(t->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                c->fd = -1;
+                c->busy = 0;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-c conns] [-t threads] [-d seconds] [-r rate] [-m mix]\n"
+            "          [-s echo_sizes] [-L list_dirs] [-C cd_chain] {host port | unix:/path | unix:@name}\n"
+            "  -c  number of connections (default 16)\n"
+            "  -t  number of epoll threads (default 2)\n"
+            "  -d  duration in seconds (default 10)\n"
+            "  -r  open loop: total operations per second (default 0 = closed loop)\n"
+            "  -m  operation mix, e.g. echo=70,list=20,cd=10,info=0\n"
+            "  -s  ECHO payload sizes, e.g. 16,256,1024\n"
+            "  -L  directories for LIST relative to the server root, e.g. .,dir2\n"
+            "  -C  CD chain, e.g. dir2,..,dir2\n",
+            prog);
+}
+
+static void print_row(const char *name, const histogram_t *h) {
+    printf("%-6s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+           (unsigned long long)h->total, hist_mean(h) / 1e3,
+           hist_percentile(h, 50.0) / 1e3, hist_percentile(h, 99.0) / 1e3,
+           hist_percentile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+    static char mix_default[] = "echo=70,list=20,cd=10";
+    static char sizes_default[] = "16,256,1024";
+    static char dirs_default[] = ".";
+    static char chain_default[] = "..";
+    char *mix = mix_default, *sizes = sizes_default, *dirs = dirs_default, *chain = chain_default;
+
+    cfg.conns = 16;
+    cfg.threads = 2;
+    cfg.duration = 10.0;
+    cfg.rate = 0.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:r:m:s:L:C:h")) != -1) {
+        switch (opt) {
+            case 'c': cfg.conns = atoi(optarg); break;
+            case 't': cfg.threads = atoi(optarg); break;
+            case 'd': cfg.duration = atof(optarg); break;
+            case 'r': cfg.rate = atof(optarg); break;
+            case 'm': mix = optarg; break;
+            case 's': sizes = optarg; break;
+            case 'L': dirs = optarg; break;
+            case 'C': chain = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    int unix_mode = argc - optind == 1 && unix_addr_is(argv[optind]);
+    if (argc - optind != 2 && !unix_mode) {
+        usage(argv[0]);
+        return 1;
+    }
+    cfg.host = argv[optind];
+    cfg.port = unix_mode ? NULL : argv[optind + 1];
+
+    if (parse_mix(mix) < 0) {
+        fprintf(stderr, "Error: invalid mix '%s'\n", mix);
+        return 1;
+    }
+    const char *size_strs[BENCH_MAX_ITEMS];
+    cfg.echo_size_count = split_list(sizes, size_strs, BENCH_MAX_ITEMS);
+    for (int i = 0; i < cfg.echo_size_count; ++i) {
+        cfg.echo_sizes[i] = atoi(size_strs[i]);
+        if (cfg.echo_sizes[i] < 1 || cfg.echo_sizes[i] > BENCH_CMD_MAX - 8) {
+            fprintf(stderr, "Error: ECHO size must be in 1..%d\n", BENCH_CMD_MAX - 8);
+            return 1;
+        }
+    }
+    cfg.list_dir_count = split_list(dirs, cfg.list_dirs, BENCH_MAX_ITEMS);
+    cfg.cd_chain_len = split_list(chain, cfg.cd_chain, BENCH_MAX_ITEMS);
+    int total_weight = 0;
+    for (int i = 0; i < OP_COUNT; ++i) total_weight += cfg.weights[i];
+    if (cfg.conns < 1 || cfg.threads < 1 || cfg.duration <= 0 || total_weight <= 0 ||
+        cfg.echo_size_count == 0 || cfg.list_dir_count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cfg.threads > cfg.conns) cfg.threads = cfg.conns;
+    memset(echo_payload, 'x', sizeof(echo_payload));
+
+    bench_thread_t *threads = calloc((size_t)cfg.threads, sizeof(*threads));
+    bench_conn_t *conns = calloc((size_t)cfg.conns, sizeof(*conns));
+    if (!threads || !conns) {
+        perror("calloc");
+        return 1;
+    }
+
+    int per_thread = cfg.conns / cfg.threads, extra = cfg.conns % cfg.threads, next = 0;
+    for (int i = 0; i < cfg.threads; ++i) {
+        bench_thread_t *t = &threads[i];
+        t->seed = (unsigned int)time(NULL) ^ (unsigned int)(i * 7919);
+        t->conns = conns + next;
+        t->conn_count = per_thread + (i < extra ? 1 : 0);
+        next += t->conn_count;
+        t->epfd = epoll_create1(0);
+        if (t->epfd < 0) {
+            perror("epoll_create1");
+            return 1;
+        }
+        for (int j = 0; j < t->conn_count; ++j) {
+            bench_conn_t *c = &t->conns[j];
+            c->fd = connect_server();
+            if (c->fd < 0) {
+                perror("connect");
+                return 1;
+            }
+            c->prev = '\n';
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+            epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        }
+    }
+
+    printf("mybench: %d connections, %d threads, %.1f s, %s", cfg.conns, cfg.threads, cfg.duration,
+           cfg.rate > 0 ? "open loop" : "closed loop");
+    if (cfg.rate > 0) printf(" at %.0f ops/s", cfg.rate);
+    printf("\n");
+
+    bench_start_ns = now_ns();
+    bench_end_ns = bench_start_ns + (uint64_t)(cfg.duration * 1e9);
+    for (int i = 0; i < cfg.threads; ++i) {
+        if (pthread_create(&threads[i].tid, NULL, bench_thread_main, &threads[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    histogram_t total, per_kind[KIND_COUNT];
+    hist_reset(&total);
+    for (int k = 0; k < KIND_COUNT; ++k) hist_reset(&per_kind[k]);
+    unsigned long long completed = 0, errors = 0, overflow = 0;
+    for (int i = 0; i < cfg.threads; ++i) {
+        pthread_join(threads[i].tid, NULL);
+        for (int k = 0; k < KIND_COUNT; ++k) {
+            hist_merge(&per_kind[k], &threads[i].hist[k]);
+            hist_merge(&total, &threads[i].hist[k]);
+        }
+        completed += threads[i].completed;
+        errors += threads[i].errors;
+        overflow += threads[i].overflow;
+        close(threads[i].epfd);
+    }
+    double elapsed = (double)(now_ns() - bench_start_ns) / 1e9;
+
+    printf("completed: %llu commands in %.2f s (%.1f cmd/s), errors: %llu", completed, elapsed,
+           completed / elapsed, errors);
+    if (overflow) printf(", dropped arrivals: %llu", overflow);
+    printf("\n");
+    printf("%-6s %10s %10s %10s %10s %10s %10s\n", "cmd", "count", "mean_us", "p50_us", "p99_us",
+           "p999_us", "max_us");
+    print_row("ALL", &total);
+    for (int k = 0; k < KIND_COUNT; ++k)
+        if (per_kind[k].total) print_row(kind_names[k], &per_kind[k]);
+
+    for (int i = 0; i < cfg.conns; ++i) if (conns[i].fd >= 0) close(conns[i].fd);
+    free(conns);
+    free(threads);
+    return 0;
+}
@@ -5,15 +5,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <signal.h> // Для обработки SIGINT
 #include <poll.h>   // Для poll (хотя в итоге используем select, poll здесь просто для полноты)
 
+#include "protocol.h"
+#include "unixaddr.h"
+
 #define BUF_SIZE 4096
+#define BATCH_SEND_BUF (64 * 1024)
+#define DEFAULT_BATCH_WINDOW 64
 
 // Глобальный флаг для управления циклом клиента
 volatile sig_atomic_t client_running = 1;
+// Сколько команд из @file может быть отправлено без ожидания ответа.
+static int batch_window = DEFAULT_BATCH_WINDOW;
+// Двоичный режим (protocol.h): включается после ответа PROTO_BIN_ACK
+// и следующего за ним приглашения - но только в ответ на HELLO BIN,
+// отправленный самим клиентом (ECHO HELLO BIN OK режим не меняет).
+static int binary_mode = 0;
+static int binary_pending = 0;
+static uint32_t next_req_id = 1;
+// Сколько ответов (приглашений) ещё не получено и сколько из них придёт
+// раньше ответа на HELLO BIN; -1 - HELLO BIN не отправлялся.
+static long replies_pending = 0;
+static long hello_reply_in = -1;
 
 // Обработчик сигналов для клиента
 void sig_handler(int signo) {
@@ -23,61 +42,174 @@ void sig_handler(int signo) {
     }
 }
 
-// Теперь read_line будет возвращать malloc'ированную строку.
-// Ответственность за free лежит на вызывающей стороне.
+// read_line возвращает строку без '\n', действительную до следующего вызова.
+// Если строка целиком лежит в read_buffer, возвращается указатель прямо в него
+// ('\n' заменяется на '\0'). Строки, попавшие на стык двух recv, собираются
+// в один переиспользуемый буфер line_buf, который растёт вдвое.
 static char read_buffer[BUF_SIZE];
-static int read_buffer_pos = 0;
-static int read_buffer_len = 0;
+static size_t read_buffer_pos = 0;
+static size_t read_buffer_len = 0;
+static char *line_buf = NULL;
+static size_t line_buf_cap = 0;
+
+static int line_buf_reserve(size_t need) {
+    if (need <= line_buf_cap) return 0;
+    size_t cap = line_buf_cap ? line_buf_cap : BUF_SIZE;
+    while (cap < need) cap *= 2;
+    char *p = realloc(line_buf, cap);
+    if (p == NULL) {
+        perror("realloc failed in read_line");
+        return -1;
+    }
+    line_buf = p;
+    line_buf_cap = cap;
+    return 0;
+}
 
 char *read_line(int fd) {
-    char *out = NULL;
-    int current_out_len = 0;
+    size_t line_len = 0;
+    int spanning = 0;
 
     while (1) {
         if (read_buffer_pos >= read_buffer_len) {
-            read_buffer_len = recv(fd, read_buffer, BUF_SIZE, 0);
+            ssize_t n = recv(fd, read_buffer, BUF_SIZE, 0);
             read_buffer_pos = 0;
-            if (read_buffer_len <= 0) {
-                if (out != NULL) free(out);
-                return NULL;
-            }
+            read_buffer_len = 0;
+            if (n <= 0) return NULL;
+            read_buffer_len = (size_t)n;
         }
 
-        char c = read_buffer[read_buffer_pos++];
-
-        if (c == '\n') {
-            if (out == NULL) {
-                out = malloc(1);
-                if (out == NULL) { perror("malloc"); return NULL; }
-                out[0] = '\0';
-            } else {
-                out = realloc(out, current_out_len + 1);
-                if (out == NULL) { perror("realloc"); return NULL; }
-                out[current_out_len] = '\0';
-            }
-            return out;
+        char *start = read_buffer + read_buffer_pos;
+        size_t avail = read_buffer_len - read_buffer_pos;
+        char *nl = memchr(start, '\n', avail);
+        size_t chunk = nl ? (size_t)(nl - start) : avail;
+
+        if (nl && !spanning) {
+            *nl = '\0';
+            read_buffer_pos += chunk + 1;
+            return start;
+        }
+
+        if (line_buf_reserve(line_len + chunk + 1) < 0) return NULL;
+        memcpy(line_buf + line_len, start, chunk);
+        line_len += chunk;
+        read_buffer_pos += chunk + (nl ? 1 : 0);
+        spanning = 1;
+        if (nl) {
+            line_buf[line_len] = '\0';
+            return line_buf;
         }
+    }
+}
 
-        out = realloc(out, current_out_len + 2);
-        if (out == NULL) {
-            perror("realloc failed in read_line");
-            return NULL;
+// Читает ровно len байт (сначала из read_buffer). 0 - успех, -1 - EOF/ошибка.
+static int read_exact(int fd, char *out, size_t len) {
+    while (len > 0) {
+        if (read_buffer_pos >= read_buffer_len) {
+            ssize_t n = recv(fd, read_buffer, BUF_SIZE, 0);
+            read_buffer_pos = 0;
+            read_buffer_len = 0;
+            if (n <= 0) return -1;
+            read_buffer_len = (size_t)n;
         }
-        out[current_out_len++] = c;
+        size_t chunk = read_buffer_len - read_buffer_pos;
+        if (chunk > len) chunk = len;
+        memcpy(out, read_buffer + read_buffer_pos, chunk);
+        read_buffer_pos += chunk;
+        out += chunk;
+        len -= chunk;
     }
+    return 0;
 }
 
+static void read_line_free(void) {
+    free(line_buf);
+    line_buf = NULL;
+    line_buf_cap = 0;
+}
+
+// Есть ли в буфере уже принятые, но не разобранные данные.
+static int read_buffer_pending(void) {
+    return read_buffer_pos < read_buffer_len;
+}
 
 int is_prompt(const char *s) {
     size_t L = strlen(s);
     return L > 0 && s[L-1] == '>';
 }
 
+static void set_prompt(char **prompt, const char *cwd) {
+    if (*prompt != NULL) free(*prompt);
+    size_t len = strlen(cwd);
+    *prompt = malloc(len + 2);
+    if (*prompt == NULL) return;
+    memcpy(*prompt, cwd, len);
+    (*prompt)[len] = '>';
+    (*prompt)[len + 1] = '\0';
+}
+
+// Двоичный аналог handle_server_line: читает и печатает один кадр.
+static int handle_server_frame(int sock, char **prompt) {
+    unsigned char hdr_buf[FRAME_HDR_SIZE];
+    frame_hdr_t h;
+    if (read_exact(sock, (char *)hdr_buf, sizeof(hdr_buf)) < 0) goto disconnected;
+    frame_get_hdr(hdr_buf, &h);
+    if (h.len > FRAME_MAX_PAYLOAD || line_buf_reserve(h.len + 1) < 0) {
+        fprintf(stderr, "Protocol error: frame of %u bytes\n", h.len);
+        goto disconnected;
+    }
+    if (read_exact(sock, line_buf, h.len) < 0) goto disconnected;
+    line_buf[h.len] = '\0';
+
+    switch (h.type) {
+        case FRAME_TEXT:
+            printf("%s\n", line_buf);
+            return 0;
+        case FRAME_ERROR:
+            printf("%s\n", line_buf);
+            return 0;
+        case FRAME_ENTRY: {
+            uint8_t kind;
+            uint16_t name_len;
+            uint64_t size;
+            if (h.len < ENTRY_HDR_SIZE) return 0;
+            entry_get_hdr((const unsigned char *)line_buf, &kind, &name_len, &size);
+            const char *name = line_buf + ENTRY_HDR_SIZE;
+            int nlen = name_len <= h.len - ENTRY_HDR_SIZE ? name_len : (int)(h.len - ENTRY_HDR_SIZE);
+            const char *target = name + nlen;
+            // Как строка LISTR: тип, размер, имя.
+            printf("%c %llu ", (char)kind, (unsigned long long)size);
+            if (kind == ENTRY_DIR) printf("%.*s/\n", nlen, name);
+            else if (kind == ENTRY_LINK) printf("%.*s --> %s\n", nlen, name, target);
+            else if (kind == ENTRY_LINK_LINK) printf("%.*s -->> %s\n", nlen, name, target);
+            else printf("%.*s\n", nlen, name);
+            return 0;
+        }
+        case FRAME_END:
+            set_prompt(prompt, line_buf);
+            return 2;
+        case FRAME_BYE:
+            printf("BYE\n");
+            goto disconnected;
+        default:
+            fprintf(stderr, "Protocol error: unknown frame type %u\n", h.type);
+            goto disconnected;
+    }
+
+disconnected:
+    if (*prompt != NULL) {
+        free(*prompt);
+        *prompt = NULL;
+    }
+    return 1;
+}
+
 // handle_server_line теперь возвращает:
 // 0: обработана обычная строка (не prompt, не BYE)
 // 1: получено BYE или EOF (нужно завершить клиента)
 // 2: получен prompt (нужно показать prompt и ждать ввода)
 int handle_server_line(int sock, char **prompt) {
+    if (binary_mode) return handle_server_frame(sock, prompt);
     char *line = read_line(sock);
     if (line == NULL) { // Сервер отключился
         if (*prompt != NULL) {
@@ -92,50 +224,180 @@ int handle_server_line(int sock, char **prompt) {
             free(*prompt);
         }
         *prompt = strdup(line); // strdup выделяет память, не забываем free
-        free(line); // Освобождаем строку, полученную от read_line
+        if (replies_pending > 0) replies_pending--;
+        if (hello_reply_in == 0) { // Закончился ответ на HELLO BIN
+            binary_mode = binary_pending; // Сервер подтвердил - дальше кадры
+            binary_pending = 0;
+            hello_reply_in = -1;
+        } else if (hello_reply_in > 0) {
+            hello_reply_in--;
+        }
         return 2; // Это prompt
     }
 
     printf("%s\n", line); // Это обычный ответ от сервера, печатаем его
+    if (hello_reply_in == 0) binary_pending = strcmp(line, PROTO_BIN_ACK) == 0;
     if (strcmp(line, "BYE") == 0) {
-        free(line);
         if (*prompt != NULL) {
             free(*prompt);
             *prompt = NULL;
         }
         return 1; // Сигнал на выход
     }
-    free(line); // Освобождаем строку, полученную от read_line
     return 0; // Обычная строка, продолжаем
 }
 
 
-void send_cmd(int sock, const char *cmd) {
-    send(sock, cmd, strlen(cmd), 0);
-    send(sock, "\n", 1, 0);
+// Совпадает ли команда с PROTO_BIN_HELLO так же, как её сравнивает сервер
+// (без учёта регистра и пробелов по краям).
+static int is_bin_hello(const char *cmd, size_t len) {
+    size_t hl = strlen(PROTO_BIN_HELLO);
+    while (len > 0 && isspace((unsigned char)*cmd)) {
+        cmd++;
+        len--;
+    }
+    while (len > 0 && isspace((unsigned char)cmd[len - 1])) len--;
+    return len == hl && strncasecmp(cmd, PROTO_BIN_HELLO, hl) == 0;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s server_host port\n", argv[0]);
-        return 1;
+// Кадр команды не должен превышать входной буфер сервера (FRAME_MAX_CMD),
+// иначе сервер сочтёт его ошибкой протокола и закроет соединение.
+static int cmd_fits(size_t len) {
+    if (binary_mode && len > FRAME_MAX_CMD) {
+        fprintf(stderr, "Error: command of %zu bytes exceeds the %d-byte frame limit, not sent\n",
+                len, FRAME_MAX_CMD);
+        return 0;
     }
-    const char *host = argv[1];
-    int port = atoi(argv[2]);
+    return 1;
+}
 
-    // Регистрация обработчика SIGINT для клиента
-    signal(SIGINT, sig_handler);
+// Кодирует команду в buf: строка с '\n' или кадр FRAME_CMD. Возвращает длину.
+static size_t encode_cmd(char *buf, const char *cmd, size_t len) {
+    if (!binary_mode) {
+        if (is_bin_hello(cmd, len)) hello_reply_in = replies_pending;
+        replies_pending++;
+        memcpy(buf, cmd, len);
+        buf[len] = '\n';
+        return len + 1;
+    }
+    frame_put_hdr((unsigned char *)buf, FRAME_CMD, next_req_id++, (uint32_t)len);
+    memcpy(buf + FRAME_HDR_SIZE, cmd, len);
+    return FRAME_HDR_SIZE + len;
+}
+
+// Возвращает -1, если команда не отправлена (не помещается в кадр).
+int send_cmd(int sock, const char *cmd) {
+    char buf[FRAME_HDR_SIZE + BUF_SIZE + 1];
+    size_t len = strlen(cmd);
+    if (len > BUF_SIZE) len = BUF_SIZE;
+    if (!cmd_fits(len)) return -1;
+    len = encode_cmd(buf, cmd, len);
+    send(sock, buf, len, 0);
+    return 0;
+}
+
+// Смена протокола действует только после ответа, поэтому за HELLO
+// нельзя отправлять следующие команды, пока ответ не получен.
+static int is_protocol_switch(const char *cmd) {
+    return strncasecmp(cmd, "HELLO", 5) == 0;
+}
+
+// Пакетный режим для @file: до batch_window команд находятся "в полёте",
+// ответы сопоставляются командам по числу полученных приглашений.
+// Сервер отвечает строго по порядку, поэтому вывод не перемешивается.
+// Возвращает 0 по окончании файла, -1 если сервер отключился или прислал BYE.
+static int run_batch(int sock, FILE *f, char **prompt) {
+    static char sendbuf[BATCH_SEND_BUF];
+    size_t send_len = 0, send_off = 0;
+    char file_line[BUF_SIZE];
+    long sent = 0, done = 0;
+    int eof = 0;
+    int barrier = 0;
+
+    while (client_running) {
+        if (barrier && done == sent) barrier = 0;
+        while (!eof && !barrier && sent - done < batch_window &&
+               send_len + FRAME_HDR_SIZE + sizeof(file_line) <= sizeof(sendbuf)) {
+            if (!fgets(file_line, sizeof(file_line), f)) {
+                eof = 1;
+                break;
+            }
+            char *nl = strchr(file_line, '\n');
+            if (nl) *nl = 0;
+            size_t len = strlen(file_line);
+            if (len == 0 || !cmd_fits(len)) continue;
+            send_len += encode_cmd(sendbuf + send_len, file_line, len);
+            sent++;
+            if (is_protocol_switch(file_line)) barrier = 1;
+        }
+        if (eof && done == sent && send_off == send_len) return 0;
+
+        short revents = 0;
+        if (!read_buffer_pending()) {
+            struct pollfd pfd = { sock, POLLIN | (send_off < send_len ? POLLOUT : 0), 0 };
+            int rc = poll(&pfd, 1, 100);
+            if (rc < 0) {
+                if (errno == EINTR) continue;
+                perror("poll");
+                return -1;
+            }
+            revents = pfd.revents;
+        }
+
+        if (revents & POLLOUT) {
+            ssize_t n = send(sock, sendbuf + send_off, send_len - send_off, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("send");
+                return -1;
+            }
+            if (n > 0) send_off += (size_t)n;
+            if (send_off == send_len) send_off = send_len = 0;
+        }
+
+        if ((revents & (POLLIN | POLLHUP | POLLERR)) || read_buffer_pending()) {
+            do {
+                int status = handle_server_line(sock, prompt);
+                if (status == 1) return -1;
+                if (status == 2) done++;
+            } while (read_buffer_pending());
+        }
+    }
+    return 0;
+}
+
+// Подключение по TCP (host, port) или к Unix-сокету сервера ("unix:...",
+// port == NULL): локальные сессии идут в обход стека TCP.
+static int connect_server(const char *host, const char *port_str) {
+    if (port_str == NULL) {
+        struct sockaddr_un addr;
+        socklen_t alen;
+        if (unix_addr_parse(host, &addr, &alen) < 0) {
+            fprintf(stderr, "Invalid unix socket address\n");
+            return -1;
+        }
+        int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock < 0) {
+            perror("socket"); return -1;
+        }
+        if (connect(sock, (struct sockaddr*)&addr, alen) < 0) {
+            perror("connect");
+            close(sock);
+            return -1;
+        }
+        return sock;
+    }
 
+    int port = atoi(port_str);
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
-        perror("socket"); return 1;
+        perror("socket"); return -1;
     }
 
     struct hostent *he = gethostbyname(host);
     if (!he) {
         fprintf(stderr, "Unknown host\n");
         close(sock);
-        return 1;
+        return -1;
     }
 
     struct sockaddr_in servaddr;
@@ -147,9 +409,43 @@ int main(int argc, char *argv[]) {
     if (connect(sock, (struct sockaddr*)&servaddr, sizeof(servaddr))<0) {
         perror("connect");
         close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    int want_binary = 0;
+    while ((opt = getopt(argc, argv, "bw:")) != -1) {
+        switch (opt) {
+            case 'b':
+                want_binary = 1;
+                break;
+            case 'w':
+                batch_window = atoi(optarg);
+                if (batch_window < 1) {
+                    fprintf(stderr, "Error: batch window must be >= 1\n");
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-b] [-w batch_window] {server_host port | unix:/path | unix:@name}\n", argv[0]);
+                return 1;
+        }
+    }
+    int unix_mode = argc - optind == 1 && unix_addr_is(argv[optind]);
+    if (argc - optind != 2 && !unix_mode) {
+        fprintf(stderr, "Usage: %s [-b] [-w batch_window] {server_host port | unix:/path | unix:@name}\n", argv[0]);
         return 1;
     }
 
+    // Регистрация обработчика SIGINT для клиента
+    signal(SIGINT, sig_handler);
+
+    int sock = connect_server(argv[optind], unix_mode ? NULL : argv[optind + 1]);
+    if (sock < 0) return 1;
+
     char *prompt = NULL; // Инициализируем prompt
     int prompt_received = 0; // Флаг, который указывает, был ли уже получен prompt
 
@@ -165,6 +461,16 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Переход на двоичный протокол до первого ввода пользователя
+    if (prompt_received && want_binary) {
+        send_cmd(sock, PROTO_BIN_HELLO);
+        int status;
+        while (client_running && (status = handle_server_line(sock, &prompt)) != 2) {
+            if (status == 1) goto end_client;
+        }
+        if (!binary_mode) fprintf(stderr, "Server refused binary protocol, staying in text mode.\n");
+    }
+
     // Здесь мы гарантированно получили первый prompt от сервера
     if (prompt_received && prompt != NULL) {
         printf("%s ", prompt);
@@ -236,27 +542,9 @@ int main(int argc, char *argv[]) {
                     }
                     continue;
                 }
-                char file_line[BUF_SIZE];
-                while (client_running && fgets(file_line, sizeof(file_line), f)) {
-                    if ((nl = strchr(file_line, '\n'))) *nl = 0;
-                    if (strlen(file_line) == 0) continue;
-
-                    send_cmd(sock, file_line);
-                    // После отправки команды из файла, читаем ответы от сервера
-                    // Продолжаем читать ответы, пока не получим prompt
-                    while(client_running) {
-                        int status = handle_server_line(sock, &prompt);
-                        if (status == 1) { // Сервер отключился или BYE
-                            fclose(f);
-                            goto end_client;
-                        }
-                        if (status == 2) { // Получили prompt
-                            // Здесь не нужно печатать prompt, это будет сделано, как только
-                            // все команды из файла будут обработаны, или основной цикл
-                            // будет готов к вводу пользователя снова.
-                            break; // Получили prompt, готовы к следующей команде из файла
-                        }
-                    }
+                if (run_batch(sock, f, &prompt) < 0) { // Сервер отключился или BYE
+                    fclose(f);
+                    goto end_client;
                 }
                 fclose(f);
                 // После обработки всех команд из файла, выводим prompt снова для ввода пользователя
@@ -265,7 +553,13 @@ int main(int argc, char *argv[]) {
                     fflush(stdout);
                 }
             } else { // Обычная команда (не начинающаяся с '@')
-                send_cmd(sock, line_buffer);
+                if (send_cmd(sock, line_buffer) < 0) {
+                    if (prompt != NULL) {
+                        printf("%s ", prompt);
+                        fflush(stdout);
+                    }
+                    continue;
+                }
                 // После отправки команды, читаем ответы от сервера
                 // Продолжаем читать ответы, пока не получим prompt
                 while(client_running) {
@@ -303,6 +597,7 @@ end_client:
     if (prompt != NULL) {
         free(prompt);
     }
+    read_line_free();
     close(sock);
     fprintf(stderr, "Client exited.\n");
     return 0;
@@ -0,0 +1,824 @@
+#include "evloop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "server.h"
+#include "stats.h"
+
+#define EVLOOP_MAX_LOOPS 64
+#define EVLOOP_MAX_LISTEN 4
+#define EVLOOP_TICK_MS 100
+#define EPOLL_BATCH 256
+
+#define URING_ENTRIES 1024
+#define URING_CQ_ENTRIES 8192
+#define URING_BUF_COUNT 1024       // буферов приёма в кольце (степень двойки)
+#define URING_BUF_SIZE BUF_SIZE
+#define URING_BGID 0
+#define URING_SEND_CHUNK (64 * 1024)  // размер звена в цепочке send
+#define URING_RXQ_HIGH (64 * 1024)    // больше непрочитанного - recv отменяется
+
+typedef struct loop loop_t;
+
+// Соединение в цикле: conn_t плюс состояние цикла. Список - для обхода
+// по таймауту бездействия и закрытия при остановке.
+typedef struct lconn {
+    conn_t *c;
+    loop_t *loop;
+    struct lconn *prev, *next;
+    int paused;          // чтение остановлено: клиент не забирает вывод
+    int closing;
+    int quit;            // закрытие по QUIT: сначала дописать ответ
+    uint32_t ep_events;  // epoll: текущая подписка
+    // io_uring
+    int recv_armed;
+    int cancel_inflight;
+    int sends_inflight;
+    int shut;
+    char *rxq;           // принятые, но ещё не разобранные данные
+    size_t rxq_len, rxq_cap;
+    char *sbuf;          // буфер в отправке (обменивается с c->out)
+    size_t sbuf_size, slen, ssent;
+} lconn_t;
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+    struct io_uring_buf_ring *br;
+    size_t br_size;
+    unsigned br_tail;
+    char *bufs;
+    struct __kernel_timespec tick;
+} uring_t;
+
+struct loop {
+    int id;
+    backend_t backend;
+    pthread_t tid;
+    int epfd;
+    uring_t ring;
+    int accepting;       // слушающие сокеты ещё подключены к циклу
+    int accept_armed[EVLOOP_MAX_LISTEN];
+    int nconns;
+    lconn_t *conns;
+    uint64_t last_sweep;
+};
+
+static loop_t loops[EVLOOP_MAX_LOOPS];
+static int loop_count;
+static int listen_set[EVLOOP_MAX_LISTEN];
+static int listen_count;
+static int server_root_fd;
+static const char *server_root;
+static atomic_int stop_accepting;
+static atomic_int accept_released;  // циклов, отписавшихся от слушающих сокетов
+
+static const char *const backend_names[] = { "threads", "epoll", "uring" };
+
+int backend_parse(const char *name, backend_t *out) {
+    for (int i = 0; i <= BACKEND_URING; ++i) {
+        if (strcasecmp(name, backend_names[i]) == 0) {
+            *out = (backend_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *backend_name(backend_t backend) {
+    return backend_names[backend];
+}
+
+static void lconn_link(loop_t *l, lconn_t *u) {
+    u->prev = NULL;
+    u->next = l->conns;
+    if (l->conns) l->conns->prev = u;
+    l->conns = u;
+    l->nconns++;
+}
+
+static void lconn_free(lconn_t *u) {
+    loop_t *l = u->loop;
+    if (u->prev) u->prev->next = u->next;
+    else l->conns = u->next;
+    if (u->next) u->next->prev = u->prev;
+    l->nconns--;
+    conn_close(u->c);
+    free(u->rxq);
+    free(u->sbuf);
+    free(u);
+}
+
+static lconn_t *lconn_new(loop_t *l, int fd, conn_mode_t mode) {
+    lconn_t *u = calloc(1, sizeof(*u));
+    if (!u) {
+        close(fd);
+        return NULL;
+    }
+    u->c = conn_open(fd, server_root_fd, server_root, mode);
+    if (!u->c) {
+        free(u);
+        return NULL;
+    }
+    u->loop = l;
+    lconn_link(l, u);
+    return u;
+}
+
+// Закрытие по таймауту бездействия: если клиент не забирает вывод - это
+// медленный клиент, иначе просто бездействующий.
+static int lconn_idle(lconn_t *u, uint64_t now) {
+    if (!conn_idle_expired(u->c, now)) return 0;
+    if (u->paused) {
+        log_warn("Client %d is not reading output, closing", u->c->fd);
+        stats_slow_close();
+    } else {
+        log_event("Client %d disconnected (idle timeout)", u->c->fd);
+        stats_idle_close();
+    }
+    return 1;
+}
+
+static int loop_should_exit(loop_t *l) {
+    if (!server_running) return 1;
+    return !l->accepting && l->nconns == 0;
+}
+
+// ---------------------------------------------------------------- epoll
+
+static void ep_update(loop_t *l, lconn_t *u) {
+    size_t pending = conn_pending(u->c);
+    uint32_t want = 0;
+    if (pending > 0) want |= EPOLLOUT;
+    if (pending <= OUT_BUF_SIZE && !u->c->walk && !u->closing) {
+        want |= EPOLLIN;
+        u->paused = 0;
+    } else if (!u->paused && !u->closing) {
+        u->paused = 1;
+        stats_read_paused();
+        log_debug("Client %d: output backlog %zu bytes, reading paused", u->c->fd, pending);
+    }
+    if (want == u->ep_events) return;
+    struct epoll_event ev = { .events = want, .data.ptr = u };
+    epoll_ctl(l->epfd, EPOLL_CTL_MOD, u->c->fd, &ev);
+    u->ep_events = want;
+}
+
+static void ep_accept(loop_t *l, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;  // EAGAIN: очередь пуста (или её забрал другой цикл)
+        stats_accept();
+        if (admit_client(fd) < 0) continue;
+        lconn_t *u = lconn_new(l, fd, CONN_EPOLL);
+        if (!u) continue;
+        u->ep_events = EPOLLIN;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = u };
+        epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev);
+        conn_flush(u->c);
+        ep_update(l, u);
+    }
+}
+
+// Обработка события соединения. 1 - соединение закрыто.
+static int ep_conn_event(loop_t *l, lconn_t *u, uint32_t events) {
+    conn_t *c = u->c;
+    if (events & EPOLLOUT) {
+        if (conn_flush(c) < 0) return 1;
+        // Место освободилось: продолжаем LIST/LISTR и команды за ним.
+        if (c->walk && !u->closing) {
+            if (conn_input(c)) u->closing = 1;
+            if (conn_flush(c) < 0) return 1;
+        }
+    }
+    if ((events & (EPOLLHUP | EPOLLERR)) && (u->paused || u->closing)) {
+        log_event("Client %d disconnected (hang up)", c->fd);
+        return 1;
+    }
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !u->paused && !u->closing) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, BUF_SIZE - c->in_len, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            if (n == 0) log_event("Client %d disconnected (gracefully)", c->fd);
+            else log_event("Client %d disconnected (error: %s)", c->fd, strerror(errno));
+            return 1;
+        }
+        if (n > 0) {
+            stats_bytes_in((size_t)n);
+            c->in_len += (size_t)n;
+            c->last_active = stats_now_ns();
+            if (conn_input(c)) u->closing = 1;
+            if (conn_flush(c) < 0) return 1;
+        }
+    }
+    if (c->dead) return 1;
+    if (u->closing && conn_pending(c) == 0) return 1;  // BYE отправлен
+    ep_update(l, u);
+    return 0;
+}
+
+static void ep_release_listeners(loop_t *l) {
+    for (int i = 0; i < listen_count; ++i) epoll_ctl(l->epfd, EPOLL_CTL_DEL, listen_set[i], NULL);
+    l->accepting = 0;
+    atomic_fetch_add(&accept_released, 1);
+}
+
+static void *ep_loop(void *arg) {
+    loop_t *l = arg;
+    struct epoll_event events[EPOLL_BATCH];
+    while (!loop_should_exit(l)) {
+        if (l->accepting && atomic_load(&stop_accepting)) ep_release_listeners(l);
+        int n = epoll_wait(l->epfd, events, EPOLL_BATCH, EVLOOP_TICK_MS);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            uintptr_t tag = (uintptr_t)events[i].data.ptr;
+            if (tag < EVLOOP_MAX_LISTEN) {
+                if (l->accepting) ep_accept(l, listen_set[tag]);
+                continue;
+            }
+            lconn_t *u = events[i].data.ptr;
+            if (ep_conn_event(l, u, events[i].events)) lconn_free(u);
+        }
+        uint64_t now = stats_now_ns();
+        if (now - l->last_sweep >= 1000000000ULL) {
+            l->last_sweep = now;
+            for (lconn_t *u = l->conns, *next; u; u = next) {
+                next = u->next;
+                if (lconn_idle(u, now)) lconn_free(u);
+            }
+        }
+    }
+    if (l->accepting) ep_release_listeners(l);
+    while (l->conns) lconn_free(l->conns);
+    close(l->epfd);
+    return NULL;
+}
+
+static int ep_init(loop_t *l) {
+    l->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (l->epfd < 0) return -1;
+    for (int i = 0; i < listen_count; ++i) {
+        // accept4 вызывается до EAGAIN, слушающий сокет должен быть неблокирующим.
+        fcntl(listen_set[i], F_SETFL, fcntl(listen_set[i], F_GETFL) | O_NONBLOCK);
+        // EPOLLEXCLUSIVE: новое соединение будит один цикл, а не все.
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = (void *)(uintptr_t)i };
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, listen_set[i], &ev) < 0) {
+            close(l->epfd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------- io_uring
+// Без liburing: кольца отображаются в память напрямую, системные вызовы -
+// через syscall(). user_data: указатель на lconn_t (выровнен на 8) | тип операции.
+
+enum {
+    UOP_RECV = 1,
+    UOP_SEND = 2,
+    UOP_CANCEL = 3,   // отмена recv соединения
+    UOP_ACCEPT = 4,   // номер слушающего сокета в битах 8+
+    UOP_TICK = 5,
+    UOP_LCANCEL = 6   // отмена accept
+};
+#define UOP_MASK 7ULL
+
+static int sys_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_free(uring_t *r) {
+    if (r->br) munmap(r->br, r->br_size);
+    free(r->bufs);
+    if (r->sqes) munmap(r->sqes, r->sqes_size);
+    if (r->ring_ptr) munmap(r->ring_ptr, r->ring_size);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static void uring_buf_add(uring_t *r, unsigned short bid) {
+    struct io_uring_buf *b = &r->br->bufs[r->br_tail & (URING_BUF_COUNT - 1)];
+    b->addr = (uint64_t)(uintptr_t)(r->bufs + (size_t)bid * URING_BUF_SIZE);
+    b->len = URING_BUF_SIZE;
+    b->bid = bid;
+    r->br_tail++;
+}
+
+static void uring_buf_publish(uring_t *r) {
+    __atomic_store_n(&r->br->tail, (unsigned short)r->br_tail, __ATOMIC_RELEASE);
+}
+
+static int uring_init(uring_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = URING_CQ_ENTRIES;
+    r->fd = sys_uring_setup(URING_ENTRIES, &p);
+    if (r->fd < 0) return -1;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        errno = ENOTSUP;
+        uring_free(r);
+        return -1;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    r->ring_ptr = mmap(NULL, r->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                       IORING_OFF_SQ_RING);
+    if (r->ring_ptr == MAP_FAILED) {
+        r->ring_ptr = NULL;
+        uring_free(r);
+        return -1;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        uring_free(r);
+        return -1;
+    }
+    char *base = r->ring_ptr;
+    r->sq_head = (unsigned *)(base + p.sq_off.head);
+    r->sq_tail = (unsigned *)(base + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(base + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(base + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+    r->cq_head = (unsigned *)(base + p.cq_off.head);
+    r->cq_tail = (unsigned *)(base + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(base + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(base + p.cq_off.cqes);
+
+    // Кольцо буферов приёма: ядро само выбирает буфер для каждого recv,
+    // поэтому память нужна под URING_BUF_COUNT буферов, а не под каждое соединение.
+    r->br_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    r->br = mmap(NULL, r->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    r->bufs = malloc((size_t)URING_BUF_COUNT * URING_BUF_SIZE);
+    if (r->br == MAP_FAILED || !r->bufs) {
+        if (r->br == MAP_FAILED) r->br = NULL;
+        uring_free(r);
+        errno = ENOMEM;
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = URING_BGID;
+    if (sys_uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        uring_free(r);
+        return -1;
+    }
+    for (unsigned i = 0; i < URING_BUF_COUNT; ++i) uring_buf_add(r, (unsigned short)i);
+    uring_buf_publish(r);
+    return 0;
+}
+
+static int uring_submit(uring_t *r, unsigned wait_nr) {
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    int ret = sys_uring_enter(r->fd, r->to_submit, wait_nr, flags);
+    if (ret >= 0) {
+        r->to_submit -= (unsigned)ret > r->to_submit ? r->to_submit : (unsigned)ret;
+    } else if (errno == EINTR || errno == EBUSY || errno == EAGAIN) {
+        ret = 0;  // переполнение CQ или сигнал: сначала разбираем завершения
+    }
+    return ret;
+}
+
+static struct io_uring_sqe *uring_sqe(uring_t *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local_tail - head >= r->sq_entries) {
+        uring_submit(r, 0);
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (r->sq_local_tail - head >= r->sq_entries) return NULL;
+    }
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    r->to_submit++;
+    return sqe;
+}
+
+static uint64_t udata(lconn_t *u, unsigned op) {
+    return (uint64_t)(uintptr_t)u | op;
+}
+
+static void ur_arm_recv(loop_t *l, lconn_t *u) {
+    struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = u->c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = udata(u, UOP_RECV);
+    u->recv_armed = 1;
+}
+
+static void ur_cancel_recv(loop_t *l, lconn_t *u) {
+    struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = udata(u, UOP_RECV);
+    sqe->user_data = udata(u, UOP_CANCEL);
+    u->cancel_inflight = 1;
+}
+
+static void ur_arm_accept(loop_t *l, int i) {
+    struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_set[i];
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;  // блокирующий: иначе io_uring вернёт -EAGAIN вместо ожидания
+    sqe->user_data = ((uint64_t)i << 8) | UOP_ACCEPT;
+    l->accept_armed[i] = 1;
+}
+
+static void ur_arm_tick(loop_t *l) {
+    struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+    if (!sqe) return;
+    l->ring.tick.tv_sec = 0;
+    l->ring.tick.tv_nsec = EVLOOP_TICK_MS * 1000000LL;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&l->ring.tick;
+    sqe->len = 1;
+    sqe->user_data = UOP_TICK;
+}
+
+// Отправляет накопленный вывод одной цепочкой send по URING_SEND_CHUNK байт,
+// связанных IOSQE_IO_LINK: порядок сохраняется, а всё уходит за один
+// io_uring_enter. Пока цепочка в полёте, новый вывод пишется в c->out.
+static void ur_send(loop_t *l, lconn_t *u) {
+    conn_t *c = u->c;
+    if (u->sends_inflight || c->dead) return;
+    if (u->slen == 0) {
+        if (c->out_len == 0) return;
+        char *tmp = u->sbuf;
+        size_t tmp_size = u->sbuf_size;
+        u->sbuf = c->out;
+        u->sbuf_size = c->out_size;
+        u->slen = c->out_len;
+        u->ssent = 0;
+        if (!tmp) {
+            tmp = malloc(OUT_BUF_SIZE);
+            tmp_size = OUT_BUF_SIZE;
+            if (!tmp) {
+                c->dead = 1;
+                return;
+            }
+        }
+        c->out = tmp;
+        c->out_size = tmp_size;
+        c->out_len = 0;
+        c->out_off = 0;
+    }
+    size_t off = u->ssent;
+    while (off < u->slen) {
+        struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+        if (!sqe) break;
+        size_t len = u->slen - off;
+        if (len > URING_SEND_CHUNK) len = URING_SEND_CHUNK;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = c->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(u->sbuf + off);
+        sqe->len = (unsigned)len;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = udata(u, UOP_SEND);
+        off += len;
+        if (off < u->slen) sqe->flags = IOSQE_IO_LINK;
+        u->sends_inflight++;
+    }
+}
+
+static size_t ur_pending(const lconn_t *u) {
+    return (u->slen - u->ssent) + conn_pending(u->c);
+}
+
+// Разбирает принятые данные, пока клиент забирает вывод.
+static void ur_process(lconn_t *u) {
+    conn_t *c = u->c;
+    size_t used = 0;
+    while (!u->closing && !c->dead && (c->walk || used < u->rxq_len)) {
+        if (ur_pending(u) > OUT_BUF_SIZE) {
+            if (!u->paused) {
+                u->paused = 1;
+                stats_read_paused();
+                log_debug("Client %d: output backlog %zu bytes, reading paused", c->fd, ur_pending(u));
+            }
+            break;
+        }
+        u->paused = 0;
+        // Приостановленный LIST/LISTR продолжается раньше нового ввода.
+        if (!c->walk) {
+            size_t room = BUF_SIZE - c->in_len;
+            size_t n = u->rxq_len - used < room ? u->rxq_len - used : room;
+            memcpy(c->in + c->in_len, u->rxq + used, n);
+            c->in_len += n;
+            used += n;
+        }
+        if (conn_input(c)) {
+            u->closing = 1;
+            u->quit = 1;
+        }
+        if (c->walk) break;  // ждёт отправки вывода
+    }
+    if (ur_pending(u) <= OUT_BUF_SIZE) u->paused = 0;
+    memmove(u->rxq, u->rxq + used, u->rxq_len - used);
+    u->rxq_len -= used;
+}
+
+// Продвигает соединение после любого события: отправка, приём,
+// приостановка recv, закрытие. 1 - соединение освобождено.
+static int ur_progress(loop_t *l, lconn_t *u) {
+    conn_t *c = u->c;
+    if (c->dead) u->closing = 1;
+    if (!u->closing) ur_process(u);
+    ur_send(l, u);
+    if (!u->closing) {
+        // Обратное давление: много неразобранного ввода - recv отменяется
+        // и взводится снова, когда клиент заберёт вывод.
+        if (u->rxq_len > URING_RXQ_HIGH) {
+            if (u->recv_armed && !u->cancel_inflight) ur_cancel_recv(l, u);
+        } else if (!u->recv_armed && !u->cancel_inflight) {
+            ur_arm_recv(l, u);
+        }
+        return 0;
+    }
+    if (u->quit && !c->dead && ur_pending(u) > 0) return 0;  // дописываем BYE
+    if (!u->shut) {
+        shutdown(c->fd, SHUT_RDWR);  // завершает многоразовый recv
+        u->shut = 1;
+    }
+    if (u->recv_armed || u->sends_inflight || u->cancel_inflight) return 0;
+    lconn_free(u);
+    return 1;
+}
+
+static void ur_on_recv(loop_t *l, lconn_t *u, struct io_uring_cqe *cqe) {
+    conn_t *c = u->c;
+    if (!(cqe->flags & IORING_CQE_F_MORE)) u->recv_armed = 0;
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe->res > 0 && !u->closing) {
+            size_t n = (size_t)cqe->res;
+            if (u->rxq_len + n > u->rxq_cap) {
+                size_t cap = u->rxq_cap ? u->rxq_cap : BUF_SIZE;
+                while (cap < u->rxq_len + n) cap *= 2;
+                char *p = realloc(u->rxq, cap);
+                if (!p) {
+                    c->dead = 1;
+                    n = 0;
+                } else {
+                    u->rxq = p;
+                    u->rxq_cap = cap;
+                }
+            }
+            memcpy(u->rxq + u->rxq_len, l->ring.bufs + (size_t)bid * URING_BUF_SIZE, n);
+            u->rxq_len += n;
+            stats_bytes_in(n);
+            c->last_active = stats_now_ns();
+        }
+        uring_buf_add(&l->ring, bid);
+        uring_buf_publish(&l->ring);
+    }
+    if (cqe->res == 0) {
+        if (!u->closing) log_event("Client %d disconnected (gracefully)", c->fd);
+        u->closing = 1;
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        if (!u->closing) log_event("Client %d disconnected (error: %s)", c->fd, strerror(-cqe->res));
+        u->closing = 1;
+    }
+    // -ENOBUFS: кольцо буферов было пусто; recv взводится заново в ur_progress.
+}
+
+static void ur_on_send(lconn_t *u, struct io_uring_cqe *cqe) {
+    conn_t *c = u->c;
+    u->sends_inflight--;
+    if (cqe->res > 0) {
+        u->ssent += (size_t)cqe->res;
+        stats_bytes_out((size_t)cqe->res);
+        c->last_active = stats_now_ns();
+    } else if (cqe->res < 0 && cqe->res != -ECANCELED && cqe->res != -EAGAIN && !c->dead) {
+        log_event("Client %d disconnected (send error: %s)", c->fd, strerror(-cqe->res));
+        c->dead = 1;
+    }
+    // Короткая отправка рвёт цепочку; отправленное - всегда префикс буфера,
+    // остаток уходит следующей цепочкой.
+    if (u->sends_inflight == 0 && u->ssent >= u->slen) u->slen = u->ssent = 0;
+}
+
+static void ur_accept(loop_t *l, int fd) {
+    stats_accept();
+    if (admit_client(fd) < 0) return;
+    lconn_t *u = lconn_new(l, fd, CONN_URING);
+    if (u) ur_progress(l, u);
+}
+
+static void ur_release_listeners(loop_t *l) {
+    for (int i = 0; i < listen_count; ++i) {
+        if (!l->accept_armed[i]) continue;
+        struct io_uring_sqe *sqe = uring_sqe(&l->ring);
+        if (!sqe) continue;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = ((uint64_t)i << 8) | UOP_ACCEPT;
+        sqe->user_data = UOP_LCANCEL;
+    }
+    l->accepting = 0;
+}
+
+static int ur_accepts_armed(const loop_t *l) {
+    for (int i = 0; i < listen_count; ++i)
+        if (l->accept_armed[i]) return 1;
+    return 0;
+}
+
+static void *ur_loop(void *arg) {
+    loop_t *l = arg;
+    uring_t *r = &l->ring;
+    int released = 0;
+    for (int i = 0; i < listen_count; ++i) ur_arm_accept(l, i);
+    ur_arm_tick(l);
+    int stopping = 0;
+    for (;;) {
+        if (l->accepting && atomic_load(&stop_accepting)) ur_release_listeners(l);
+        // Отписка засчитывается, когда все accept действительно завершились:
+        // после этого main может закрыть слушающие сокеты.
+        if (!l->accepting && !released && !ur_accepts_armed(l)) {
+            released = 1;
+            atomic_fetch_add(&accept_released, 1);
+        }
+        if (loop_should_exit(l) && !stopping) {
+            stopping = 1;
+            if (l->accepting) ur_release_listeners(l);
+            for (lconn_t *u = l->conns, *next; u; u = next) {
+                next = u->next;
+                u->closing = 1;
+                u->quit = 0;
+                ur_progress(l, u);
+            }
+        }
+        if (stopping && l->nconns == 0 && released) break;
+
+        if (uring_submit(r, 1) < 0) {
+            perror("io_uring_enter");
+            break;
+        }
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        int ticked = 0;
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            uint64_t ud = cqe->user_data;
+            unsigned op = (unsigned)(ud & UOP_MASK);
+            if (op == UOP_TICK) {
+                ticked = 1;
+                continue;
+            }
+            if (op == UOP_LCANCEL) continue;
+            if (op == UOP_ACCEPT) {
+                int i = (int)(ud >> 8);
+                if (!(cqe->flags & IORING_CQE_F_MORE)) l->accept_armed[i] = 0;
+                if (cqe->res >= 0) {
+                    if (l->accepting && !stopping) ur_accept(l, cqe->res);
+                    else close(cqe->res);
+                }
+                if (!l->accept_armed[i] && l->accepting && !stopping) ur_arm_accept(l, i);
+                continue;
+            }
+            lconn_t *u = (lconn_t *)(uintptr_t)(ud & ~UOP_MASK);
+            if (op == UOP_RECV) ur_on_recv(l, u, cqe);
+            else if (op == UOP_SEND) ur_on_send(u, cqe);
+            else if (op == UOP_CANCEL) u->cancel_inflight = 0;
+            // Освобождённое соединение больше не встретится: после
+            // shutdown все его операции уже завершены.
+            ur_progress(l, u);
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+        if (ticked) {
+            ur_arm_tick(l);
+            uint64_t now = stats_now_ns();
+            if (now - l->last_sweep >= 1000000000ULL) {
+                l->last_sweep = now;
+                for (lconn_t *u = l->conns, *next; u; u = next) {
+                    next = u->next;
+                    if (!u->closing && lconn_idle(u, now)) {
+                        u->closing = 1;
+                        ur_progress(l, u);
+                    }
+                }
+            }
+        }
+    }
+    uring_free(r);
+    return NULL;
+}
+
+// ---------------------------------------------------------------- запуск
+
+int evloop_start(backend_t *backend, int nloops, const int *listen_fds, int nlisten,
+                 int root_fd, const char *root) {
+    if (nloops < 1) nloops = 1;
+    if (nloops > EVLOOP_MAX_LOOPS) nloops = EVLOOP_MAX_LOOPS;
+    if (nlisten > EVLOOP_MAX_LISTEN) nlisten = EVLOOP_MAX_LISTEN;
+    for (int i = 0; i < nlisten; ++i) listen_set[i] = listen_fds[i];
+    listen_count = nlisten;
+    server_root_fd = root_fd;
+    server_root = root;
+    atomic_store(&stop_accepting, 0);
+    atomic_store(&accept_released, 0);
+
+    for (int i = 0; i < nloops; ++i) {
+        loop_t *l = &loops[i];
+        memset(l, 0, sizeof(*l));
+        l->id = i;
+        l->ring.fd = -1;
+        l->accepting = 1;
+        l->last_sweep = stats_now_ns();
+        if (*backend == BACKEND_URING && uring_init(&l->ring) < 0) {
+            log_warn("io_uring unavailable (%s), falling back to epoll", strerror(errno));
+            for (int j = 0; j < i; ++j) uring_free(&loops[j].ring);
+            *backend = BACKEND_EPOLL;
+            i = -1;  // начать заново с epoll
+            continue;
+        }
+        if (*backend == BACKEND_EPOLL && ep_init(l) < 0) {
+            perror("epoll");
+            for (int j = 0; j < i; ++j) close(loops[j].epfd);
+            return -1;
+        }
+        l->backend = *backend;
+    }
+    for (int i = 0; i < nloops; ++i) {
+        loop_t *l = &loops[i];
+        int rc = pthread_create(&l->tid, NULL, l->backend == BACKEND_URING ? ur_loop : ep_loop, l);
+        if (rc != 0) {
+            fprintf(stderr, "Error creating loop thread: %s\n", strerror(rc));
+            server_running = 0;
+            loop_count = i;
+            evloop_join();
+            return -1;
+        }
+    }
+    loop_count = nloops;
+    return 0;
+}
+
+void evloop_stop_accepting(void) {
+    atomic_store(&stop_accepting, 1);
+    while (atomic_load(&accept_released) < loop_count) {
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void evloop_join(void) {
+    for (int i = 0; i < loop_count; ++i) pthread_join(loops[i].tid, NULL);
+    loop_count = 0;
+}
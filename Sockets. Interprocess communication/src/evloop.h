@@ -0,0 +1,29 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+// Событийные циклы вместо потока на клиента: несколько потоков, каждый
+// обслуживает много соединений через epoll или io_uring (многоразовый accept,
+// recv в буферы из общего кольца, связанные цепочки send). Команды
+// выполняются теми же обработчиками, что и в потоковой модели (server.h).
+
+typedef enum {
+    BACKEND_THREADS = 0,  // поток на клиента (по умолчанию)
+    BACKEND_EPOLL,
+    BACKEND_URING
+} backend_t;
+
+int backend_parse(const char *name, backend_t *out);
+const char *backend_name(backend_t backend);
+
+// Запускает nloops потоков. Если io_uring недоступен (ядро, seccomp,
+// io_uring_disabled), *backend меняется на BACKEND_EPOLL. 0 или -1.
+int evloop_start(backend_t *backend, int nloops, const int *listen_fds, int nlisten,
+                 int root_fd, const char *root);
+// Циклы перестают принимать соединения; возвращается, когда все циклы
+// отписались от слушающих сокетов (их можно закрывать).
+void evloop_stop_accepting(void);
+// Ждёт завершения циклов: после server_running = 0 они закрывают соединения,
+// после evloop_stop_accepting - выходят, когда соединений не осталось.
+void evloop_join(void);
+
+#endif
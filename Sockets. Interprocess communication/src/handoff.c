@@ -0,0 +1,126 @@
+#include "handoff.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int handoff_addr(const char *ctl_path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(ctl_path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, ctl_path);
+    return 0;
+}
+
+int handoff_take(const char *ctl_path, int *fds, int max_fds) {
+    struct sockaddr_un addr;
+    if (handoff_addr(ctl_path, &addr) < 0) return -1;
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(s);
+        if (err == ENOENT) return 0;
+        if (err == ECONNREFUSED) {  // процесс умер, файл остался
+            unlink(ctl_path);
+            return 0;
+        }
+        errno = err;
+        return -1;
+    }
+
+    int count = 0;
+    char data[16];
+    char cbuf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    struct iovec iov = { .iov_base = data, .iov_len = sizeof(data) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    ssize_t n;
+    do {
+        n = recvmsg(s, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        close(s);
+        if (n == 0) errno = ECONNRESET;
+        return -1;
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        int k = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < k; ++i) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+            if (count < max_fds) fds[count++] = fd;
+            else close(fd);
+        }
+    }
+
+    // EOF означает, что старый процесс перестал принимать и освободил ctl_path.
+    while ((n = read(s, data, sizeof(data))) > 0 || (n < 0 && errno == EINTR))
+        ;
+    close(s);
+    if (count == 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    return count;
+}
+
+int handoff_listen(const char *ctl_path) {
+    struct sockaddr_un addr;
+    if (handoff_addr(ctl_path, &addr) < 0) return -1;
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(s, 1) < 0) {
+        int err = errno;
+        close(s);
+        errno = err;
+        return -1;
+    }
+    return s;
+}
+
+int handoff_give(int ctl_fd, const int *fds, int n) {
+    if (n < 1 || n > HANDOFF_MAX_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+    int s = accept4(ctl_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (s < 0) return -1;
+    char cbuf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    memset(cbuf, 0, sizeof(cbuf));
+    char tag = 'L';
+    struct iovec iov = { .iov_base = &tag, .iov_len = 1 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * n);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * n);
+    ssize_t r;
+    do {
+        r = sendmsg(s, &msg, MSG_NOSIGNAL);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+        int err = errno;
+        close(s);
+        errno = err;
+        return -1;
+    }
+    return s;
+}
@@ -0,0 +1,23 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+// Горячий перезапуск: передача слушающих сокетов новому процессу.
+// Работающий сервер держит управляющий Unix-сокет ctl_path. Новый процесс
+// подключается к нему и получает дескрипторы через SCM_RIGHTS; старый после
+// отправки перестаёт принимать соединения, удаляет ctl_path и закрывает
+// управляющее соединение - это сигнал новому процессу занять ctl_path.
+
+#define HANDOFF_MAX_FDS 8
+
+// Забирает сокеты у работающего сервера. Возвращает число полученных
+// дескрипторов, 0 - предшественника нет (устаревший ctl_path удаляется), -1 - ошибка.
+int handoff_take(const char *ctl_path, int *fds, int max_fds);
+
+// Создаёт управляющий сокет. Возвращает слушающий дескриптор или -1.
+int handoff_listen(const char *ctl_path);
+
+// Принимает запрос преемника на ctl_fd и отправляет ему fds.
+// Возвращает дескриптор управляющего соединения (закрыть после передачи) или -1.
+int handoff_give(int ctl_fd, const int *fds, int n);
+
+#endif
@@ -0,0 +1,79 @@
+#include "histogram.h"
+
+#include <string.h>
+
+static size_t hist_index(uint64_t v) {
+    if (v < HIST_SUB_COUNT) return (size_t)v;
+    int e = 63 - __builtin_clzll(v);
+    if (e > HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    return (size_t)(e - HIST_SUB_BITS + 1) * HIST_SUB_COUNT +
+           (size_t)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+static uint64_t hist_upper_bound(size_t idx) {
+    if (idx < HIST_SUB_COUNT) return idx;
+    int e = (int)(idx / HIST_SUB_COUNT) + HIST_SUB_BITS - 1;
+    uint64_t sub = idx % HIST_SUB_COUNT;
+    uint64_t width = 1ULL << (e - HIST_SUB_BITS);
+    return (1ULL << e) + (sub + 1) * width - 1;
+}
+
+void hist_reset(histogram_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void hist_record(histogram_t *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value > h->max) h->max = value;
+}
+
+void hist_record_shared(histogram_t *h, uint64_t value) {
+    __atomic_fetch_add(&h->counts[hist_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+    uint64_t cur = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&h->max, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void hist_snapshot(const histogram_t *h, histogram_t *out) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+        out->counts[i] = __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        total += out->counts[i];
+    }
+    // total считаем по корзинам, чтобы процентили не выходили за пределы.
+    out->total = total;
+    out->sum = __atomic_load_n(&h->sum, __ATOMIC_RELAXED);
+    out->max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+void hist_merge(histogram_t *dst, const histogram_t *src) {
+    for (size_t i = 0; i < HIST_BUCKETS; ++i) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const histogram_t *h, double p) {
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > h->total) rank = h->total;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t ub = hist_upper_bound(i);
+            return ub < h->max ? ub : h->max;
+        }
+    }
+    return h->max;
+}
+
+uint64_t hist_mean(const histogram_t *h) {
+    return h->total ? h->sum / h->total : 0;
+}
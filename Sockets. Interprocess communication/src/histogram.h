@@ -0,0 +1,34 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Лог-линейная гистограмма в стиле HDR: 16 подкорзин на каждую степень двойки,
+// относительная погрешность ~6%, диапазон до 2^40 (в наносекундах ~18 минут).
+#define HIST_SUB_BITS  4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP   40
+#define HIST_BUCKETS   ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+} histogram_t;
+
+void hist_reset(histogram_t *h);
+// Запись одним потоком-владельцем.
+void hist_record(histogram_t *h, uint64_t value);
+// Запись из нескольких потоков (атомарные инкременты).
+void hist_record_shared(histogram_t *h, uint64_t value);
+// Копия, согласованная по каждому счётчику (для чтения во время записи).
+void hist_snapshot(const histogram_t *h, histogram_t *out);
+void hist_merge(histogram_t *dst, const histogram_t *src);
+
+// p в диапазоне [0, 100]; возвращает верхнюю границу корзины.
+uint64_t hist_percentile(const histogram_t *h, double p);
+uint64_t hist_mean(const histogram_t *h);
+
+#endif
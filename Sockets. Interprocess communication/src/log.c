@@ -0,0 +1,350 @@
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_RING_SIZE   (32 * 1024)  // байт на поток, степень двойки
+#define LOG_RECORD_MAX  1024         // длиннее - обрезаем
+#define LOG_BATCH_SIZE  (64 * 1024)  // размер одного write()
+#define LOG_FLUSH_MS    20
+#define LOG_ALIGN       16
+#define LOG_ALIGN_UP(n) (((n) + LOG_ALIGN - 1) & ~(uint64_t)(LOG_ALIGN - 1))
+
+// Заголовок записи в кольце. len == 0 - маркер "дальше с начала кольца".
+typedef struct {
+    uint32_t len;
+    uint32_t reserved;
+    uint64_t ts_ns;
+} log_hdr_t;
+
+typedef struct log_ring {
+    // head двигает только поток-владелец, tail - только фоновый писатель.
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) atomic_int orphaned;   // поток-владелец завершился
+    atomic_ulong dropped;               // записи, не поместившиеся в кольцо
+    uint64_t snap;                      // head на момент сбора пачки (писатель)
+    struct log_ring *next;
+    _Alignas(LOG_ALIGN) unsigned char data[LOG_RING_SIZE];
+} log_ring_t;
+
+typedef struct {
+    uint64_t ts_ns;
+    unsigned long order;
+    const char *text;
+    uint32_t len;
+} log_item_t;
+
+static atomic_int log_level_cur = LOG_DEBUG;
+static atomic_int log_active = 0;
+static atomic_int log_stop = 0;
+static int log_fd = STDOUT_FILENO;
+static int log_fd_owned = 0;
+
+static pthread_t log_writer;
+static pthread_key_t log_ring_key;
+static pthread_mutex_t log_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_ring_t *log_rings = NULL;
+
+// Используются только фоновым писателем.
+static log_item_t *log_items = NULL;
+static size_t log_items_cap = 0;
+static char log_batch[LOG_BATCH_SIZE];
+static size_t log_batch_len = 0;
+
+// Кэш отформатированного времени: strftime/localtime_r только при смене секунды,
+// при смене миллисекунды переписываются три цифры.
+static _Thread_local log_ring_t *tls_ring = NULL;
+static _Thread_local struct {
+    long long ms_key;
+    time_t sec;
+    size_t sec_len;
+    size_t len;
+    char text[48];
+} tls_ts = { -1, (time_t)-1, 0, 0, "" };
+
+static const char *const log_level_names[] = { "error", "warn", "info", "debug" };
+
+int log_level_parse(const char *name, log_level_t *out) {
+    for (int i = LOG_ERROR; i <= LOG_DEBUG; ++i) {
+        if (strcasecmp(name, log_level_names[i]) == 0) {
+            *out = (log_level_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *log_level_name(log_level_t level) {
+    if (level < LOG_ERROR || level > LOG_DEBUG) return "?";
+    return log_level_names[level];
+}
+
+int log_enabled(log_level_t level) {
+    return (int)level <= atomic_load_explicit(&log_level_cur, memory_order_relaxed);
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+static size_t log_timestamp(const struct timespec *now, char *out) {
+    long long ms_key = (long long)now->tv_sec * 1000 + now->tv_nsec / 1000000;
+    if (ms_key != tls_ts.ms_key) {
+        if (now->tv_sec != tls_ts.sec) {
+            struct tm tm;
+            localtime_r(&now->tv_sec, &tm);
+            tls_ts.sec_len = strftime(tls_ts.text, sizeof(tls_ts.text), "%Y.%m.%d-%H:%M:%S", &tm);
+            tls_ts.sec = now->tv_sec;
+        }
+        int ms = (int)(ms_key % 1000);
+        char *p = tls_ts.text + tls_ts.sec_len;
+        p[0] = '.';
+        p[1] = (char)('0' + ms / 100);
+        p[2] = (char)('0' + ms / 10 % 10);
+        p[3] = (char)('0' + ms % 10);
+        p[4] = ' ';
+        tls_ts.len = tls_ts.sec_len + 5;
+        tls_ts.ms_key = ms_key;
+    }
+    memcpy(out, tls_ts.text, tls_ts.len);
+    return tls_ts.len;
+}
+
+static void log_ring_release(void *p) {
+    log_ring_t *r = p;
+    atomic_store_explicit(&r->orphaned, 1, memory_order_release);
+}
+
+static log_ring_t *log_ring_get(void) {
+    if (tls_ring) return tls_ring;
+    log_ring_t *r = aligned_alloc(_Alignof(log_ring_t), sizeof(log_ring_t));
+    if (!r) return NULL;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->orphaned, 0);
+    atomic_init(&r->dropped, 0);
+    r->snap = 0;
+
+    pthread_mutex_lock(&log_registry_mutex);
+    r->next = log_rings;
+    log_rings = r;
+    pthread_mutex_unlock(&log_registry_mutex);
+
+    pthread_setspecific(log_ring_key, r);
+    tls_ring = r;
+    return r;
+}
+
+static void log_ring_push(log_ring_t *r, uint64_t ts_ns, const char *text, uint32_t len) {
+    uint64_t need = LOG_ALIGN_UP(sizeof(log_hdr_t) + len);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t pos = head & (LOG_RING_SIZE - 1);
+    size_t to_end = LOG_RING_SIZE - pos;
+    uint64_t total = need + (to_end < need ? to_end : 0);
+
+    if (LOG_RING_SIZE - (head - tail) < total) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (to_end < need) {
+        log_hdr_t wrap = { 0, 0, 0 };
+        memcpy(r->data + pos, &wrap, sizeof(wrap));
+        head += to_end;
+        pos = 0;
+    }
+    log_hdr_t hdr = { len, 0, ts_ns };
+    memcpy(r->data + pos, &hdr, sizeof(hdr));
+    memcpy(r->data + pos + sizeof(hdr), text, len);
+    atomic_store_explicit(&r->head, head + need, memory_order_release);
+}
+
+void log_msg(log_level_t level, const char *fmt, ...) {
+    if (!log_enabled(level)) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char line[LOG_RECORD_MAX];
+    size_t n = log_timestamp(&now, line);
+
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(line + n, sizeof(line) - n - 1, fmt, ap);
+    va_end(ap);
+    if (w < 0) w = 0;
+    if ((size_t)w > sizeof(line) - n - 2) w = (int)(sizeof(line) - n - 2);
+    n += (size_t)w;
+    line[n++] = '\n';
+
+    log_ring_t *r = atomic_load_explicit(&log_active, memory_order_acquire) ? log_ring_get() : NULL;
+    if (!r) {
+        // Журнал не запущен (или уже остановлен) - пишем синхронно.
+        write_all(log_fd, line, n);
+        return;
+    }
+    uint64_t ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    log_ring_push(r, ts_ns, line, (uint32_t)n);
+}
+
+static void log_batch_flush(void) {
+    if (log_batch_len > 0) {
+        write_all(log_fd, log_batch, log_batch_len);
+        log_batch_len = 0;
+    }
+}
+
+static void log_batch_append(const char *text, size_t len) {
+    if (log_batch_len + len > sizeof(log_batch)) log_batch_flush();
+    memcpy(log_batch + log_batch_len, text, len);
+    log_batch_len += len;
+}
+
+static int log_item_cmp(const void *a, const void *b) {
+    const log_item_t *x = a, *y = b;
+    if (x->ts_ns != y->ts_ns) return x->ts_ns < y->ts_ns ? -1 : 1;
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static int log_items_reserve(size_t n) {
+    if (n <= log_items_cap) return 0;
+    size_t cap = log_items_cap ? log_items_cap * 2 : 256;
+    while (cap < n) cap *= 2;
+    log_item_t *p = realloc(log_items, cap * sizeof(*p));
+    if (!p) return -1;
+    log_items = p;
+    log_items_cap = cap;
+    return 0;
+}
+
+// Собирает все готовые записи из колец, упорядочивает по времени и пишет пачкой.
+static void log_drain(void) {
+    pthread_mutex_lock(&log_registry_mutex);
+    log_ring_t *first = log_rings;
+    pthread_mutex_unlock(&log_registry_mutex);
+
+    size_t count = 0;
+    unsigned long dropped = 0;
+    for (log_ring_t *r = first; r; r = r->next) {
+        r->snap = atomic_load_explicit(&r->head, memory_order_acquire);
+        uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        while (t < r->snap) {
+            size_t pos = t & (LOG_RING_SIZE - 1);
+            log_hdr_t hdr;
+            memcpy(&hdr, r->data + pos, sizeof(hdr));
+            if (hdr.len == 0) {
+                t += LOG_RING_SIZE - pos;
+                continue;
+            }
+            if (log_items_reserve(count + 1) < 0) {
+                r->snap = t;
+                break;
+            }
+            log_items[count].ts_ns = hdr.ts_ns;
+            log_items[count].order = count;
+            log_items[count].text = (const char *)(r->data + pos + sizeof(hdr));
+            log_items[count].len = hdr.len;
+            count++;
+            t += LOG_ALIGN_UP(sizeof(hdr) + hdr.len);
+        }
+        dropped += atomic_exchange_explicit(&r->dropped, 0, memory_order_relaxed);
+    }
+
+    if (count > 1) qsort(log_items, count, sizeof(*log_items), log_item_cmp);
+    for (size_t i = 0; i < count; ++i) log_batch_append(log_items[i].text, log_items[i].len);
+    if (dropped > 0) {
+        char line[LOG_RECORD_MAX];
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        size_t n = log_timestamp(&now, line);
+        n += (size_t)snprintf(line + n, sizeof(line) - n, "Log: %lu records dropped (ring full)\n", dropped);
+        log_batch_append(line, n);
+    }
+    log_batch_flush();
+
+    for (log_ring_t *r = first; r; r = r->next)
+        atomic_store_explicit(&r->tail, r->snap, memory_order_release);
+
+    // Кольца завершившихся потоков освобождаем, когда они полностью вычитаны.
+    pthread_mutex_lock(&log_registry_mutex);
+    log_ring_t **pp = &log_rings;
+    while (*pp) {
+        log_ring_t *r = *pp;
+        if (atomic_load_explicit(&r->orphaned, memory_order_acquire) &&
+            atomic_load_explicit(&r->head, memory_order_acquire) ==
+            atomic_load_explicit(&r->tail, memory_order_relaxed)) {
+            *pp = r->next;
+            free(r);
+        } else {
+            pp = &r->next;
+        }
+    }
+    pthread_mutex_unlock(&log_registry_mutex);
+}
+
+static void *log_writer_main(void *arg) {
+    (void)arg;
+    struct timespec delay = { 0, LOG_FLUSH_MS * 1000000L };
+    for (;;) {
+        int stopping = atomic_load(&log_stop);
+        log_drain();
+        if (stopping) break;
+        nanosleep(&delay, NULL);
+    }
+    return NULL;
+}
+
+int log_init(const char *path, log_level_t level) {
+    atomic_store(&log_level_cur, level);
+    tzset();
+    if (path) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        log_fd = fd;
+        log_fd_owned = 1;
+    }
+    int rc = pthread_key_create(&log_ring_key, log_ring_release);
+    if (rc == 0) rc = pthread_create(&log_writer, NULL, log_writer_main, NULL);
+    if (rc != 0) {
+        if (log_fd_owned) close(log_fd);
+        log_fd = STDOUT_FILENO;
+        log_fd_owned = 0;
+        errno = rc;
+        return -1;
+    }
+    atomic_store(&log_stop, 0);
+    atomic_store_explicit(&log_active, 1, memory_order_release);
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!atomic_load(&log_active)) return;
+    atomic_store(&log_stop, 1);
+    pthread_join(log_writer, NULL);
+    atomic_store_explicit(&log_active, 0, memory_order_release);
+    // Повторный проход: записи, попавшие в кольца во время последнего сбора.
+    log_drain();
+    if (log_fd_owned) {
+        close(log_fd);
+        log_fd = STDOUT_FILENO;
+        log_fd_owned = 0;
+    }
+}
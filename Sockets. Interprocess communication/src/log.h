@@ -0,0 +1,34 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Асинхронный журнал сервера.
+// Каждый поток пишет записи в свой lock-free кольцевой буфер (один писатель,
+// один читатель), фоновый поток собирает их пачками и пишет в файл крупными
+// write(). Форматирование времени кэшируется в потоке с точностью до миллисекунды.
+
+typedef enum {
+    LOG_ERROR = 0,
+    LOG_WARN  = 1,
+    LOG_INFO  = 2,
+    LOG_DEBUG = 3
+} log_level_t;
+
+// path == NULL -> stdout. Возвращает 0 или -1 (errno установлен).
+int log_init(const char *path, log_level_t level);
+// Сбрасывает все накопленные записи и останавливает фоновый поток.
+void log_shutdown(void);
+
+int log_level_parse(const char *name, log_level_t *out);
+const char *log_level_name(log_level_t level);
+int log_enabled(log_level_t level);
+
+void log_msg(log_level_t level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Совместимость со старым синхронным log_event: уровень INFO.
+#define log_event(...) log_msg(LOG_INFO, __VA_ARGS__)
+#define log_debug(...) log_msg(LOG_DEBUG, __VA_ARGS__)
+#define log_warn(...)  log_msg(LOG_WARN, __VA_ARGS__)
+#define log_error(...) log_msg(LOG_ERROR, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Двоичный режим протокола myserver.
+// Включается текстовой командой "HELLO BIN": сервер отвечает строкой
+// PROTO_BIN_ACK и приглашением, после чего обе стороны обмениваются только
+// кадрами. Кадр: 12-байтный заголовок (сетевой порядок байт) и len байт данных.
+//   type(1) flags(1) reserved(2) req_id(4) len(4)
+// Все кадры ответа несут req_id команды, на которую отвечают.
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#define PROTO_BIN_HELLO "HELLO BIN"
+#define PROTO_BIN_ACK   "HELLO BIN OK"
+
+#define FRAME_HDR_SIZE    12
+#define FRAME_MAX_PAYLOAD (64 * 1024)
+// Наибольший текст команды в FRAME_CMD: кадр целиком должен поместиться во
+// входной буфер сервера (BUF_SIZE в server.h), иначе это ошибка протокола.
+#define FRAME_MAX_CMD (4096 - FRAME_HDR_SIZE)
+
+typedef enum {
+    FRAME_CMD   = 1,  // клиент -> сервер: текст команды без '\n'
+    FRAME_TEXT  = 2,  // строка ответа
+    FRAME_ENTRY = 3,  // элемент LIST, см. ENTRY_*
+    FRAME_END   = 4,  // конец ответа; данные - текущий каталог (без '>')
+    FRAME_ERROR = 5,  // сообщение об ошибке
+    FRAME_BYE   = 6   // сервер закрывает сессию
+} frame_type_t;
+
+// Данные FRAME_ENTRY: kind(1) pad(1) name_len(2) size(8) name[name_len] target[...]
+#define ENTRY_HDR_SIZE 12
+
+typedef enum {
+    ENTRY_FILE      = 'f',
+    ENTRY_DIR       = 'd',
+    ENTRY_LINK      = 'l',  // target - куда указывает ссылка
+    ENTRY_LINK_LINK = 'L'   // ссылка на ссылку; target - цель второй ссылки
+} entry_kind_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t req_id;
+    uint32_t len;
+} frame_hdr_t;
+
+static inline void frame_put_hdr(unsigned char *p, uint8_t type, uint32_t req_id, uint32_t len) {
+    uint32_t id_n = htonl(req_id), len_n = htonl(len);
+    p[0] = type;
+    p[1] = 0;
+    p[2] = 0;
+    p[3] = 0;
+    memcpy(p + 4, &id_n, 4);
+    memcpy(p + 8, &len_n, 4);
+}
+
+static inline void frame_get_hdr(const unsigned char *p, frame_hdr_t *h) {
+    uint32_t id_n, len_n;
+    memcpy(&id_n, p + 4, 4);
+    memcpy(&len_n, p + 8, 4);
+    h->type = p[0];
+    h->flags = p[1];
+    h->req_id = ntohl(id_n);
+    h->len = ntohl(len_n);
+}
+
+static inline void entry_put_hdr(unsigned char *p, uint8_t kind, uint16_t name_len, uint64_t size) {
+    uint16_t nl_n = htons(name_len);
+    uint32_t hi = htonl((uint32_t)(size >> 32)), lo = htonl((uint32_t)size);
+    p[0] = kind;
+    p[1] = 0;
+    memcpy(p + 2, &nl_n, 2);
+    memcpy(p + 4, &hi, 4);
+    memcpy(p + 8, &lo, 4);
+}
+
+static inline void entry_get_hdr(const unsigned char *p, uint8_t *kind, uint16_t *name_len, uint64_t *size) {
+    uint16_t nl_n;
+    uint32_t hi, lo;
+    memcpy(&nl_n, p + 2, 2);
+    memcpy(&hi, p + 4, 4);
+    memcpy(&lo, p + 8, 4);
+    *kind = p[0];
+    *name_len = ntohs(nl_n);
+    *size = ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+}
+
+#endif
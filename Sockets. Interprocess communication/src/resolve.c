@@ -0,0 +1,135 @@
+#include "resolve.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/openat2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define RESOLVE_MAX_DEPTH 256
+#define RESOLVE_MAX_LINKS 40
+
+static int openat2_unsupported = 0;
+
+// Обход по компонентам: каждый открывается с O_PATH|O_NOFOLLOW, ".."
+// снимает уровень со стека (не выше корня), ссылки подставляются в остаток пути.
+static int resolve_walk(int root_fd, const char *path, int want_dir) {
+    char buf[2][PATH_MAX * 2];
+    int cur_buf = 0;
+    if (snprintf(buf[0], sizeof(buf[0]), "%s", path) >= (int)sizeof(buf[0])) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char *rest = buf[0];
+    int stack[RESOLVE_MAX_DEPTH];
+    int depth = 0, links = 0, err = 0;
+    stack[0] = root_fd;
+
+    while (*rest) {
+        while (*rest == '/') rest++;
+        if (!*rest) break;
+        char *slash = strchr(rest, '/');
+        size_t len = slash ? (size_t)(slash - rest) : strlen(rest);
+        char name[NAME_MAX + 1];
+        if (len > NAME_MAX) { err = ENAMETOOLONG; goto fail; }
+        memcpy(name, rest, len);
+        name[len] = '\0';
+        rest += len;
+
+        if (strcmp(name, ".") == 0) continue;
+        if (strcmp(name, "..") == 0) {
+            if (depth == 0) { err = EXDEV; goto fail; }
+            close(stack[depth--]);
+            continue;
+        }
+
+        int fd = openat(stack[depth], name, O_PATH | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) { err = errno; goto fail; }
+        struct stat st;
+        if (fstatat(fd, "", &st, AT_EMPTY_PATH) < 0) { err = errno; close(fd); goto fail; }
+
+        if (S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t r = readlinkat(fd, "", target, sizeof(target) - 1);
+            close(fd);
+            if (r < 0) { err = errno; goto fail; }
+            target[r] = '\0';
+            if (target[0] == '/') { err = EXDEV; goto fail; }
+            if (++links > RESOLVE_MAX_LINKS) { err = ELOOP; goto fail; }
+            int next = 1 - cur_buf;
+            if (snprintf(buf[next], sizeof(buf[next]), "%s%s", target, rest) >= (int)sizeof(buf[next])) {
+                err = ENAMETOOLONG;
+                goto fail;
+            }
+            cur_buf = next;
+            rest = buf[cur_buf];
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            // Не каталог допустим только последним компонентом.
+            const char *p = rest;
+            while (*p == '/') p++;
+            if (*p || *rest == '/' || want_dir) { err = ENOTDIR; close(fd); goto fail; }
+            while (depth > 0) close(stack[depth--]);
+            return fd;
+        }
+        if (depth + 1 >= RESOLVE_MAX_DEPTH) { err = ENAMETOOLONG; close(fd); goto fail; }
+        stack[++depth] = fd;
+    }
+
+    if (depth == 0) {
+        int fd = openat(root_fd, ".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) err = errno;
+        else return fd;
+        goto fail;
+    }
+    {
+        int fd = stack[depth--];
+        while (depth > 0) close(stack[depth--]);
+        return fd;
+    }
+
+fail:
+    while (depth > 0) close(stack[depth--]);
+    errno = err;
+    return -1;
+}
+
+int resolve_beneath(int root_fd, const char *path, int want_dir) {
+    while (*path == '/') path++;
+    if (*path == '\0') path = ".";
+    if (!openat2_unsupported) {
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = O_PATH | O_CLOEXEC | (want_dir ? O_DIRECTORY : 0);
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        long fd = syscall(SYS_openat2, root_fd, path, &how, sizeof(how));
+        if (fd >= 0) return (int)fd;
+        if (errno != ENOSYS) return -1;
+        openat2_unsupported = 1;
+    }
+    return resolve_walk(root_fd, path, want_dir);
+}
+
+int resolve_rel_path(int fd, const char *root, char *out, size_t size) {
+    char link[64], real[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t r = readlink(link, real, sizeof(real) - 1);
+    if (r < 0) return -1;
+    real[r] = '\0';
+    size_t root_len = strlen(root);
+    // Корень "/" - особый случай: realpath корня не оканчивается на '/'.
+    if (root_len == 1 && root[0] == '/') root_len = 0;
+    if (strncmp(real, root, root_len) != 0 || (real[root_len] != '/' && real[root_len] != '\0'))
+        return -1;
+    const char *rel = real + root_len;
+    while (*rel == '/') rel++;
+    if (strlen(rel) >= size) return -1;
+    strcpy(out, rel);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include <stddef.h>
+
+// Ограниченное корнем разрешение путей относительно дескриптора каталога.
+// Используется openat2(RESOLVE_BENEATH); если ядро его не поддерживает -
+// эквивалентный обход по компонентам с O_PATH|O_NOFOLLOW. Выход за пределы
+// корня ("..", абсолютные ссылки) даёт ошибку EXDEV.
+
+// Возвращает O_PATH-дескриптор (при want_dir - только каталог) или -1.
+int resolve_beneath(int root_fd, const char *path, int want_dir);
+
+// Путь каталога fd относительно root (без ведущего '/'); root - realpath корня.
+// Возвращает 0 или -1, если путь определить нельзя.
+int resolve_rel_path(int fd, const char *root, char *out, size_t size);
+
+#endif
@@ -13,13 +13,28 @@
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <ctype.h>
 #include <signal.h> // Для обработки сигналов
 #include <poll.h>   // FIX: Добавлен для struct pollfd, POLLIN, poll()
 
-#define BACKLOG 10
-#define BUF_SIZE 4096
+#include "log.h"
+#include "evloop.h"
+#include "handoff.h"
+#include "protocol.h"
+#include "resolve.h"
+#include "server.h"
+#include "stats.h"
+#include "unixaddr.h"
+
+#define DEFAULT_BACKLOG 128
+#define DEFAULT_MAX_CONNS 256
+#define DEFAULT_OUT_CAP (1024 * 1024)
+#define DEFAULT_IDLE_TIMEOUT 300
+#define LISTR_MAX_DEPTH 64
+#define LISTR_FLUSH_BYTES (8 * 1024)
+#define LISTR_FLUSH_NS (5 * 1000000ULL)
 
 #ifndef NAME_MAX
 #define NAME_MAX 255
@@ -28,37 +43,30 @@
 
 // Глобальный флаг для управления циклом сервера
 volatile sig_atomic_t server_running = 1;
+volatile sig_atomic_t shutdown_signal = 0;
 // Мьютекс и условная переменная для отслеживания активных потоков
 pthread_mutex_t active_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t active_threads_cond = PTHREAD_COND_INITIALIZER;
 int active_threads_count = 0;
 
+// Ограничения (задаются ключами командной строки)
+static int max_conns = DEFAULT_MAX_CONNS;
+static int listen_backlog = DEFAULT_BACKLOG;
+static size_t out_cap = DEFAULT_OUT_CAP;       // максимум неотправленного вывода на соединение
+static int idle_timeout_s = DEFAULT_IDLE_TIMEOUT;  // 0 - без таймаута
+
 typedef struct {
     int client_fd;
+    int root_fd;       // O_PATH-дескриптор корня, общий для всех соединений
     char root[PATH_MAX];
 } client_args_t;
 
-void log_event(const char *fmt, ...) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    struct tm tm;
-    localtime_r(&tv.tv_sec, &tm);
-    char ts[64];
-    strftime(ts, sizeof(ts), "%Y.%m.%d-%H:%M:%S", &tm);
-    int ms = tv.tv_usec / 1000;
-    fprintf(stdout, "%s.%03d ", ts, ms);
-    va_list ap;
-    va_start(ap, fmt);
-    vfprintf(stdout, fmt, ap);
-    va_end(ap);
-    fprintf(stdout, "\n");
-    fflush(stdout);
-}
-
 // Обработчик сигналов (Ctrl+C, SIGTERM)
+// Журналирование из обработчика небезопасно - только запоминаем сигнал,
+// сообщение пишет основной цикл.
 void sig_handler(int signo) {
     if (signo == SIGINT || signo == SIGTERM) {
-        log_event("Received signal %d, initiating shutdown.", signo);
+        shutdown_signal = signo;
         server_running = 0; // Устанавливаем флаг для выхода из основного цикла
     }
 }
@@ -72,118 +80,677 @@ static char *trim(char *s) {
     return s;
 }
 
-int build_path(const char *root, const char *cwd, const char *target, char *out) {
-    char tmp[PATHBUF];
-    if (target[0] == '/') {
-        snprintf(tmp, sizeof(tmp), "%s%s", root, target);
-    } else {
-        snprintf(tmp, sizeof(tmp), "%s/%s/%s", root, cwd, target);
+// Путь target относительно корня: абсолютный - от корня, относительный - от cwd.
+static int join_path(const char *cwd, const char *target, char *out, size_t size) {
+    int n;
+    if (target[0] == '/' || cwd[0] == '\0') n = snprintf(out, size, "%s", target);
+    else n = snprintf(out, size, "%s/%s", cwd, target);
+    return (n < 0 || (size_t)n >= size) ? -1 : 0;
+}
+
+static uint64_t idle_timeout_ns(void) {
+    return (uint64_t)idle_timeout_s * 1000000000ULL;
+}
+
+int conn_idle_expired(const conn_t *c, uint64_t now) {
+    return idle_timeout_s > 0 && now - c->last_active > idle_timeout_ns();
+}
+
+// Отправляет сколько примет сокет, не блокируясь. -1 - соединение потеряно.
+// В режиме io_uring данные забирает и отправляет цикл (evloop.c).
+int conn_flush(conn_t *c) {
+    if (c->dead) return -1;
+    if (c->mode == CONN_URING) return 0;
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            log_event("Client %d disconnected (send error: %s)", c->fd, strerror(errno));
+            c->dead = 1;
+            return -1;
+        }
+        c->out_off += (size_t)n;
+        c->last_active = stats_now_ns();
+        stats_bytes_out((size_t)n);
     }
-    char realp[PATH_MAX];
-    if (!realpath(tmp, realp)) return -1;
-    if (strncmp(realp, root, strlen(root)) != 0) return -1;
-    strcpy(out, realp);
+    c->out_off = c->out_len = 0;
     return 0;
 }
-void sendall(int fd, const char *s) {
-    size_t len = strlen(s), sent = 0;
-    while (sent < len) {
-        ssize_t n = send(fd, s + sent, len - sent, 0);
-        if (n <= 0) return;
-        sent += n;
+
+size_t conn_pending(const conn_t *c) {
+    return c->out_len - c->out_off;
+}
+
+// Ждёт, пока неотправленного вывода станет не больше limit. Если клиент не
+// забирает данные дольше таймаута бездействия, соединение помечается мёртвым.
+// Событийный цикл ждать не может: там LIST/LISTR приостанавливаются у
+// предела (conn_room), а чтение команд - до отправки.
+static int conn_drain(conn_t *c, size_t limit) {
+    if (c->mode != CONN_THREAD) return conn_flush(c);
+    while (conn_flush(c) == 0 && conn_pending(c) > limit) {
+        if (!server_running) {  // остановка сервера: не ждём медленного клиента
+            c->dead = 1;
+            return -1;
+        }
+        if (conn_idle_expired(c, stats_now_ns())) {
+            log_warn("Client %d is not reading output, closing", c->fd);
+            stats_slow_close();
+            c->dead = 1;
+            return -1;
+        }
+        struct pollfd pfd = { .fd = c->fd, .events = POLLOUT };
+        if (poll(&pfd, 1, 100) < 0 && errno != EINTR) {
+            c->dead = 1;
+            return -1;
+        }
     }
+    return c->dead ? -1 : 0;
 }
 
-void handle_echo(int fd, const char *arg) {
-    sendall(fd, arg);
-    sendall(fd, "\n");
+void conn_write(conn_t *c, const void *data, size_t len) {
+    if (c->dead) return;
+    if (conn_pending(c) + len > out_cap && conn_drain(c, out_cap > len ? out_cap - len : 0) < 0)
+        return;
+    if (c->out_len + len > c->out_size && c->out_off > 0) {
+        memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+        c->out_len -= c->out_off;
+        c->out_off = 0;
+    }
+    if (c->out_len + len > c->out_size) {
+        size_t size = c->out_size;
+        while (size < c->out_len + len) size *= 2;
+        char *p = realloc(c->out, size);
+        if (!p) {
+            c->dead = 1;
+            return;
+        }
+        c->out = p;
+        c->out_size = size;
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
 }
 
-void handle_info(int fd) {
-    sendall(fd, "Hello from 'myserver'\n");
+void sendall(conn_t *c, const char *s) {
+    conn_write(c, s, strlen(s));
 }
 
-void handle_list(int fd, const char *root, const char *cwd) {
-    char path[PATHBUF];
-    if (build_path(root, cwd, ".", path) < 0) {
-        sendall(fd, "Error: Cannot access current directory.\n");
+static void send_frame(conn_t *c, frame_type_t type, const void *data, size_t len) {
+    unsigned char hdr[FRAME_HDR_SIZE];
+    frame_put_hdr(hdr, (uint8_t)type, c->req_id, (uint32_t)len);
+    conn_write(c, hdr, sizeof(hdr));
+    if (len > 0) conn_write(c, data, len);
+}
+
+// Ответы клиенту: в текстовом режиме - строки, в двоичном - типизированные кадры.
+static void reply_text(conn_t *c, const char *line) {
+    if (c->binary) {
+        send_frame(c, FRAME_TEXT, line, strlen(line));
+    } else {
+        sendall(c, line);
+        sendall(c, "\n");
+    }
+}
+
+static void reply_error(conn_t *c, const char *msg) {
+    if (c->binary) {
+        send_frame(c, FRAME_ERROR, msg, strlen(msg));
+    } else {
+        sendall(c, msg);
+        sendall(c, "\n");
+    }
+}
+
+static void reply_entry(conn_t *c, entry_kind_t kind, uint64_t size, const char *name, const char *target) {
+    size_t name_len = strlen(name), target_len = target ? strlen(target) : 0;
+    if (c->binary) {
+        unsigned char hdr[ENTRY_HDR_SIZE];
+        entry_put_hdr(hdr, (uint8_t)kind, (uint16_t)name_len, size);
+        unsigned char fhdr[FRAME_HDR_SIZE];
+        frame_put_hdr(fhdr, FRAME_ENTRY, c->req_id, (uint32_t)(sizeof(hdr) + name_len + target_len));
+        conn_write(c, fhdr, sizeof(fhdr));
+        conn_write(c, hdr, sizeof(hdr));
+        conn_write(c, name, name_len);
+        if (target_len > 0) conn_write(c, target, target_len);
         return;
     }
-    DIR *d = opendir(path);
+    sendall(c, name);
+    switch (kind) {
+        case ENTRY_DIR:       sendall(c, "/"); break;
+        case ENTRY_LINK:      sendall(c, " --> "); sendall(c, target); break;
+        case ENTRY_LINK_LINK: sendall(c, " -->> "); sendall(c, target); break;
+        default: break;
+    }
+    sendall(c, "\n");
+}
+
+static void reply_end(conn_t *c, const char *cwd) {
+    if (c->binary) {
+        send_frame(c, FRAME_END, cwd, strlen(cwd));
+    } else {
+        if (cwd[0] != '\0') sendall(c, cwd);
+        sendall(c, ">\n");
+    }
+}
+
+static void reply_bye(conn_t *c) {
+    if (c->binary) send_frame(c, FRAME_BYE, NULL, 0);
+    else sendall(c, "BYE\n");
+}
+
+void handle_echo(conn_t *c, const char *arg) {
+    reply_text(c, arg);
+}
+
+void handle_info(conn_t *c) {
+    reply_text(c, "Hello from 'myserver'");
+}
+
+void handle_stats(conn_t *c) {
+    char report[4096];
+    stats_format(report, sizeof(report));
+    char *save = NULL;
+    for (char *line = strtok_r(report, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        reply_text(c, line);
+}
+
+// Обход каталога для LIST и LISTR. Цикл событий не может ждать отправки,
+// поэтому, когда следующая запись не помещается в out_cap, обход
+// приостанавливается с открытыми каталогами и продолжается из conn_input,
+// когда клиент заберёт вывод. Приглашение и учёт команды - по окончании обхода.
+struct dir_walk {
+    int recursive;         // LISTR: пути от начала обхода; LIST: имена со ссылками
+    int max_depth;
+    int depth;             // открытых каталогов в dirs
+    int yield;             // io_uring: вернуть управление циклу для отправки
+    DIR *dirs[LISTR_MAX_DEPTH];
+    size_t base[LISTR_MAX_DEPTH];  // длина rel для записей каталога dirs[i]
+    char rel[PATHBUF];
+    uint64_t last_flush;
+    stats_cmd_t cmd_kind;
+    uint64_t cmd_start;
+};
+
+// Наибольшая запись обхода: строка LISTR с путём и целью ссылки или кадр ENTRY.
+#define WALK_ENTRY_MAX (2 * PATHBUF + 64 + FRAME_HDR_SIZE + ENTRY_HDR_SIZE)
+
+// Поместится ли запись из len байт. Поток клиента дождётся отправки в
+// conn_write; цикл событий сначала отправляет, что примет сокет.
+static int conn_room(conn_t *c, size_t len) {
+    if (c->mode == CONN_THREAD || conn_pending(c) + len <= out_cap) return 1;
+    conn_flush(c);
+    return conn_pending(c) + len <= out_cap;
+}
+
+// Записи читаются относительно дескриптора каталога, без сборки полных путей.
+static void list_entry(conn_t *c, int dfd, const char *name) {
+    struct stat st;
+    if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) return;
+    if (S_ISDIR(st.st_mode)) {
+        reply_entry(c, ENTRY_DIR, (uint64_t)st.st_size, name, NULL);
+    } else if (S_ISLNK(st.st_mode)) {
+        char linkto[PATHBUF];
+        ssize_t r = readlinkat(dfd, name, linkto, sizeof(linkto)-1);
+        if (r < 0) return;
+        linkto[r] = '\0';
+        // Показываем только ссылки, цель которых не выходит за корень.
+        char joined[PATHBUF];
+        if (join_path(c->cwd, linkto, joined, sizeof(joined)) < 0) return;
+        int tfd = resolve_beneath(c->root_fd, joined, 0);
+        if (tfd < 0) return;
+        close(tfd);
+        struct stat st2;
+        char real2[PATHBUF];
+        ssize_t r2 = -1;
+        if (fstatat(c->root_fd, joined[0] == '/' ? joined + 1 : joined, &st2, AT_SYMLINK_NOFOLLOW) == 0 &&
+            S_ISLNK(st2.st_mode))
+            r2 = readlinkat(c->root_fd, joined[0] == '/' ? joined + 1 : joined, real2, sizeof(real2)-1);
+        if (r2 > 0) {
+            real2[r2] = '\0';
+            reply_entry(c, ENTRY_LINK_LINK, (uint64_t)st.st_size, name, real2);
+        } else {
+            reply_entry(c, ENTRY_LINK, (uint64_t)st.st_size, name, linkto);
+        }
+    } else {
+        reply_entry(c, ENTRY_FILE, (uint64_t)st.st_size, name, NULL);
+    }
+}
+
+// Вывод LISTR уходит клиенту по мере обхода. В режиме io_uring отправляет
+// цикл, поэтому обход уступает ему управление.
+static void listr_maybe_flush(conn_t *c, struct dir_walk *w) {
+    if (conn_pending(c) == 0) return;
+    uint64_t now = stats_now_ns();
+    if (conn_pending(c) >= LISTR_FLUSH_BYTES || now - w->last_flush >= LISTR_FLUSH_NS) {
+        if (c->mode == CONN_URING) w->yield = 1;
+        else conn_flush(c);
+        w->last_flush = now;
+    }
+}
+
+static void listr_emit(conn_t *c, struct dir_walk *w, entry_kind_t kind, uint64_t size, const char *target) {
+    if (c->binary) {
+        reply_entry(c, kind, size, w->rel, target);
+    } else {
+        char line[PATHBUF * 2 + 64];
+        if (kind == ENTRY_LINK)
+            snprintf(line, sizeof(line), "%c %llu %s --> %s", (char)kind, (unsigned long long)size, w->rel, target);
+        else
+            snprintf(line, sizeof(line), "%c %llu %s%s", (char)kind, (unsigned long long)size, w->rel,
+                     kind == ENTRY_DIR ? "/" : "");
+        reply_text(c, line);
+    }
+    listr_maybe_flush(c, w);
+}
+
+static void walk_push(struct dir_walk *w, int dfd) {
+    DIR *d = fdopendir(dfd);
     if (!d) {
-        perror("opendir");
-        sendall(fd, "Error: Cannot open directory.\n");
+        close(dfd);
         return;
     }
-    struct dirent *ent;
-    while ((ent = readdir(d))) {
+    w->dirs[w->depth] = d;
+    w->base[w->depth] = strlen(w->rel);
+    w->depth++;
+}
+
+// Запись LISTR. Пути считаются относительно дескриптора каталога, ссылки
+// не разыменовываются; подкаталог открывается следующим уровнем обхода.
+static void listr_entry(conn_t *c, struct dir_walk *w, int dfd, const char *name) {
+    size_t base_len = strlen(w->rel);
+    int written = snprintf(w->rel + base_len, sizeof(w->rel) - base_len, "%s%s",
+                           base_len ? "/" : "", name);
+    if (written < 0 || (size_t)written >= sizeof(w->rel) - base_len) return;
+
+    struct stat st;
+    if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) return;
+    if (S_ISDIR(st.st_mode)) {
+        listr_emit(c, w, ENTRY_DIR, (uint64_t)st.st_size, NULL);
+        if (w->depth < w->max_depth) {
+            int sub = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (sub >= 0) walk_push(w, sub);
+        }
+    } else if (S_ISLNK(st.st_mode)) {
+        char linkto[PATHBUF];
+        ssize_t r = readlinkat(dfd, name, linkto, sizeof(linkto) - 1);
+        if (r >= 0) {
+            linkto[r] = '\0';
+            listr_emit(c, w, ENTRY_LINK, (uint64_t)st.st_size, linkto);
+        }
+    } else {
+        listr_emit(c, w, ENTRY_FILE, (uint64_t)st.st_size, NULL);
+    }
+}
+
+static void walk_free(conn_t *c) {
+    struct dir_walk *w = c->walk;
+    if (!w) return;
+    while (w->depth > 0) closedir(w->dirs[--w->depth]);
+    free(w);
+    c->walk = NULL;
+}
+
+// Выводит записи, пока есть место. 1 - обход закончен (c->walk освобождён),
+// 0 - приостановлен до отправки вывода.
+static int walk_run(conn_t *c) {
+    struct dir_walk *w = c->walk;
+    while (w->depth > 0 && !c->dead) {
+        if (w->yield) {
+            w->yield = 0;
+            return 0;
+        }
+        if (!conn_room(c, WALK_ENTRY_MAX)) return 0;
+        DIR *d = w->dirs[w->depth - 1];
+        w->rel[w->base[w->depth - 1]] = '\0';
+        struct dirent *ent = readdir(d);
+        if (!ent) {
+            closedir(d);
+            w->depth--;
+            continue;
+        }
         if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
             continue;
-        char full[PATHBUF];
-        int written = snprintf(full, sizeof(full), "%s/%s", path, ent->d_name);
-        if (written < 0 || written >= (int)sizeof(full)) {
+        if (w->recursive) listr_entry(c, w, dirfd(d), ent->d_name);
+        else list_entry(c, dirfd(d), ent->d_name);
+    }
+    walk_free(c);
+    return 1;
+}
+
+// Начинает обход текущего каталога; max_depth 1 - только его записи.
+static void walk_start(conn_t *c, int recursive, int max_depth) {
+    int dfd = openat(c->cwd_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) {
+        reply_error(c, recursive ? "Error: Cannot open directory." : "Error: Cannot access current directory.");
+        return;
+    }
+    struct dir_walk *w = malloc(sizeof(*w));
+    if (!w) {
+        close(dfd);
+        reply_error(c, "Error: Out of memory.");
+        return;
+    }
+    w->recursive = recursive;
+    w->max_depth = max_depth;
+    w->depth = 0;
+    w->yield = 0;
+    w->rel[0] = '\0';
+    w->last_flush = stats_now_ns();
+    walk_push(w, dfd);
+    if (w->depth == 0) {
+        if (!recursive) {
+            perror("fdopendir");
+            reply_error(c, "Error: Cannot open directory.");
+        }
+        free(w);
+        return;
+    }
+    c->walk = w;
+    walk_run(c);
+}
+
+void handle_list(conn_t *c) {
+    walk_start(c, 0, 1);
+}
+
+// LISTR [depth]: рекурсивный список поддерева текущего каталога.
+// depth 1 - как LIST, без аргумента - до LISTR_MAX_DEPTH уровней.
+void handle_listr(conn_t *c, const char *arg) {
+    int max_depth = LISTR_MAX_DEPTH;
+    if (arg && *arg) {
+        char *end;
+        long v = strtol(arg, &end, 10);
+        if (*end != '\0' || v < 1) {
+            reply_error(c, "Error: LISTR depth must be a positive number.");
+            return;
+        }
+        if (v < max_depth) max_depth = (int)v;
+    }
+    walk_start(c, 1, max_depth);
+}
+
+// Лексическая нормализация rel ("." и ".." без обращения к ФС) - запасной
+// способ узнать новый cwd, если /proc недоступен.
+static void normalize_rel(const char *path, char *out, size_t size) {
+    char tmp[PATHBUF];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    size_t len = 0;
+    out[0] = '\0';
+    char *save = NULL;
+    for (char *p = strtok_r(tmp, "/", &save); p; p = strtok_r(NULL, "/", &save)) {
+        if (strcmp(p, ".") == 0) continue;
+        if (strcmp(p, "..") == 0) {
+            char *s = strrchr(out, '/');
+            len = s ? (size_t)(s - out) : 0;
+            out[len] = '\0';
             continue;
         }
+        int n = snprintf(out + len, size - len, "%s%s", len ? "/" : "", p);
+        if (n < 0 || (size_t)n >= size - len) break;
+        len += (size_t)n;
+    }
+}
 
-        struct stat st;
-        if (lstat(full, &st) < 0) continue;
-        if (S_ISDIR(st.st_mode)) {
-            sendall(fd, ent->d_name);
-            sendall(fd, "/\n");
-        } else if (S_ISLNK(st.st_mode)) {
-            char linkto[PATHBUF];
-            ssize_t r = readlink(full, linkto, sizeof(linkto)-1);
-            if (r < 0) continue;
-            linkto[r] = '\0';
-            char target[PATHBUF];
-            if (build_path(root, cwd, linkto, target) == 0) {
-                struct stat st2;
-                if (lstat(target, &st2) == 0 && S_ISLNK(st2.st_mode)) {
-                    char real2[PATHBUF];
-                    ssize_t r2 = readlink(target, real2, sizeof(real2)-1);
-                    if (r2 > 0) {
-                        real2[r2] = '\0';
-                        sendall(fd, ent->d_name);
-                        sendall(fd, " -->> ");
-                        sendall(fd, real2);
-                        sendall(fd, "\n");
-                    }
-                } else {
-                    sendall(fd, ent->d_name);
-                    sendall(fd, " --> ");
-                    sendall(fd, linkto);
-                    sendall(fd, "\n");
-                }
-            }
+// CD: новый каталог открывается от корня с запретом выхода за его пределы
+// (resolve_beneath), после чего дескриптор становится текущим каталогом.
+static void handle_cd(conn_t *c, const char *root, char *cwd, const char *t) {
+    if (strcmp(t, "..") == 0 && cwd[0] == '\0') return;  // выше корня - остаёмся в нём
+    char path[PATHBUF];
+    if (join_path(cwd, t, path, sizeof(path)) < 0) {
+        reply_error(c, "Error: Path too long to set as current directory.");
+        return;
+    }
+    int nfd = resolve_beneath(c->root_fd, path, 1);
+    if (nfd < 0) {
+        reply_error(c, "Error: Invalid path or permission denied for CD.");
+        return;
+    }
+    char rel[PATHBUF];
+    if (resolve_rel_path(nfd, root, rel, sizeof(rel)) < 0)
+        normalize_rel(path, rel, sizeof(rel));
+    size_t rlen = strlen(rel);
+    if (rlen >= PATH_MAX) {
+        close(nfd);
+        reply_error(c, "Error: Path too long to set as current directory.");
+        return;
+    }
+    memcpy(cwd, rel, rlen + 1);
+    close(c->cwd_fd);
+    c->cwd_fd = nfd;
+}
+
+// Выполняет одну команду. Возвращает 1, если клиент завершает сессию (QUIT).
+static int process_command(conn_t *c, const char *root, char *cwd, char *line) {
+    int fd = c->fd;
+    char *cmd = trim(line);
+    if (*cmd == '\0') {
+        reply_end(c, cwd);
+        return 0;
+    }
+    log_debug("Client %d sent: %s", fd, cmd);
+    uint64_t cmd_start = stats_now_ns();
+    stats_cmd_t cmd_kind = CMD_OTHER;
+
+    if (strncasecmp(cmd, "ECHO ", 5) == 0) {
+        cmd_kind = CMD_ECHO;
+        handle_echo(c, cmd + 5);
+    } else if (strcasecmp(cmd, "QUIT") == 0) {
+        reply_bye(c);
+        stats_command(CMD_QUIT, stats_now_ns() - cmd_start);
+        log_event("Client %d disconnected (QUIT command)", fd);
+        return 1;
+    } else if (strcasecmp(cmd, "INFO") == 0) {
+        cmd_kind = CMD_INFO;
+        handle_info(c);
+    } else if (strncasecmp(cmd, "HELLO", 5) == 0 && (cmd[5] == '\0' || cmd[5] == ' ')) {
+        if (c->binary) {
+            reply_error(c, "Error: Binary protocol already active.");
+        } else if (strcasecmp(cmd, PROTO_BIN_HELLO) == 0) {
+            // Подтверждение и приглашение ещё текстом, дальше - только кадры.
+            reply_text(c, PROTO_BIN_ACK);
+            reply_end(c, cwd);
+            c->binary = 1;
+            stats_command(cmd_kind, stats_now_ns() - cmd_start);
+            log_event("Client %d switched to binary protocol", fd);
+            return 0;
         } else {
-            sendall(fd, ent->d_name);
-            sendall(fd, "\n");
+            reply_error(c, "Error: Unsupported protocol.");
         }
+    } else if (strcasecmp(cmd, "STATS") == 0) {
+        cmd_kind = CMD_STATS;
+        handle_stats(c);
+    } else if (strncasecmp(cmd, "CD ", 3) == 0) {
+        cmd_kind = CMD_CD;
+        handle_cd(c, root, cwd, cmd + 3);
+    } else if (strcasecmp(cmd, "LIST") == 0) {
+        cmd_kind = CMD_LIST;
+        handle_list(c);
+    } else if (strncasecmp(cmd, "LISTR", 5) == 0 && (cmd[5] == '\0' || cmd[5] == ' ')) {
+        cmd_kind = CMD_LISTR;
+        handle_listr(c, trim(cmd + 5));
+    } else {
+        reply_error(c, "Unknown command");
     }
-    closedir(d);
+    if (c->walk) {  // обход приостановлен, команду завершит conn_input
+        c->walk->cmd_kind = cmd_kind;
+        c->walk->cmd_start = cmd_start;
+        return 0;
+    }
+    reply_end(c, cwd);
+    stats_command(cmd_kind, stats_now_ns() - cmd_start);
+    return 0;
 }
 
-void *client_thread(void *arg) {
-    // Увеличиваем счетчик активных потоков
+_Static_assert(FRAME_HDR_SIZE + FRAME_MAX_CMD <= BUF_SIZE, "command frame must fit into conn_t.in");
+
+// Двоичный режим: разбирает один кадр из c->in начиная с *pos.
+// Возвращает 0 - кадр ещё не получен целиком, 1 - команда выполнена,
+// 2 - QUIT, -1 - ошибка протокола.
+static int next_frame_command(conn_t *c, size_t *pos) {
+    size_t avail = c->in_len - *pos;
+    if (avail < FRAME_HDR_SIZE) return 0;
+    frame_hdr_t h;
+    frame_get_hdr((const unsigned char *)c->in + *pos, &h);
+    if (h.type != FRAME_CMD || h.len > FRAME_MAX_CMD) return -1;
+    if (avail < FRAME_HDR_SIZE + h.len) return 0;
+
+    char line[BUF_SIZE + 1];
+    memcpy(line, c->in + *pos + FRAME_HDR_SIZE, h.len);
+    line[h.len] = '\0';
+    *pos += FRAME_HDR_SIZE + h.len;
+    c->req_id = h.req_id;
+    return process_command(c, c->root, c->cwd, line) ? 2 : 1;
+}
+
+// Уменьшаем счетчик активных потоков и сигнализируем main
+static void release_thread_slot(void) {
     pthread_mutex_lock(&active_threads_mutex);
-    active_threads_count++;
+    active_threads_count--;
+    pthread_cond_signal(&active_threads_cond); // Сообщаем main, что поток завершился
     pthread_mutex_unlock(&active_threads_mutex);
+}
 
-    client_args_t *ca = arg;
-    int fd = ca->client_fd;
-    char cwd[PATH_MAX] = "";
+// При достижении max_conns клиент получает отказ сразу, а не
+// зависает в очереди: новый поток (соединение цикла) не создаётся.
+// Место занимается до создания потока, чтобы ограничение соблюдалось без гонки.
+int admit_client(int fd) {
+    pthread_mutex_lock(&active_threads_mutex);
+    int busy = active_threads_count >= max_conns;
+    if (!busy) active_threads_count++;
+    pthread_mutex_unlock(&active_threads_mutex);
+    if (busy) {
+        static const char msg[] = "Error: Server busy, try again later.\n";
+        send(fd, msg, sizeof(msg) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+        close(fd);
+        stats_reject();
+        log_warn("Connection rejected: %d clients (max_conns)", max_conns);
+        return -1;
+    }
+    return 0;
+}
+
+conn_t *conn_open(int fd, int root_fd, const char *root, conn_mode_t mode) {
+    conn_t *c = malloc(sizeof(*c));
+    if (c == NULL) {
+        perror("malloc for conn_t");
+        close(fd);
+        release_thread_slot();
+        return NULL;
+    }
+    c->fd = fd;
+    c->root_fd = root_fd;
+    c->cwd_fd = openat(root_fd, ".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    c->out = malloc(OUT_BUF_SIZE);
+    if (c->cwd_fd < 0 || c->out == NULL) {
+        perror("conn_t setup");
+        if (c->cwd_fd >= 0) close(c->cwd_fd);
+        free(c->out);
+        free(c);
+        close(fd);
+        release_thread_slot();
+        return NULL;
+    }
+    // io_uring сам ждёт готовности сокета; с O_NONBLOCK он вернул бы -EAGAIN.
+    if (mode != CONN_URING) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    c->mode = mode;
+    c->binary = 0;
+    c->dead = 0;
+    c->walk = NULL;
+    c->req_id = 0;
+    c->last_active = stats_now_ns();
+    c->root = root;
+    c->cwd[0] = '\0';
+    c->in_len = 0;
+    c->out_off = 0;
+    c->out_len = 0;
+    c->out_size = OUT_BUF_SIZE;
+    stats_conn_open();
 
-    handle_info(fd);
-    sendall(fd, ">\n");
+    handle_info(c);
+    reply_end(c, c->cwd);
     log_event("Client %d connected, greeting sent", fd);
+    return c;
+}
+
+// Обрабатываем все полные строки (кадры); строка длиннее буфера
+// обрабатывается частями, как и раньше.
+int conn_input(conn_t *c) {
+    if (c->walk) {
+        stats_cmd_t kind = c->walk->cmd_kind;
+        uint64_t start = c->walk->cmd_start;
+        if (!walk_run(c)) return 0;
+        reply_end(c, c->cwd);
+        stats_command(kind, stats_now_ns() - start);
+    }
+    int quit = 0;
+    size_t pos = 0;
+    while (!quit && !c->dead && !c->walk && pos < c->in_len) {
+        if (c->binary) {
+            int rc = next_frame_command(c, &pos);
+            if (rc == 0) break;
+            if (rc < 0) {
+                log_event("Client %d: protocol error, closing", c->fd);
+                quit = 1;
+                break;
+            }
+            if (rc == 2) quit = 1;
+            continue;
+        }
+        char *line = c->in + pos;
+        char *nl = memchr(line, '\n', c->in_len - pos);
+        if (nl) {
+            *nl = '\0';
+            pos = (size_t)(nl - c->in) + 1;
+        } else if (pos == 0 && c->in_len == BUF_SIZE) {
+            c->in[BUF_SIZE] = '\0';
+            pos = BUF_SIZE;
+        } else {
+            break;
+        }
+        quit = process_command(c, c->root, c->cwd, line);
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+    return quit;
+}
+
+void conn_close(conn_t *c) {
+    walk_free(c);
+    close(c->cwd_fd);
+    close(c->fd);
+    free(c->out);
+    free(c);
+    stats_conn_close();
+    release_thread_slot();
+}
+
+void *client_thread(void *arg) {
+    client_args_t *ca = arg;
+    conn_t *c = conn_open(ca->client_fd, ca->root_fd, ca->root, CONN_THREAD);
+    free(ca);
+    if (c == NULL) return NULL;
+    int fd = c->fd;
+    conn_flush(c);
 
-    char buf[BUF_SIZE];
-    while (server_running) { // Теперь цикл зависит от server_running
-        // Используем poll с таймаутом, чтобы recv не блокировал вечно
-        // и поток мог проверить server_running.
+    int quit = 0;
+    int paused = 0;
+    while (server_running && !quit && !c->dead) { // Теперь цикл зависит от server_running
+        // Используем poll с таймаутом, чтобы поток мог проверить server_running
+        // и таймаут бездействия. Пока клиент не забрал вывод, новые команды
+        // не читаются (обратное давление вместо роста буфера).
         struct pollfd pfd;
         pfd.fd = fd;
-        pfd.events = POLLIN; // Интересуют события чтения
+        pfd.events = 0;
+        if (conn_pending(c) > 0) pfd.events |= POLLOUT;
+        if (conn_pending(c) <= OUT_BUF_SIZE) {
+            pfd.events |= POLLIN;
+            paused = 0;
+        } else if (!paused) {
+            paused = 1;
+            stats_read_paused();
+            log_debug("Client %d: output backlog %zu bytes, reading paused", fd, conn_pending(c));
+        }
 
         int poll_ret = poll(&pfd, 1, 100); // Таймаут 100 мс
 
@@ -194,12 +761,26 @@ void *client_thread(void *arg) {
             perror("poll error");
             break; // Другая ошибка poll
         }
-        if (poll_ret == 0) { // Таймаут, данных нет
+        if (poll_ret == 0) { // Таймаут, событий нет
+            if (conn_idle_expired(c, stats_now_ns())) {
+                if (paused) {
+                    log_warn("Client %d is not reading output, closing", fd);
+                    stats_slow_close();
+                } else {
+                    log_event("Client %d disconnected (idle timeout)", fd);
+                    stats_idle_close();
+                }
+                break;
+            }
             continue; // Проверяем server_running снова
         }
 
+        if ((pfd.revents & POLLOUT) && conn_flush(c) < 0) break;
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
         // Есть данные для чтения
-        ssize_t n = recv(fd, buf, sizeof(buf)-1, 0);
+        ssize_t n = recv(fd, c->in + c->in_len, BUF_SIZE - c->in_len, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
         if (n <= 0) {
             if (n == 0) {
                 log_event("Client %d disconnected (gracefully)", fd);
@@ -208,140 +789,315 @@ void *client_thread(void *arg) {
             }
             break;
         }
-        buf[n] = '\0';
-        char *nl = strchr(buf, '\n'); if (nl) *nl = '\0';
-        char *cmd = trim(buf);
-        if (*cmd == '\0') {
-            if (cwd[0] == '\0') sendall(fd, ">\n");
-            else { sendall(fd, cwd); sendall(fd, ">\n"); }
-            continue;
-        }
-        log_event("Client %d sent: %s", fd, cmd);
+        stats_bytes_in((size_t)n);
+        c->in_len += (size_t)n;
+        c->last_active = stats_now_ns();
 
-        if (strncasecmp(cmd, "ECHO ", 5) == 0) {
-            handle_echo(fd, cmd + 5);
-        } else if (strcasecmp(cmd, "QUIT") == 0) {
-            sendall(fd, "BYE\n");
-            log_event("Client %d disconnected (QUIT command)", fd);
-            break;
-        } else if (strcasecmp(cmd, "INFO") == 0) {
-            handle_info(fd);
-        } else if (strncasecmp(cmd, "CD ", 3) == 0) {
-            const char *t = cmd + 3;
-            if (strcasecmp(t, "/") == 0) {
-                cwd[0] = '\0';
-            } else if (strcasecmp(t, "..") == 0) {
-                char *p = strrchr(cwd, '/'); if (p) *p = '\0'; else cwd[0] = '\0';
-            } else {
-                char newp[PATHBUF];
-                if (build_path(ca->root, cwd, t, newp) == 0) {
-                    const char *rel = newp + strlen(ca->root);
-                    if (rel[0] == '/') rel++;
-                    size_t rlen = strlen(rel);
-                    if (rlen < sizeof(cwd)) {
-                        memcpy(cwd, rel, rlen);
-                        cwd[rlen] = '\0';
-                    } else {
-                        sendall(fd, "Error: Path too long to set as current directory.\n");
-                    }
-                } else {
-                    sendall(fd, "Error: Invalid path or permission denied for CD.\n");
-                }
-            }
-        } else if (strcasecmp(cmd, "LIST") == 0) {
-            handle_list(fd, ca->root, cwd);
+        quit = conn_input(c);
+        if (conn_flush(c) < 0) break;  // причина уже записана в журнал
+    }
+    // Дописываем остаток ответа (в том числе BYE) - не дольше таймаута бездействия.
+    if (!c->dead) conn_drain(c, 0);
+    conn_close(c);
+    return NULL;
+}
+
+static int listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket"); return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in serv;
+    memset(&serv, 0, sizeof(serv));
+    serv.sin_family = AF_INET;
+    serv.sin_addr.s_addr = INADDR_ANY;
+    serv.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&serv, sizeof(serv)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, listen_backlog) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Unix-сокет: путь в ФС или "@name" в абстрактном пространстве имён.
+// Оставшийся от упавшего процесса файл сокета удаляется.
+static int listen_unix(const char *spec) {
+    struct sockaddr_un addr;
+    socklen_t alen;
+    if (unix_addr_parse(spec, &addr, &alen) < 0) {
+        fprintf(stderr, "Error: Invalid unix socket address '%s'\n", spec);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket"); return -1;
+    }
+    int rc = bind(fd, (struct sockaddr*)&addr, alen);
+    if (rc < 0 && errno == EADDRINUSE && spec[0] != '@') {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int alive = probe >= 0 && connect(probe, (struct sockaddr*)&addr, alen) == 0;
+        if (probe >= 0) close(probe);
+        if (!alive) {
+            unlink(spec);
+            rc = bind(fd, (struct sockaddr*)&addr, alen);
         } else {
-            sendall(fd, "Unknown command\n");
-        }
-        if (cwd[0] == '\0') sendall(fd, ">\n");
-        else {
-            sendall(fd, cwd); sendall(fd, ">\n");
+            errno = EADDRINUSE;
         }
     }
-    close(fd);
-    free(ca);
+    if (rc < 0 || listen(fd, listen_backlog) < 0) {
+        perror("unix socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-    // Уменьшаем счетчик активных потоков и сигнализируем main
-    pthread_mutex_lock(&active_threads_mutex);
-    active_threads_count--;
-    pthread_cond_signal(&active_threads_cond); // Сообщаем main, что поток завершился
-    pthread_mutex_unlock(&active_threads_mutex);
+// Принимает клиента с listen_fd и запускает для него поток.
+static void accept_client(int listen_fd, int root_fd, const char *root) {
+    struct sockaddr_storage cli;
+    socklen_t len = sizeof(cli);
+    int fd = accept(listen_fd, (struct sockaddr*)&cli, &len);
+    if (fd < 0) {
+        perror("accept");
+        return;
+    }
+    stats_accept();
+    if (admit_client(fd) < 0) return;
+    client_args_t *ca = malloc(sizeof(*ca));
+    if (ca == NULL) {
+        perror("malloc for client_args_t");
+        close(fd);
+        release_thread_slot();
+        return;
+    }
+    strncpy(ca->root, root, PATH_MAX - 1);
+    ca->root[PATH_MAX - 1] = '\0';
+    ca->root_fd = root_fd;
+    ca->client_fd = fd; // FIX: client_fd должен быть присвоен после strncpy, но до pthread_create
 
-    return NULL;
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, client_thread, ca);
+    if (rc != 0) {
+        fprintf(stderr, "Error creating thread: %s\n", strerror(rc));
+        close(fd);
+        free(ca);
+        release_thread_slot();
+    } else {
+        pthread_detach(tid);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-l log_file] [-L log_level] [-c max_conns] [-b backlog]\n"
+                    "          [-o out_cap_kb] [-i idle_timeout_s] [-r restart_socket]\n"
+                    "          [-u unix_socket|@abstract_name] [-E threads|epoll|uring] [-n loops]\n"
+                    "          root_dir port\n", prog);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s root_dir port\n", argv[0]);
+    const char *log_path = NULL;
+    const char *ctl_path = NULL;
+    const char *unix_spec = NULL;
+    backend_t backend = BACKEND_THREADS;
+    int loops = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    log_level_t log_level = LOG_DEBUG;
+    int opt_c;
+    while ((opt_c = getopt(argc, argv, "l:L:c:b:o:i:r:u:E:n:")) != -1) {
+        switch (opt_c) {
+            case 'c':
+                max_conns = atoi(optarg);
+                break;
+            case 'b':
+                listen_backlog = atoi(optarg);
+                break;
+            case 'o':
+                out_cap = (size_t)atol(optarg) * 1024;
+                break;
+            case 'i':
+                idle_timeout_s = atoi(optarg);
+                break;
+            case 'r':
+                ctl_path = optarg;
+                break;
+            case 'E':
+                if (backend_parse(optarg, &backend) < 0) {
+                    fprintf(stderr, "Error: Unknown backend '%s' (threads|epoll|uring)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n':
+                loops = atoi(optarg);
+                break;
+            case 'u':
+                unix_spec = unix_addr_is(optarg) ? optarg + strlen(UNIX_ADDR_PREFIX) : optarg;
+                break;
+            case 'l':
+                log_path = optarg;
+                break;
+            case 'L':
+                if (log_level_parse(optarg, &log_level) < 0) {
+                    fprintf(stderr, "Error: Unknown log level '%s' (error|warn|info|debug)\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (loops < 1) loops = 1;
+    if (max_conns < 1 || listen_backlog < 1 || idle_timeout_s < 0 || out_cap < OUT_BUF_SIZE) {
+        fprintf(stderr, "Error: Invalid limits (max_conns, backlog >= 1, out_cap >= %d KB, idle_timeout >= 0)\n",
+                OUT_BUF_SIZE / 1024);
         return 1;
     }
+    const char *root_arg = argv[optind];
+    const char *port_arg = argv[optind + 1];
+
     char root[PATH_MAX];
-    if (!realpath(argv[1], root)) {
+    if (!realpath(root_arg, root)) {
         perror("realpath for root_dir");
         return 1;
     }
     struct stat st_root;
     if (stat(root, &st_root) < 0 || !S_ISDIR(st_root.st_mode)) {
-        fprintf(stderr, "Error: root_dir '%s' is not a valid directory or inaccessible.\n", argv[1]);
+        fprintf(stderr, "Error: root_dir '%s' is not a valid directory or inaccessible.\n", root_arg);
+        return 1;
+    }
+
+    int root_fd = open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        perror("open root_dir");
         return 1;
     }
 
-    int port = atoi(argv[2]);
+    int port = atoi(port_arg);
     if (port <= 0 || port > 65535) {
         fprintf(stderr, "Error: Invalid port number: %d\n", port);
         return 1;
     }
 
+    if (log_init(log_path, log_level) < 0) {
+        perror("log_init");
+        return 1;
+    }
+    stats_init();
+    stats_limits_t limits = { max_conns, listen_backlog, out_cap, idle_timeout_s, NULL, 0 };
+
     // Регистрация обработчиков сигналов
     signal(SIGINT, sig_handler);
     signal(SIGTERM, sig_handler);
 
-    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd < 0) {
-        perror("socket"); return 1;
+    // При горячем перезапуске слушающие сокеты забираются у работающего
+    // процесса, иначе создаются заново.
+    int listen_fd = -1;
+    int unix_fd = -1;
+    if (ctl_path) {
+        int fds[HANDOFF_MAX_FDS];
+        int n = handoff_take(ctl_path, fds, HANDOFF_MAX_FDS);
+        if (n < 0) {
+            perror("handoff_take");
+            return 1;
+        }
+        for (int i = 0; i < n; ++i) {
+            struct sockaddr_storage bound;
+            socklen_t blen = sizeof(bound);
+            if (getsockname(fds[i], (struct sockaddr*)&bound, &blen) < 0) {
+                close(fds[i]);
+            } else if (bound.ss_family == AF_INET && listen_fd < 0) {
+                listen_fd = fds[i];
+                int bport = ntohs(((struct sockaddr_in *)&bound)->sin_port);
+                if (bport != port)
+                    log_warn("Inherited socket listens on port %d, not %d", bport, port);
+            } else if (bound.ss_family == AF_UNIX && unix_fd < 0 && unix_spec) {
+                unix_fd = fds[i];
+            } else {
+                close(fds[i]);
+            }
+        }
+        if (n > 0)
+            log_event("Took over %d listening socket(s) from running server via '%s'", n, ctl_path);
     }
-    int opt = 1;
-    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    struct sockaddr_in serv;
-    memset(&serv, 0, sizeof(serv));
-    serv.sin_family = AF_INET;
-    serv.sin_addr.s_addr = INADDR_ANY;
-    serv.sin_port = htons(port);
-
-    if (bind(listen_fd, (struct sockaddr*)&serv, sizeof(serv)) < 0) {
-        perror("bind");
+    if (listen_fd < 0 && (listen_fd = listen_tcp(port)) < 0) {
+        return 1;
+    }
+    if (unix_spec && unix_fd < 0 && (unix_fd = listen_unix(unix_spec)) < 0) {
         close(listen_fd);
         return 1;
     }
-    if (listen(listen_fd, BACKLOG) < 0) {
-        perror("listen");
+    int ctl_fd = -1;
+    if (ctl_path && (ctl_fd = handoff_listen(ctl_path)) < 0) {
+        perror("handoff_listen");
         close(listen_fd);
         return 1;
     }
-    log_event("Server started port=%d, root='%s'", port, root);
-    log_event("Enter 'Q' to quit the server.");
+    // Событийные циклы сами принимают соединения; main остаётся консоль,
+    // перезапуск и ожидание завершения.
+    if (backend != BACKEND_THREADS) {
+        int lfds[2] = { listen_fd, unix_fd };
+        if (evloop_start(&backend, loops, lfds, unix_fd >= 0 ? 2 : 1, root_fd, root) < 0) {
+            close(listen_fd);
+            return 1;
+        }
+    }
+    limits.backend = backend_name(backend);
+    limits.loops = backend == BACKEND_THREADS ? 0 : loops;
+    stats_set_limits(&limits);
+    log_event("Server started port=%d%s%s, root='%s', backend=%s, max_conns=%d, backlog=%d", port,
+              unix_spec ? ", unix=" : "", unix_spec ? unix_spec : "", root, backend_name(backend),
+              max_conns, listen_backlog);
+    log_event("Enter 'Q' to quit the server, 'S' to show statistics.");
 
     // Для чтения из stdin
     int stdin_fd = fileno(stdin);
-    // Для select, max_fd должен быть наибольшим дескриптором + 1
-    int max_fd = listen_fd;
-    if (stdin_fd > max_fd) max_fd = stdin_fd;
+    int draining = 0;  // сокет передан преемнику, ждём завершения сессий
 
     fd_set read_fds;
     struct timeval timeout;
 
     while (server_running) {
+        if (draining) {
+            pthread_mutex_lock(&active_threads_mutex);
+            int left = active_threads_count;
+            pthread_mutex_unlock(&active_threads_mutex);
+            if (left == 0) break;
+        }
+        // Для select, max_fd должен быть наибольшим дескриптором + 1
+        int max_fd = -1;
         FD_ZERO(&read_fds);
-        FD_SET(listen_fd, &read_fds);
-        FD_SET(stdin_fd, &read_fds); // Добавляем stdin в набор для select
+        int accept_here = backend == BACKEND_THREADS;
+        if (accept_here && listen_fd >= 0) FD_SET(listen_fd, &read_fds);
+        if (accept_here && unix_fd >= 0) FD_SET(unix_fd, &read_fds);
+        if (ctl_fd >= 0) FD_SET(ctl_fd, &read_fds);
+        if (stdin_fd >= 0) FD_SET(stdin_fd, &read_fds); // Добавляем stdin в набор для select
+        if (listen_fd > max_fd) max_fd = listen_fd;
+        if (unix_fd > max_fd) max_fd = unix_fd;
+        if (ctl_fd > max_fd) max_fd = ctl_fd;
+        if (stdin_fd > max_fd) max_fd = stdin_fd;
 
-        timeout.tv_sec = 1; // Проверять каждые 1 секунду
-        timeout.tv_usec = 0;
+        timeout.tv_sec = draining ? 0 : 1; // Проверять каждые 1 секунду (при передаче - чаще)
+        timeout.tv_usec = draining ? 100000 : 0;
 
         int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
 
         if (activity < 0) {
             if (errno == EINTR) { // Прервано сигналом
+                if (shutdown_signal) {
+                    log_event("Received signal %d, initiating shutdown.", (int)shutdown_signal);
+                }
                 continue; // Повторяем select
             }
             perror("select error");
@@ -349,40 +1105,36 @@ int main(int argc, char *argv[]) {
             break;
         }
 
-        // Если пришло новое соединение
-        if (FD_ISSET(listen_fd, &read_fds)) {
-            struct sockaddr_in cli;
-            socklen_t len = sizeof(cli);
-            int fd = accept(listen_fd, (struct sockaddr*)&cli, &len);
-            if (fd < 0) {
-                perror("accept");
-                // Если accept fail, но server_running уже false, то это нормально при завершении
-                if (!server_running) break;
-                continue;
-            }
-            client_args_t *ca = malloc(sizeof(*ca));
-            if (ca == NULL) {
-                perror("malloc for client_args_t");
-                close(fd);
-                continue;
-            }
-            strncpy(ca->root, root, PATH_MAX - 1);
-            ca->root[PATH_MAX - 1] = '\0';
-            ca->client_fd = fd; // FIX: client_fd должен быть присвоен после strncpy, но до pthread_create
-
-            pthread_t tid;
-            int rc = pthread_create(&tid, NULL, client_thread, ca);
-            if (rc != 0) {
-                fprintf(stderr, "Error creating thread: %s\n", strerror(rc));
-                close(fd);
-                free(ca);
+        // Если пришло новое соединение (TCP или Unix-сокет)
+        if (accept_here && listen_fd >= 0 && FD_ISSET(listen_fd, &read_fds)) accept_client(listen_fd, root_fd, root);
+        if (accept_here && unix_fd >= 0 && FD_ISSET(unix_fd, &read_fds)) accept_client(unix_fd, root_fd, root);
+
+        // Преемник запросил слушающий сокет: отдаём его и больше не принимаем
+        // соединения; текущие сессии обслуживаются до их завершения.
+        if (ctl_fd >= 0 && FD_ISSET(ctl_fd, &read_fds)) {
+            int fds[2] = { listen_fd, unix_fd };
+            int s = handoff_give(ctl_fd, fds, unix_fd >= 0 ? 2 : 1);
+            if (s < 0) {
+                log_error("Handoff failed: %s", strerror(errno));
             } else {
-                pthread_detach(tid);
+                if (backend != BACKEND_THREADS) evloop_stop_accepting();
+                close(listen_fd);
+                listen_fd = -1;
+                if (unix_fd >= 0) close(unix_fd);  // файл сокета теперь принадлежит преемнику
+                unix_fd = -1;
+                close(ctl_fd);
+                ctl_fd = -1;
+                unlink(ctl_path);
+                close(s);  // EOF для преемника: ctl_path свободен
+                draining = 1;
+                pthread_mutex_lock(&active_threads_mutex);
+                log_event("Listening socket handed over, draining %d sessions", active_threads_count);
+                pthread_mutex_unlock(&active_threads_mutex);
             }
         }
 
         // Если пришел ввод с консоли (stdin)
-        if (FD_ISSET(stdin_fd, &read_fds)) {
+        if (stdin_fd >= 0 && FD_ISSET(stdin_fd, &read_fds)) {
             char cmd_line[256];
             if (fgets(cmd_line, sizeof(cmd_line), stdin)) {
                 char *nl = strchr(cmd_line, '\n');
@@ -391,9 +1143,16 @@ int main(int argc, char *argv[]) {
                 if (strcasecmp(cmd, "Q") == 0) {
                     log_event("Server received 'Q' command, initiating shutdown.");
                     server_running = 0; // Устанавливаем флаг завершения
+                } else if (strcasecmp(cmd, "S") == 0) {
+                    char report[4096];
+                    size_t rlen = stats_format(report, sizeof(report));
+                    fwrite(report, 1, rlen, stdout);
+                    fflush(stdout);
                 } else {
                     log_event("Unknown server command: '%s'", cmd);
                 }
+            } else if (draining) {
+                stdin_fd = -1;  // сессии дорабатывают без консоли
             } else {
                 // stdin закрыт или произошла ошибка (например, EOF)
                 log_event("stdin closed or error, initiating shutdown.");
@@ -403,34 +1162,36 @@ int main(int argc, char *argv[]) {
     }
 
     // Начало процедуры чистого завершения
-    log_event("Server shutting down, closing listening socket...");
-    close(listen_fd); // Закрываем слушающий сокет
+    if (backend != BACKEND_THREADS) {
+        log_event("Stopping event loops...");
+        evloop_join();  // при остановке циклы закрывают свои соединения
+    }
+    if (listen_fd >= 0) {
+        log_event("Server shutting down, closing listening socket...");
+        close(listen_fd); // Закрываем слушающий сокет
+    }
+    if (unix_fd >= 0) {
+        close(unix_fd);
+        if (unix_spec[0] != '@') unlink(unix_spec);
+    }
+    if (ctl_fd >= 0) {
+        close(ctl_fd);
+        unlink(ctl_path);
+    }
 
-    // Ожидаем завершения всех активных клиентских потоков
+    // Ожидаем завершения всех активных клиентских потоков. Таймаута нет:
+    // после server_running = 0 потоки выходят из poll за 100 мс, а
+    // недоотправленный вывод при остановке не ждут (conn_drain).
     log_event("Waiting for active client threads to finish...");
     pthread_mutex_lock(&active_threads_mutex);
     while (active_threads_count > 0) {
         log_event("Active threads: %d. Waiting...", active_threads_count);
-        // pthread_cond_wait может быть прерван сигналом.
-        // Если server_running уже 0, мы можем выйти из ожидания.
-        // Используем timedwait, чтобы не блокироваться вечно, если что-то пойдет не так.
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 5; // Ждем максимум 5 секунд
-        int ret = pthread_cond_timedwait(&active_threads_cond, &active_threads_mutex, &ts);
-        if (ret == ETIMEDOUT) {
-            log_event("Timed out waiting for threads. Forcing shutdown.");
-            break; // Выходим из цикла ожидания, если таймаут
-        }
-        if (!server_running && active_threads_count > 0) {
-            // Если сервер уже не работает, но потоки все еще есть,
-            // это может быть из-за таймаута или других проблем.
-            // Можно выйти, чтобы не зависнуть.
-            break;
-        }
+        pthread_cond_wait(&active_threads_cond, &active_threads_mutex);
     }
     pthread_mutex_unlock(&active_threads_mutex);
+    close(root_fd);
     log_event("All client threads finished. Server gracefully stopped.");
+    log_shutdown();
 
     return 0;
 }
@@ -0,0 +1,67 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Общее для потоковой модели сервера (поток на клиента) и событийных
+// циклов (evloop.c): состояние соединения и обработка его ввода.
+
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUF_SIZE 4096
+#define OUT_BUF_SIZE (64 * 1024)  // начальный размер выходного буфера и порог паузы чтения
+
+typedef enum {
+    CONN_THREAD = 0,  // свой поток, блокирующие ожидания допустимы
+    CONN_EPOLL,       // событийный цикл epoll: отправка неблокирующая
+    CONN_URING        // io_uring: отправку выполняет цикл, conn_flush ничего не делает
+} conn_mode_t;
+
+// Соединение клиента: входной буфер для разбора строк или кадров (команды
+// могут приходить пачкой) и выходной буфер, который отправляется после
+// обработки всех готовых команд. Сокет неблокирующий: неотправленный вывод
+// копится в буфере (до out_cap), а пока его больше OUT_BUF_SIZE, новые команды
+// не читаются.
+struct dir_walk;
+
+typedef struct {
+    int fd;
+    int root_fd;       // корень (не закрывается соединением)
+    int cwd_fd;        // текущий каталог, O_PATH; все пути разрешаются от дескрипторов
+    conn_mode_t mode;
+    int binary;        // после HELLO BIN - двоичные кадры (protocol.h)
+    int dead;          // ошибка отправки или клиент не забирает вывод
+    uint32_t req_id;   // req_id текущей команды в двоичном режиме
+    uint64_t last_active;  // последний приём или отправка, для таймаута бездействия
+    const char *root;
+    char cwd[PATH_MAX];
+    char in[BUF_SIZE + 1];
+    size_t in_len;
+    char *out;
+    size_t out_off;    // уже отправленная часть out
+    size_t out_len;
+    size_t out_size;
+    struct dir_walk *walk;  // LIST/LISTR, приостановленный у out_cap (цикл событий)
+} conn_t;
+
+extern volatile sig_atomic_t server_running;
+
+// Допуск нового клиента с учётом max_conns. 0 - место занято под клиента,
+// -1 - отказ (клиенту отправлено сообщение, fd закрыт).
+int admit_client(int fd);
+
+// Создаёт соединение для допущенного клиента и кладёт приветствие в out.
+// При ошибке закрывает fd, освобождает место и возвращает NULL.
+conn_t *conn_open(int fd, int root_fd, const char *root, conn_mode_t mode);
+// Выполняет все полные команды из c->in. 1 - сессию надо закрыть.
+// Если c->walk не NULL, сначала продолжает приостановленный обход; пока он
+// не закончен, следующие команды остаются в c->in.
+int conn_input(conn_t *c);
+int conn_flush(conn_t *c);
+size_t conn_pending(const conn_t *c);
+// Истёк ли таймаут бездействия (now - stats_now_ns()).
+int conn_idle_expired(const conn_t *c, uint64_t now);
+void conn_close(conn_t *c);
+
+#endif
@@ -0,0 +1,158 @@
+#include "stats.h"
+#include "histogram.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define STATS_RATE_SLOTS 64  // секундные корзины для частоты accept
+
+static const char *const stats_cmd_names[CMD_COUNT] = {
+    "ECHO", "INFO", "CD", "LIST", "LISTR", "QUIT", "STATS", "OTHER"
+};
+
+static histogram_t cmd_latency[CMD_COUNT];
+static atomic_ullong bytes_in;
+static atomic_ullong bytes_out;
+static atomic_ullong conn_accepted;
+static atomic_llong conn_open;
+static atomic_llong accept_slot_sec[STATS_RATE_SLOTS];
+static atomic_ullong accept_slot_count[STATS_RATE_SLOTS];
+static atomic_ullong conn_rejected;
+static atomic_ullong read_paused;
+static atomic_ullong slow_closed;
+static atomic_ullong idle_closed;
+static stats_limits_t limits;
+static uint64_t start_ns;
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void stats_init(void) {
+    for (int i = 0; i < CMD_COUNT; ++i) hist_reset(&cmd_latency[i]);
+    for (int i = 0; i < STATS_RATE_SLOTS; ++i) {
+        atomic_init(&accept_slot_sec[i], -1);
+        atomic_init(&accept_slot_count[i], 0);
+    }
+    atomic_init(&bytes_in, 0);
+    atomic_init(&bytes_out, 0);
+    atomic_init(&conn_accepted, 0);
+    atomic_init(&conn_open, 0);
+    atomic_init(&conn_rejected, 0);
+    atomic_init(&read_paused, 0);
+    atomic_init(&slow_closed, 0);
+    atomic_init(&idle_closed, 0);
+    start_ns = stats_now_ns();
+}
+
+void stats_command(stats_cmd_t cmd, uint64_t latency_ns) {
+    if (cmd < 0 || cmd >= CMD_COUNT) cmd = CMD_OTHER;
+    hist_record_shared(&cmd_latency[cmd], latency_ns);
+}
+
+void stats_bytes_in(size_t n) {
+    atomic_fetch_add_explicit(&bytes_in, n, memory_order_relaxed);
+}
+
+void stats_bytes_out(size_t n) {
+    atomic_fetch_add_explicit(&bytes_out, n, memory_order_relaxed);
+}
+
+void stats_accept(void) {
+    atomic_fetch_add_explicit(&conn_accepted, 1, memory_order_relaxed);
+    long long sec = (long long)(stats_now_ns() / 1000000000ULL);
+    int slot = (int)(sec % STATS_RATE_SLOTS);
+    long long old = atomic_load_explicit(&accept_slot_sec[slot], memory_order_relaxed);
+    if (old != sec &&
+        atomic_compare_exchange_strong(&accept_slot_sec[slot], &old, sec)) {
+        atomic_store_explicit(&accept_slot_count[slot], 0, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&accept_slot_count[slot], 1, memory_order_relaxed);
+}
+
+void stats_conn_open(void) {
+    atomic_fetch_add_explicit(&conn_open, 1, memory_order_relaxed);
+}
+
+void stats_conn_close(void) {
+    atomic_fetch_sub_explicit(&conn_open, 1, memory_order_relaxed);
+}
+
+void stats_set_limits(const stats_limits_t *l) {
+    limits = *l;
+}
+
+void stats_reject(void) {
+    atomic_fetch_add_explicit(&conn_rejected, 1, memory_order_relaxed);
+}
+
+void stats_read_paused(void) {
+    atomic_fetch_add_explicit(&read_paused, 1, memory_order_relaxed);
+}
+
+void stats_slow_close(void) {
+    atomic_fetch_add_explicit(&slow_closed, 1, memory_order_relaxed);
+}
+
+void stats_idle_close(void) {
+    atomic_fetch_add_explicit(&idle_closed, 1, memory_order_relaxed);
+}
+
+// Среднее число accept в секунду за последние window полных секунд.
+static double accept_rate(long long now_sec, int window) {
+    unsigned long long sum = 0;
+    for (int i = 1; i <= window; ++i) {
+        long long sec = now_sec - i;
+        int slot = (int)(sec % STATS_RATE_SLOTS);
+        if (atomic_load_explicit(&accept_slot_sec[slot], memory_order_relaxed) == sec)
+            sum += atomic_load_explicit(&accept_slot_count[slot], memory_order_relaxed);
+    }
+    return (double)sum / window;
+}
+
+#define STATS_APPEND(...) do { \
+        if (len < size) { \
+            int w_ = snprintf(buf + len, size - len, __VA_ARGS__); \
+            if (w_ > 0) len += (size_t)w_; \
+        } \
+    } while (0)
+
+size_t stats_format(char *buf, size_t size) {
+    size_t len = 0;
+    uint64_t now = stats_now_ns();
+    double uptime = (double)(now - start_ns) / 1e9;
+    long long now_sec = (long long)(now / 1000000000ULL);
+    unsigned long long accepted = atomic_load(&conn_accepted);
+
+    STATS_APPEND("uptime: %.1f s\n", uptime);
+    STATS_APPEND("connections: open=%lld accepted=%llu\n", (long long)atomic_load(&conn_open), accepted);
+    STATS_APPEND("accept rate: last1s=%.1f/s last10s=%.1f/s last60s=%.1f/s avg=%.1f/s\n",
+                 accept_rate(now_sec, 1), accept_rate(now_sec, 10), accept_rate(now_sec, 60),
+                 uptime > 0 ? (double)accepted / uptime : 0.0);
+    if (limits.backend) STATS_APPEND("backend: %s loops=%d\n", limits.backend, limits.loops);
+    STATS_APPEND("limits: max_conns=%d backlog=%d out_cap=%zu idle_timeout=%ds\n",
+                 limits.max_conns, limits.backlog, limits.out_cap, limits.idle_timeout_s);
+    STATS_APPEND("overload: rejected=%llu read_paused=%llu slow_closed=%llu idle_closed=%llu\n",
+                 (unsigned long long)atomic_load(&conn_rejected), (unsigned long long)atomic_load(&read_paused),
+                 (unsigned long long)atomic_load(&slow_closed), (unsigned long long)atomic_load(&idle_closed));
+    STATS_APPEND("bytes: in=%llu out=%llu\n",
+                 (unsigned long long)atomic_load(&bytes_in), (unsigned long long)atomic_load(&bytes_out));
+    STATS_APPEND("%-6s %10s %10s %10s %10s %10s %10s %10s\n",
+                 "cmd", "count", "mean_us", "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+    for (int i = 0; i < CMD_COUNT; ++i) {
+        histogram_t h;
+        hist_snapshot(&cmd_latency[i], &h);
+        STATS_APPEND("%-6s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                     stats_cmd_names[i], (unsigned long long)h.total,
+                     hist_mean(&h) / 1e3,
+                     hist_percentile(&h, 50.0) / 1e3, hist_percentile(&h, 90.0) / 1e3,
+                     hist_percentile(&h, 99.0) / 1e3, hist_percentile(&h, 99.9) / 1e3,
+                     h.max / 1e3);
+    }
+    if (len >= size) len = size > 0 ? size - 1 : 0;
+    return len;
+}
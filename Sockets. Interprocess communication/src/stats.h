@@ -0,0 +1,51 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Метрики сервера: счётчики и гистограммы задержек по командам,
+// трафик, соединения и частота accept. Запись - без блокировок.
+
+typedef enum {
+    CMD_ECHO = 0,
+    CMD_INFO,
+    CMD_CD,
+    CMD_LIST,
+    CMD_LISTR,
+    CMD_QUIT,
+    CMD_STATS,
+    CMD_OTHER,
+    CMD_COUNT
+} stats_cmd_t;
+
+void stats_init(void);
+uint64_t stats_now_ns(void);
+
+void stats_command(stats_cmd_t cmd, uint64_t latency_ns);
+void stats_bytes_in(size_t n);
+void stats_bytes_out(size_t n);
+void stats_accept(void);
+void stats_conn_open(void);
+void stats_conn_close(void);
+
+// Ограничения сервера (для отчёта) и события перегрузки.
+typedef struct {
+    int max_conns;
+    int backlog;
+    size_t out_cap;
+    int idle_timeout_s;
+    const char *backend;  // модель ввода-вывода: threads | epoll | uring
+    int loops;            // число событийных циклов (0 для threads)
+} stats_limits_t;
+
+void stats_set_limits(const stats_limits_t *limits);
+void stats_reject(void);       // соединение отклонено: достигнут max_conns
+void stats_read_paused(void);  // чтение приостановлено: клиент не забирает вывод
+void stats_slow_close(void);   // закрыто: вывод не уходил дольше таймаута
+void stats_idle_close(void);   // закрыто по таймауту бездействия
+
+// Текстовый отчёт (строки через '\n'). Возвращает длину без завершающего нуля.
+size_t stats_format(char *buf, size_t size);
+
+#endif
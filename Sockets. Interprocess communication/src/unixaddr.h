@@ -0,0 +1,35 @@
+#ifndef UNIXADDR_H
+#define UNIXADDR_H
+
+// Адреса Unix-сокетов в виде строки: "unix:/path" - файл в ФС,
+// "unix:@name" - абстрактное пространство имён Linux (файла нет).
+// Префикс "unix:" необязателен, если строка передаётся там, где ожидается
+// только Unix-адрес (ключ -u сервера).
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define UNIX_ADDR_PREFIX "unix:"
+
+static inline int unix_addr_is(const char *spec) {
+    return strncmp(spec, UNIX_ADDR_PREFIX, sizeof(UNIX_ADDR_PREFIX) - 1) == 0;
+}
+
+// Заполняет addr; возвращает 0 или -1, если имя пустое или слишком длинное.
+static inline int unix_addr_parse(const char *spec, struct sockaddr_un *addr, socklen_t *len) {
+    if (unix_addr_is(spec)) spec += sizeof(UNIX_ADDR_PREFIX) - 1;
+    int abstract = spec[0] == '@';
+    if (abstract) spec++;
+    size_t n = strlen(spec);
+    if (n == 0 || n + 1 > sizeof(addr->sun_path)) return -1;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path + abstract, spec, n);
+    // Абстрактный адрес определяется длиной, а не завершающим нулём.
+    *len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + abstract + n + !abstract);
+    return 0;
+}
+
+#endif
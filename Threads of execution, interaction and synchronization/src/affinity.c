@@ -0,0 +1,86 @@
+#define _GNU_SOURCE             // cpu_set_t, pthread_attr_setaffinity_np
+#include "affinity.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+pin_config_t pin_config;
+
+// "0,2-3" -> {0, 2, 3}. 0 - успех.
+static int parse_cpu_list(const char *s, const char *end, cpu_list_t *list) {
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    list->count = 0;
+    while (s < end) {
+        char *stop;
+        long first = strtol(s, &stop, 10);
+        if (stop == s) return -1;
+        long last = first;
+        s = stop;
+        if (s < end && *s == '-') {
+            last = strtol(s + 1, &stop, 10);
+            if (stop == s + 1) return -1;
+            s = stop;
+        }
+        if (first < 0 || last < first || last >= ncpu || last >= CPU_SETSIZE) {
+            fprintf(stderr, "CPU range %ld-%ld is outside 0..%ld\n", first, last, ncpu - 1);
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            if (list->count == PIN_MAX_CPUS) return -1;
+            list->cpus[list->count++] = (int)cpu;
+        }
+        if (s < end) {
+            if (*s != ',') return -1;
+            s++;
+        }
+    }
+    return 0;
+}
+
+int pin_parse(const char *spec, pin_config_t *cfg) {
+    const char *colon = strchr(spec, ':');
+    if (!colon) {
+        fprintf(stderr, "Invalid pinning '%s', expected producers:consumers\n", spec);
+        return -1;
+    }
+    if (parse_cpu_list(spec, colon, &cfg->producers) != 0 ||
+        parse_cpu_list(colon + 1, colon + 1 + strlen(colon + 1), &cfg->consumers) != 0) {
+        fprintf(stderr, "Invalid CPU list in '%s'\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+int pin_cpu_for(const cpu_list_t *list, int index) {
+    return list->count > 0 ? list->cpus[index % list->count] : -1;
+}
+
+int pin_attr_set(pthread_attr_t *attr, const cpu_list_t *list, int index) {
+    int cpu = pin_cpu_for(list, index);
+    if (cpu < 0) return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_attr_setaffinity_np(CPU %d) failed: %d\n", cpu, rc);
+        return -1;
+    }
+    return 0;
+}
+
+void pin_format(const cpu_list_t *list, char *buf, size_t len) {
+    if (list->count == 0) {
+        snprintf(buf, len, "any");
+        return;
+    }
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < list->count && used < len; ++i) {
+        int n = snprintf(buf + used, len - used, i ? ",%d" : "%d", list->cpus[i]);
+        if (n < 0) break;
+        used += (size_t)n;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Закрепление потоков за ядрами при создании (pthread_attr_setaffinity_np).
+// Поток index стороны получает одно ядро cpus[index % count], так что
+// производители и потребители не переезжают между ядрами и не тянут за
+// собой строки кэша очереди.
+#define PIN_MAX_CPUS 64
+
+typedef struct {
+    int count;              // 0 - не закреплять
+    int cpus[PIN_MAX_CPUS];
+} cpu_list_t;
+
+typedef struct {
+    cpu_list_t producers;
+    cpu_list_t consumers;
+} pin_config_t;
+
+// Для потоков лабораторной (run_lab_logic); задаётся ключом -t.
+extern pin_config_t pin_config;
+
+// spec - "P:C", где P и C - списки ядер вида "0,2-3"; любой может быть
+// пустым ("0-1:" - закрепить только производителей). 0 - успех.
+int pin_parse(const char *spec, pin_config_t *cfg);
+// Ядро для потока index или -1, если список пуст.
+int pin_cpu_for(const cpu_list_t *list, int index);
+// Задаёт attr ядро потока index; при пустом списке attr не меняется.
+// 0 - успех.
+int pin_attr_set(pthread_attr_t *attr, const cpu_list_t *list, int index);
+void pin_format(const cpu_list_t *list, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,150 @@
+#include "autosize.h"
+#include "queue_sem.h"
+#include "queue_cond.h"
+#include <stdatomic.h>
+
+volatile sig_atomic_t autosize_enabled = 0;
+
+const autosize_config_t autosize_defaults = {
+    .min_capacity = 5, .max_capacity = 160, .interval_ms = 200, .verbose = 1,
+};
+
+static const autosize_ops_t *ops;
+static autosize_config_t config;
+static pthread_t controller;
+static atomic_int stop_requested;
+static pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
+static autosize_status_t status;
+
+static void sample_sem(autosize_sample_t *s) {
+    queue_snapshot_t st;
+    snapshot_queue_sem(&queue, &st);
+    s->capacity = st.capacity;
+    s->count = st.count;
+    s->added = st.total_added;
+    s->extracted = st.total_extracted;
+    s->full_waits = atomic_load(&queue.full_waits);
+    s->empty_waits = atomic_load(&queue.empty_waits);
+}
+static int resize_sem(int capacity) { return resize_queue_sem(&queue, capacity); }
+
+static void sample_cond(autosize_sample_t *s) {
+    queue_snapshot_t st;
+    snapshot_queue_cond(&queue_cond, &st);
+    s->capacity = st.capacity;
+    s->count = st.count;
+    s->added = st.total_added;
+    s->extracted = st.total_extracted;
+    s->full_waits = atomic_load(&queue_cond.full_waits);
+    s->empty_waits = atomic_load(&queue_cond.empty_waits);
+}
+static int resize_cond(int capacity) { return resize_queue_cond(&queue_cond, capacity); }
+
+const autosize_ops_t autosize_ops_sem = {.name = "semaphores", .sample = sample_sem, .resize = resize_sem};
+const autosize_ops_t autosize_ops_cond = {.name = "condition var", .sample = sample_cond, .resize = resize_cond};
+
+// Решение по двум соседним замерам; 0 - ёмкость не менять.
+static int decide(const autosize_sample_t *prev, const autosize_sample_t *cur, int *quiet, char *why, size_t len) {
+    long full = cur->full_waits - prev->full_waits;
+    long empty = cur->empty_waits - prev->empty_waits;
+    long backlog = (cur->added - prev->added) - (cur->extracted - prev->extracted);
+    int cap = cur->capacity;
+
+    if (cap < config.min_capacity || cap > config.max_capacity) {
+        *quiet = 0;
+        int target = cap < config.min_capacity ? config.min_capacity : config.max_capacity;
+        snprintf(why, len, "%d -> %d: outside bounds %d..%d", cap, target, config.min_capacity, config.max_capacity);
+        return target;
+    }
+    if (full > 0 && cur->count * 4 >= cap * 3) {
+        *quiet = 0;
+        if (cap >= config.max_capacity) return 0;
+        int target = cap * 2 < config.max_capacity ? cap * 2 : config.max_capacity;
+        snprintf(why, len, "grow %d -> %d: %ld producer waits, %d/%d occupied", cap, target, full, cur->count, cap);
+        return target;
+    }
+    if (full == 0 && cur->count * 4 <= cap && backlog <= 0) {
+        (*quiet)++;
+    } else {
+        *quiet = 0;
+    }
+    if (*quiet >= AUTOSIZE_QUIET_TICKS && cap > config.min_capacity) {
+        *quiet = 0;
+        int target = cap / 2 > config.min_capacity ? cap / 2 : config.min_capacity;
+        snprintf(why, len, "shrink %d -> %d: %d/%d occupied, %ld consumer waits", cap, target, cur->count, cap, empty);
+        return target;
+    }
+    return 0;
+}
+
+static void* controller_thread(void* arg) {
+    (void)arg;
+    struct timespec delay = {config.interval_ms / 1000, (config.interval_ms % 1000) * 1000000L};
+    double interval_s = config.interval_ms / 1000.0;
+    autosize_sample_t prev, cur;
+    int quiet = 0;
+    ops->sample(&prev);
+
+    while (!atomic_load(&stop_requested)) {
+        nanosleep(&delay, NULL);
+        ops->sample(&cur);
+
+        char why[sizeof(status.last)];
+        int target = 0;
+        if (autosize_enabled) {
+            target = decide(&prev, &cur, &quiet, why, sizeof(why));
+        } else {
+            quiet = 0;
+        }
+        int resized = target > 0 && ops->resize(target) == 0;
+        if (resized && config.verbose) {
+            printf("Autosize (%s): %s\n", ops->name, why);
+        }
+
+        pthread_mutex_lock(&status_mutex);
+        status.in_rate = (cur.added - prev.added) / interval_s;
+        status.out_rate = (cur.extracted - prev.extracted) / interval_s;
+        if (resized) {
+            if (target > cur.capacity) status.grows++; else status.shrinks++;
+            snprintf(status.last, sizeof(status.last), "%s", why);
+        }
+        pthread_mutex_unlock(&status_mutex);
+        prev = cur;
+    }
+    return NULL;
+}
+
+int autosize_start(const autosize_ops_t *queue_ops, const autosize_config_t *cfg) {
+    ops = queue_ops;
+    config = *cfg;
+    atomic_store(&stop_requested, 0);
+    pthread_mutex_lock(&status_mutex);
+    memset(&status, 0, sizeof(status));
+    snprintf(status.last, sizeof(status.last), "none");
+    pthread_mutex_unlock(&status_mutex);
+
+    if (pthread_create(&controller, NULL, controller_thread, NULL) != 0) {
+        perror("Failed to start autosize controller");
+        return -1;
+    }
+    pthread_mutex_lock(&status_mutex);
+    status.running = 1;
+    pthread_mutex_unlock(&status_mutex);
+    return 0;
+}
+
+void autosize_stop(void) {
+    pthread_mutex_lock(&status_mutex);
+    int running = status.running;
+    status.running = 0;
+    pthread_mutex_unlock(&status_mutex);
+    if (!running) return;
+    atomic_store(&stop_requested, 1);
+    pthread_join(controller, NULL);
+}
+
+void autosize_get_status(autosize_status_t *st) {
+    pthread_mutex_lock(&status_mutex);
+    *st = status;
+    pthread_mutex_unlock(&status_mutex);
+}
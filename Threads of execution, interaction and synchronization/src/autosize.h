@@ -0,0 +1,58 @@
+#ifndef AUTOSIZE_H
+#define AUTOSIZE_H
+
+#include "utils.h"
+
+// Автоподбор ёмкости очередей 1 и 2. Поток-регулятор раз в interval_ms
+// снимает count, темпы total_added/total_extracted и приросты счётчиков
+// ожиданий и меняет ёмкость через resize_queue_sem/resize_queue_cond:
+//  - производители ждали и очередь заполнена на 3/4 и больше - вдвое больше;
+//  - AUTOSIZE_QUIET_TICKS замеров подряд производители не ждали, очередь
+//    занята не больше чем на 1/4 и не копится - вдвое меньше;
+//  - ёмкость вне [min_capacity, max_capacity] (например, после '+'/'-')
+//    возвращается в границы.
+#define AUTOSIZE_QUIET_TICKS 5
+
+typedef struct {
+    int capacity;
+    int count;
+    long added;
+    long extracted;
+    long full_waits;
+    long empty_waits;
+} autosize_sample_t;
+
+typedef struct {
+    const char *name;
+    void (*sample)(autosize_sample_t *s);
+    int (*resize)(int capacity);
+} autosize_ops_t;
+
+typedef struct {
+    int min_capacity;
+    int max_capacity;
+    int interval_ms;
+    int verbose;            // печатать каждое решение
+} autosize_config_t;
+
+typedef struct {
+    int running;            // регулятор запущен для текущей очереди
+    long grows;
+    long shrinks;
+    double in_rate;         // сообщений в секунду за последний замер
+    double out_rate;
+    char last[128];         // последнее решение
+} autosize_status_t;
+
+extern const autosize_ops_t autosize_ops_sem;
+extern const autosize_ops_t autosize_ops_cond;
+extern const autosize_config_t autosize_defaults;
+
+// 1 - регулятор меняет ёмкость, 0 - только замеряет; клавиша 'a'.
+extern volatile sig_atomic_t autosize_enabled;
+
+int autosize_start(const autosize_ops_t *ops, const autosize_config_t *cfg);
+void autosize_stop(void);
+void autosize_get_status(autosize_status_t *st);
+
+#endif
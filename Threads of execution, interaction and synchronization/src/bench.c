@@ -0,0 +1,849 @@
+#define _GNU_SOURCE             // syscall(SYS_perf_event_open)
+#include "bench.h"
+#include "message.h"
+#include "queue_sem.h"
+#include "queue_cond.h"
+#include "queue_mpmc.h"
+#include "queue_ring.h"
+#include "queue_shard.h"
+#include "queue_prio.h"
+#include "msg_pool.h"
+#include "autosize.h"
+#include "spin_wait.h"
+#include "affinity.h"
+#include "utils.h"
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <stdatomic.h>
+
+// Гистограмма задержек в наносекундах: до 16 нс - точные значения, дальше
+// по 16 ступеней на каждую степень двойки (погрешность не больше 6%).
+#define HIST_SUB 16
+#define HIST_BUCKETS (HIST_SUB * 48)
+
+typedef struct {
+    long buckets[HIST_BUCKETS];
+    long total;
+} latency_hist_t;
+
+typedef struct {
+    const char *name;
+    int (*init)(int size);
+    void (*destroy)(void);
+    void (*enqueue)(Message *msg);
+    Message *(*dequeue)(void);
+    long (*producer_waits)(void);
+    long (*consumer_waits)(void);
+    // Пакетные операции (необязательны): возвращают число перемещённых
+    // сообщений, >= 1. lock_ops - захваты мьютекса на пути данных.
+    int (*enqueue_batch)(Message **msgs, int n);
+    int (*dequeue_batch)(Message **msgs, int n);
+    long (*lock_ops)(void);
+    // Изменение ёмкости на ходу (необязательно), для -r.
+    int (*resize)(int capacity);
+    const autosize_ops_t *autosize;     // регулятор ёмкости для -A
+    // Снимок счётчиков без мьютекса очереди (необязателен), для -m.
+    void (*snapshot)(queue_snapshot_t *s);
+    // Дополнительные строки отчёта после прогона (необязательно).
+    void (*report)(void);
+    // Вызываются в потоке потребителя index (0..C-1) до и после работы.
+    void (*consumer_start)(int index);
+    void (*consumer_stop)(int index);
+    // Очереди, хранящие сообщения в себе: место берётся reserve и
+    // заполняется на месте, потребитель читает через acquire/release.
+    Message *(*reserve)(uint8_t size_field);
+    void (*commit)(Message *msg);
+    Message *(*acquire)(void);
+    void (*release)(Message *msg);
+} bench_engine_t;
+
+typedef struct {
+    int fixed;          // 1 - поле size всегда min_size
+    int min_size;
+    int max_size;
+} size_dist_t;
+
+typedef struct {
+    int id;             // номер среди производителей или среди потребителей
+    long count;         // сколько сообщений произвести (для производителя)
+    unsigned int seed;
+    latency_hist_t hist;
+} bench_thread_t;
+
+static const bench_engine_t *engine;
+static size_dist_t dist;
+static long total_messages;
+static int batch = 1;
+static int resize_ms;
+static int monitor_us = -1;     // -1 - без -m
+static autosize_config_t autosize_config;   // max_capacity == 0 - без -A
+static shard_policy_t shard_policy = SHARD_ROUND_ROBIN;
+static prio_policy_t prio_policy = PRIO_WEIGHTED;
+static int prio_aging_ms = PRIO_AGING_MS;
+static pin_config_t bench_pins;
+static int report_counters;
+static atomic_int resizer_stop;
+static atomic_int monitor_stop;
+static atomic_long consume_tickets;
+static atomic_long hash_failures;
+
+static int hist_bucket(long ns) {
+    if (ns < HIST_SUB) return ns < 0 ? 0 : (int)ns;
+    int msb = 63 - __builtin_clzl((unsigned long)ns);
+    int sub = (int)((ns >> (msb - 4)) & (HIST_SUB - 1));
+    int b = (msb - 3) * HIST_SUB + sub;
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+static long hist_bucket_value(int b) {
+    if (b < HIST_SUB) return b;
+    int msb = b / HIST_SUB + 3;
+    return (long)(HIST_SUB + b % HIST_SUB) << (msb - 4);
+}
+
+static long hist_percentile(const latency_hist_t *h, double p) {
+    long need = (long)(h->total * p);
+    long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += h->buckets[b];
+        if (seen > need) return hist_bucket_value(b);
+    }
+    return 0;
+}
+
+// --- Обёртки над очередями: ждать без дедлайна, пока операция не пройдёт ---
+
+static int bench_init_sem(int size) { return init_queue_sem(&queue, size); }
+// Все потоки завершены и очередь пуста: токенов empty_slots должно быть
+// ровно capacity + slot_debt, иначе учёт слотов при перестройке разошёлся.
+static void bench_destroy_sem(void) {
+    int empty;
+    sem_getvalue(&queue.empty_slots, &empty);
+    if (empty + queue.count != queue.capacity + queue.slot_debt) {
+        fprintf(stderr, "Benchmark: sem accounting drift: empty_slots %d, count %d, capacity %d, debt %d\n",
+                empty, queue.count, queue.capacity, queue.slot_debt);
+    }
+    destroy_queue_sem(&queue);
+}
+static int bench_resize_sem(int capacity) { return resize_queue_sem(&queue, capacity); }
+static void bench_enqueue_sem(Message *msg) {
+    while (enqueue_sem(&queue, msg, NULL) != QUEUE_OK) {}
+}
+static Message *bench_dequeue_sem(void) {
+    Message *msg = NULL;
+    while (dequeue_sem(&queue, &msg, NULL) != QUEUE_OK) {}
+    return msg;
+}
+static int bench_enqueue_batch_sem(Message **msgs, int n) {
+    int k;
+    while ((k = enqueue_batch_sem(&queue, msgs, n, NULL)) <= 0) {}
+    return k;
+}
+static int bench_dequeue_batch_sem(Message **msgs, int n) {
+    int k;
+    while ((k = dequeue_batch_sem(&queue, msgs, n, NULL)) <= 0) {}
+    return k;
+}
+static long bench_locks_sem(void) { return queue.lock_ops; }
+static void bench_snapshot_sem(queue_snapshot_t *s) { snapshot_queue_sem(&queue, s); }
+static long bench_pwaits_sem(void) { return atomic_load(&queue.full_waits); }
+static long bench_cwaits_sem(void) { return atomic_load(&queue.empty_waits); }
+
+static int bench_init_cond(int size) { return init_queue_cond(&queue_cond, size); }
+static void bench_destroy_cond(void) { destroy_queue_cond(&queue_cond); }
+static int bench_resize_cond(int capacity) { return resize_queue_cond(&queue_cond, capacity); }
+static void bench_enqueue_cond(Message *msg) {
+    while (enqueue_cond(&queue_cond, msg, NULL) != QUEUE_OK) {}
+}
+static Message *bench_dequeue_cond(void) {
+    Message *msg = NULL;
+    while (dequeue_cond(&queue_cond, &msg, NULL) != QUEUE_OK) {}
+    return msg;
+}
+static int bench_enqueue_batch_cond(Message **msgs, int n) {
+    int k;
+    while ((k = enqueue_batch_cond(&queue_cond, msgs, n, NULL)) <= 0) {}
+    return k;
+}
+static int bench_dequeue_batch_cond(Message **msgs, int n) {
+    int k;
+    while ((k = dequeue_batch_cond(&queue_cond, msgs, n, NULL)) <= 0) {}
+    return k;
+}
+static long bench_locks_cond(void) { return queue_cond.lock_ops; }
+static void bench_snapshot_cond(queue_snapshot_t *s) { snapshot_queue_cond(&queue_cond, s); }
+static long bench_pwaits_cond(void) { return atomic_load(&queue_cond.full_waits); }
+static long bench_cwaits_cond(void) { return atomic_load(&queue_cond.empty_waits); }
+
+// Кольцо MPMC не блокируется: на полном/пустом кольце уступаем процессор.
+static int bench_init_mpmc(int size) { return init_queue_mpmc(&queue_mpmc, size); }
+static void bench_destroy_mpmc(void) { destroy_queue_mpmc(&queue_mpmc); }
+static void bench_enqueue_mpmc(Message *msg) {
+    while (enqueue_mpmc(&queue_mpmc, msg) != 0) {
+        atomic_fetch_add_explicit(&queue_mpmc.full_waits, 1, memory_order_relaxed);
+        sched_yield();
+    }
+}
+static Message *bench_dequeue_mpmc(void) {
+    Message *msg = NULL;
+    while (dequeue_mpmc(&queue_mpmc, &msg) != 0) {
+        atomic_fetch_add_explicit(&queue_mpmc.empty_waits, 1, memory_order_relaxed);
+        sched_yield();
+    }
+    return msg;
+}
+static long bench_pwaits_mpmc(void) { return atomic_load(&queue_mpmc.full_waits); }
+static long bench_cwaits_mpmc(void) { return atomic_load(&queue_mpmc.empty_waits); }
+
+static int bench_init_ring(int size) { return init_queue_ring(&queue_ring, size); }
+static void bench_destroy_ring(void) { destroy_queue_ring(&queue_ring); }
+static Message *bench_reserve_ring(uint8_t size_field) {
+    Message *msg;
+    while (!(msg = ring_reserve(&queue_ring, size_field, NULL))) {}
+    return msg;
+}
+static void bench_commit_ring(Message *msg) { ring_commit(&queue_ring, msg); }
+static Message *bench_acquire_ring(void) {
+    Message *msg;
+    while (!(msg = ring_acquire(&queue_ring, NULL))) {}
+    return msg;
+}
+static void bench_release_ring(Message *msg) { ring_release(&queue_ring, msg); }
+static long bench_pwaits_ring(void) { return atomic_load(&queue_ring.full_waits); }
+static long bench_cwaits_ring(void) { return atomic_load(&queue_ring.empty_waits); }
+
+static _Thread_local int shard_home;
+static int bench_init_shard(int size) { return init_queue_shard(&queue_shard, size, shard_policy); }
+static void bench_destroy_shard(void) { destroy_queue_shard(&queue_shard); }
+static void bench_start_shard(int index) {
+    shard_home = index;
+    shard_attach(&queue_shard, index);
+}
+static void bench_stop_shard(int index) { shard_detach(&queue_shard, index); }
+static void bench_enqueue_shard(Message *msg) {
+    while (enqueue_shard(&queue_shard, msg, NULL) != QUEUE_OK) {}
+}
+static Message *bench_dequeue_shard(void) {
+    Message *msg = NULL;
+    while (dequeue_shard(&queue_shard, shard_home, &msg, NULL) != QUEUE_OK) {}
+    return msg;
+}
+static int bench_dequeue_batch_shard(Message **msgs, int n) {
+    int k;
+    while ((k = dequeue_batch_shard(&queue_shard, shard_home, msgs, n, NULL)) <= 0) {}
+    return k;
+}
+static long bench_pwaits_shard(void) { return atomic_load(&queue_shard.full_waits); }
+static long bench_cwaits_shard(void) { return atomic_load(&queue_shard.empty_waits); }
+
+static int bench_init_prio(int size) { return init_queue_prio(&queue_prio, size, prio_policy, prio_aging_ms); }
+static void bench_destroy_prio(void) { destroy_queue_prio(&queue_prio); }
+static void bench_enqueue_prio(Message *msg) {
+    while (enqueue_prio(&queue_prio, msg, NULL) != QUEUE_OK) {}
+}
+static Message *bench_dequeue_prio(void) {
+    Message *msg = NULL;
+    while (dequeue_prio(&queue_prio, &msg, NULL, NULL) != QUEUE_OK) {}
+    return msg;
+}
+static long bench_pwaits_prio(void) { return atomic_load(&queue_prio.full_waits); }
+static long bench_cwaits_prio(void) { return atomic_load(&queue_prio.empty_waits); }
+static void bench_report_prio(void) {
+    prio_stats_t st;
+    prio_get_stats(&queue_prio, &st);
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        prio_lane_stats_t *l = &st.lanes[i];
+        printf("      lane %-6s (%s, weight %d): %9ld msgs, wait avg %8ld ns, max %10ld ns, aged %ld\n",
+               prio_lane_names[i], st.policy == PRIO_STRICT ? "strict" : "weighted", l->weight,
+               l->extracted, l->wait_ns_avg, l->wait_ns_max, l->aged);
+    }
+}
+
+static const bench_engine_t engines[] = {
+    {.name = "sem", .init = bench_init_sem, .destroy = bench_destroy_sem,
+     .enqueue = bench_enqueue_sem, .dequeue = bench_dequeue_sem,
+     .enqueue_batch = bench_enqueue_batch_sem, .dequeue_batch = bench_dequeue_batch_sem,
+     .lock_ops = bench_locks_sem, .resize = bench_resize_sem, .autosize = &autosize_ops_sem,
+     .snapshot = bench_snapshot_sem,
+     .producer_waits = bench_pwaits_sem, .consumer_waits = bench_cwaits_sem},
+    {.name = "cond", .init = bench_init_cond, .destroy = bench_destroy_cond,
+     .enqueue = bench_enqueue_cond, .dequeue = bench_dequeue_cond,
+     .enqueue_batch = bench_enqueue_batch_cond, .dequeue_batch = bench_dequeue_batch_cond,
+     .lock_ops = bench_locks_cond, .resize = bench_resize_cond, .autosize = &autosize_ops_cond,
+     .snapshot = bench_snapshot_cond,
+     .producer_waits = bench_pwaits_cond, .consumer_waits = bench_cwaits_cond},
+    {.name = "mpmc", .init = bench_init_mpmc, .destroy = bench_destroy_mpmc,
+     .enqueue = bench_enqueue_mpmc, .dequeue = bench_dequeue_mpmc,
+     .producer_waits = bench_pwaits_mpmc, .consumer_waits = bench_cwaits_mpmc},
+    {.name = "ring", .init = bench_init_ring, .destroy = bench_destroy_ring,
+     .reserve = bench_reserve_ring, .commit = bench_commit_ring,
+     .acquire = bench_acquire_ring, .release = bench_release_ring,
+     .producer_waits = bench_pwaits_ring, .consumer_waits = bench_cwaits_ring},
+    {.name = "shard", .init = bench_init_shard, .destroy = bench_destroy_shard,
+     .enqueue = bench_enqueue_shard, .dequeue = bench_dequeue_shard,
+     .dequeue_batch = bench_dequeue_batch_shard,
+     .consumer_start = bench_start_shard, .consumer_stop = bench_stop_shard,
+     .producer_waits = bench_pwaits_shard, .consumer_waits = bench_cwaits_shard},
+    {.name = "prio", .init = bench_init_prio, .destroy = bench_destroy_prio,
+     .enqueue = bench_enqueue_prio, .dequeue = bench_dequeue_prio, .report = bench_report_prio,
+     .producer_waits = bench_pwaits_prio, .consumer_waits = bench_cwaits_prio},
+};
+#define ENGINE_COUNT ((int)(sizeof(engines) / sizeof(engines[0])))
+
+static void record_latency(bench_thread_t *t, long ns) {
+    t->hist.buckets[hist_bucket(ns)]++;
+    t->hist.total++;
+}
+
+static void* bench_producer(void* arg) {
+    bench_thread_t *t = arg;
+    Message *msgs[MAX_BATCH];
+    int pending = 0;
+    for (long produced = 0; produced < t->count; ) {
+        uint8_t size_field = dist.fixed ? (uint8_t)dist.min_size
+            : (uint8_t)(dist.min_size + rand_r(&t->seed) % (dist.max_size - dist.min_size + 1));
+        if (engine->reserve) {
+            // Задержка постановки - резерв плюс публикация, без заполнения.
+            long start = monotonic_ns();
+            Message *slot = engine->reserve(size_field);
+            long reserved = monotonic_ns();
+            fill_message(slot, &t->seed, size_field);
+            long filled = monotonic_ns();
+            engine->commit(slot);
+            record_latency(t, reserved - start + monotonic_ns() - filled);
+            produced++;
+            continue;
+        }
+
+        Message *msg = create_message_sized(&t->seed, size_field);
+        if (!msg) continue;
+        msgs[pending++] = msg;
+        if (pending < batch && produced + pending < t->count) continue;
+
+        // Пачка собрана - отправляем её целиком, замеряя каждый вызов очереди.
+        int sent = 0;
+        while (sent < pending) {
+            long start = monotonic_ns();
+            int k = 1;
+            if (engine->enqueue_batch) {
+                k = engine->enqueue_batch(msgs + sent, pending - sent);
+            } else {
+                engine->enqueue(msgs[sent]);
+            }
+            record_latency(t, monotonic_ns() - start);
+            sent += k;
+        }
+        produced += pending;
+        pending = 0;
+    }
+    return NULL;
+}
+
+static void consume_one(Message *msg) {
+    if (!msg || calculate_hash(msg) != msg->hash) {
+        atomic_fetch_add(&hash_failures, 1);
+    }
+    if (engine->release) {
+        engine->release(msg);
+    } else {
+        destroy_message(msg);
+    }
+}
+
+static void* bench_consumer(void* arg) {
+    bench_thread_t *t = arg;
+    int claim = engine->dequeue_batch ? batch : 1;
+    if (engine->consumer_start) engine->consumer_start(t->id);
+    for (;;) {
+        long first = atomic_fetch_add(&consume_tickets, claim);
+        if (first >= total_messages) break;
+        int want = total_messages - first < claim ? (int)(total_messages - first) : claim;
+        while (want > 0) {
+            Message *msgs[MAX_BATCH];
+            long start = monotonic_ns();
+            int k = 1;
+            if (engine->acquire) {
+                msgs[0] = engine->acquire();
+            } else if (engine->dequeue_batch) {
+                k = engine->dequeue_batch(msgs, want);
+            } else {
+                msgs[0] = engine->dequeue();
+            }
+            record_latency(t, monotonic_ns() - start);
+            for (int i = 0; i < k; ++i) consume_one(msgs[i]);
+            want -= k;
+        }
+    }
+    if (engine->consumer_stop) engine->consumer_stop(t->id);
+    return NULL;
+}
+
+typedef struct {
+    int capacity;
+    long resizes;
+    long max_ns;        // самый долгий вызов resize
+} bench_resizer_t;
+
+// Каждые resize_ms мс меняет ёмкость по кругу cap*4 -> cap/4 -> cap, так что
+// уменьшение часто приходится на заполненную очередь.
+static void* bench_resizer(void* arg) {
+    bench_resizer_t *r = arg;
+    int small = r->capacity / 4 > 0 ? r->capacity / 4 : 1;
+    int targets[3] = {r->capacity * 4, small, r->capacity};
+    struct timespec delay = {resize_ms / 1000, (resize_ms % 1000) * 1000000L};
+    for (int i = 0; !atomic_load(&resizer_stop); i = (i + 1) % 3) {
+        nanosleep(&delay, NULL);
+        long start = monotonic_ns();
+        if (engine->resize(targets[i]) != 0) break;
+        long ns = monotonic_ns() - start;
+        if (ns > r->max_ns) r->max_ns = ns;
+        r->resizes++;
+    }
+    return NULL;
+}
+
+typedef struct {
+    long polls;
+    long torn;          // снимки, где count != added - extracted
+    long max_ns;        // самое долгое чтение снимка
+} bench_monitor_t;
+
+// Читает снимок счётчиков каждые monitor_us мкс (0 - без пауз), как поток
+// мониторинга; заодно проверяет, что снимок согласован.
+static void* bench_monitor(void* arg) {
+    bench_monitor_t *m = arg;
+    struct timespec delay = {monitor_us / 1000000, (monitor_us % 1000000) * 1000L};
+    while (!atomic_load(&monitor_stop)) {
+        if (monitor_us > 0) nanosleep(&delay, NULL);
+        queue_snapshot_t st;
+        long start = monotonic_ns();
+        engine->snapshot(&st);
+        long ns = monotonic_ns() - start;
+        if (ns > m->max_ns) m->max_ns = ns;
+        if (st.count != st.total_added - st.total_extracted) m->torn++;
+        m->polls++;
+    }
+    return NULL;
+}
+
+// --- -x: счётчики ядра за прогон (perf_event_open, наследуются потоками) ---
+
+#define COUNTER_COUNT 3
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} counter_defs[COUNTER_COUNT] = {
+    // Промахи кэша - в основном строки очереди, переезжающие между ядрами.
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache misses"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu migrations"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context switches"},
+};
+
+// Открываются до создания потоков прогона: inherit считает и их, а
+// значения завершившихся потоков прибавляются к счётчику главного.
+static void counters_open(int fds[COUNTER_COUNT]) {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_defs[i].type;
+        attr.config = counter_defs[i].config;
+        attr.inherit = 1;
+        // Программные события (переключения, миграции) случаются в ядре.
+        attr.exclude_kernel = counter_defs[i].type == PERF_TYPE_HARDWARE;
+        attr.exclude_hv = 1;
+        fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+static void counters_report(int fds[COUNTER_COUNT]) {
+    printf("     ");
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        uint64_t value;
+        if (fds[i] >= 0 && read(fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            printf(" %s %llu%s", counter_defs[i].name, (unsigned long long)value, i + 1 < COUNTER_COUNT ? "," : "\n");
+        } else {
+            printf(" %s n/a%s", counter_defs[i].name, i + 1 < COUNTER_COUNT ? "," : "\n");
+        }
+        if (fds[i] >= 0) close(fds[i]);
+    }
+}
+
+static void merge_hist(latency_hist_t *dst, const latency_hist_t *src) {
+    for (int b = 0; b < HIST_BUCKETS; ++b) dst->buckets[b] += src->buckets[b];
+    dst->total += src->total;
+}
+
+static int run_engine(const bench_engine_t *e, int producers, int consumers, int capacity) {
+    engine = e;
+    keep_running = 1;
+    if (e->init(capacity) != 0) {
+        fprintf(stderr, "Benchmark: failed to initialize queue '%s'\n", e->name);
+        return -1;
+    }
+    atomic_store(&consume_tickets, 0);
+    atomic_store(&hash_failures, 0);
+
+    bench_thread_t *threads = calloc(producers + consumers, sizeof(bench_thread_t));
+    pthread_t *tids = calloc(producers + consumers, sizeof(pthread_t));
+    if (!threads || !tids) {
+        perror("Benchmark: calloc");
+        free(threads);
+        free(tids);
+        e->destroy();
+        return -1;
+    }
+
+    int counter_fds[COUNTER_COUNT];
+    if (report_counters) counters_open(counter_fds);
+
+    long start = monotonic_ns();
+    int started = 0;
+    for (int i = 0; i < producers + consumers; ++i) {
+        bench_thread_t *t = &threads[i];
+        t->id = i < producers ? i : i - producers;
+        t->seed = (unsigned int)rand();
+        if (i < producers) {
+            t->count = total_messages / producers + (i < total_messages % producers ? 1 : 0);
+        }
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pin_attr_set(&attr, i < producers ? &bench_pins.producers : &bench_pins.consumers, t->id);
+        int rc = pthread_create(&tids[i], &attr, i < producers ? bench_producer : bench_consumer, t);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            errno = rc;
+            perror("Benchmark: pthread_create");
+            break;
+        }
+        started++;
+    }
+    bench_resizer_t resizer = {.capacity = capacity};
+    pthread_t resizer_tid;
+    int resizing = 0;
+    if (resize_ms > 0 && e->resize) {
+        atomic_store(&resizer_stop, 0);
+        resizing = pthread_create(&resizer_tid, NULL, bench_resizer, &resizer) == 0;
+    }
+    bench_monitor_t monitor = {0};
+    pthread_t monitor_tid;
+    int monitoring = 0;
+    if (monitor_us >= 0 && e->snapshot) {
+        atomic_store(&monitor_stop, 0);
+        monitoring = pthread_create(&monitor_tid, NULL, bench_monitor, &monitor) == 0;
+    }
+    int autosizing = autosize_config.max_capacity > 0 && e->autosize &&
+                     autosize_start(e->autosize, &autosize_config) == 0;
+    for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    long elapsed = monotonic_ns() - start;
+    if (autosizing) autosize_stop();
+    if (resizing) {
+        atomic_store(&resizer_stop, 1);
+        pthread_join(resizer_tid, NULL);
+    }
+    if (monitoring) {
+        atomic_store(&monitor_stop, 1);
+        pthread_join(monitor_tid, NULL);
+    }
+
+    latency_hist_t enq = {0}, deq = {0};
+    for (int i = 0; i < producers; ++i) merge_hist(&enq, &threads[i].hist);
+    for (int i = producers; i < producers + consumers; ++i) merge_hist(&deq, &threads[i].hist);
+
+    char locks[16] = "-";
+    if (e->lock_ops) snprintf(locks, sizeof(locks), "%.2f", (double)e->lock_ops() / total_messages);
+    printf("%-5s %4d %4d %6d %3d %10ld %12.0f %9ld %9ld %9ld %9ld %10ld %10ld %9s %6ld\n",
+           e->name, producers, consumers, capacity, batch, total_messages,
+           total_messages / (elapsed / 1e9),
+           hist_percentile(&enq, 0.50), hist_percentile(&enq, 0.99),
+           hist_percentile(&deq, 0.50), hist_percentile(&deq, 0.99),
+           e->producer_waits(), e->consumer_waits(), locks, atomic_load(&hash_failures));
+    if (resizing) {
+        printf("      %ld resizes during the run, slowest resize call %ld ns\n", resizer.resizes, resizer.max_ns);
+    }
+    if (e->report) e->report();
+    if (report_counters) counters_report(counter_fds);
+    if (monitoring) {
+        printf("      %ld status snapshots (%.0f/s), slowest %ld ns, %ld inconsistent\n",
+               monitor.polls, monitor.polls / (elapsed / 1e9), monitor.max_ns, monitor.torn);
+    }
+    if (autosizing) {
+        autosize_status_t st;
+        autosize_get_status(&st);
+        autosize_sample_t end;
+        e->autosize->sample(&end);
+        printf("      autosize %d..%d: %ld grows, %ld shrinks, final capacity %d, last: %s\n",
+               autosize_config.min_capacity, autosize_config.max_capacity,
+               st.grows, st.shrinks, end.capacity, st.last);
+    }
+
+    free(threads);
+    free(tids);
+    e->destroy();
+    return 0;
+}
+
+// --- -H: замер calculate_hash против прежнего побайтового цикла ---
+
+#define HASH_BENCH_MESSAGES 4096
+#define HASH_BENCH_ROUNDS 200
+
+static uint16_t hash_bytewise(const Message *msg) {
+    uint16_t hash_val = 0;
+    size_t data_len = msg->size + 1;
+    size_t padded_data_size = PADDED_DATA_SIZE(msg->size);
+
+    hash_val ^= msg->type;
+    hash_val ^= msg->size;
+    for (size_t i = 0; i < data_len; ++i) {
+        if (i >= padded_data_size) return 0xFFFF;
+        hash_val ^= msg->data[i];
+    }
+    hash_val = (hash_val << 8) | (hash_val >> 8);
+    return hash_val;
+}
+
+static volatile uint16_t hash_sink;
+
+static double hash_ns_per_msg(uint16_t (*fn)(const Message *), Message **msgs, int count) {
+    uint16_t acc = 0;
+    long start = monotonic_ns();
+    for (int r = 0; r < HASH_BENCH_ROUNDS; ++r) {
+        for (int i = 0; i < count; ++i) acc ^= fn(msgs[i]);
+    }
+    long elapsed = monotonic_ns() - start;
+    hash_sink = acc;
+    return (double)elapsed / ((double)HASH_BENCH_ROUNDS * count);
+}
+
+static int run_hash_bench(void) {
+    Message **msgs = calloc(HASH_BENCH_MESSAGES, sizeof(Message *));
+    if (!msgs) {
+        perror("Benchmark: calloc");
+        return 1;
+    }
+    unsigned int seed = 1;
+    long checked = 0, mismatches = 0;
+    for (int size = 0; size <= MAX_DATA_SIZE; ++size) {
+        for (int k = 0; k < 16; ++k) {
+            Message *msg = create_message_sized(&seed, (uint8_t)size);
+            if (!msg) break;
+            if (calculate_hash(msg) != hash_bytewise(msg)) mismatches++;
+            checked++;
+            destroy_message(msg);
+        }
+    }
+    printf("Verified %ld messages: %ld mismatches against the byte-serial hash.\n", checked, mismatches);
+
+    printf("%-8s %12s %12s\n", "size", "bytes", "words");
+    const int sizes[] = {7, 31, 127, MAX_DATA_SIZE, -1};
+    int rc = mismatches == 0 ? 0 : 1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int created = 0;
+        for (; created < HASH_BENCH_MESSAGES; ++created) {
+            int size = sizes[s] >= 0 ? sizes[s] : (int)(rand_r(&seed) % (MAX_DATA_SIZE + 1));
+            if (!(msgs[created] = create_message_sized(&seed, (uint8_t)size))) break;
+        }
+        double bytewise = hash_ns_per_msg(hash_bytewise, msgs, created);
+        double words = hash_ns_per_msg(calculate_hash, msgs, created);
+        char label[16];
+        if (sizes[s] >= 0) {
+            snprintf(label, sizeof(label), "%d", sizes[s] + 1);
+        } else {
+            snprintf(label, sizeof(label), "random");
+        }
+        printf("%-8s %12.1f %12.1f\n", label, bytewise, words);
+        for (int i = 0; i < created; ++i) destroy_message(msgs[i]);
+        if (created < HASH_BENCH_MESSAGES) rc = 1;
+    }
+    printf("Times in ns per message, size is the data length in bytes.\n");
+    free(msgs);
+    msg_pool_destroy();
+    return rc;
+}
+
+static int parse_dist(const char *s, size_dist_t *d) {
+    int a, b;
+    char tail;
+    if (strcmp(s, "uniform") == 0) {
+        d->fixed = 0; d->min_size = 0; d->max_size = MAX_DATA_SIZE;
+        return 0;
+    }
+    if (sscanf(s, "fixed:%d%c", &a, &tail) == 1 && a >= 0 && a <= MAX_DATA_SIZE) {
+        d->fixed = 1; d->min_size = d->max_size = a;
+        return 0;
+    }
+    if (sscanf(s, "range:%d-%d%c", &a, &b, &tail) == 2 && a >= 0 && a <= b && b <= MAX_DATA_SIZE) {
+        d->fixed = 0; d->min_size = a; d->max_size = b;
+        return 0;
+    }
+    return -1;
+}
+
+static void bench_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -b [-e sem,cond,mpmc,ring,shard,prio] [-p producers] [-c consumers] [-q capacity]\n"
+            "          [-n messages] [-s uniform|fixed:N|range:A-B] [-a pool|malloc] [-k batch]\n"
+            "          [-r ms] [-A min-max] [-w auto|spin|park] [-S rr|type] [-m us]\n"
+            "          [-P wfq|strict] [-G ms] [-t P:C] [-x]\n"
+            "       %s -b -H\n"
+            "  -s sets the Message size field (data length is size + 1), N/A/B in 0..%d\n"
+            "  -a selects the Message allocator (default: pool)\n"
+            "  -k moves up to batch (1..%d) messages per queue call; latencies are per call\n"
+            "  -r resizes sem/cond queues every ms milliseconds (cap*4, cap/4, cap) under load\n"
+            "  -A runs the sem/cond capacity controller within min..max (20 ms ticks)\n"
+            "  -w sem/cond waits: spin then park (auto: only with >1 CPU) or park at once\n"
+            "  -S shard choice for producers: round robin or Message.type\n"
+            "  -m reads sem/cond status snapshots every us microseconds (0: non-stop)\n"
+            "  -P prio lane policy: weighted round robin or strict priority\n"
+            "  -G prio aging threshold in milliseconds (0: no aging, default %d)\n"
+            "  -t pins producer/consumer i to the i-th CPU of list P/C, e.g. 0,1:2-3\n"
+            "  -x reports cache misses, CPU migrations and context switches per run\n"
+            "  -H compares calculate_hash with the byte-serial hash instead of running queues\n",
+            prog, prog, MAX_DATA_SIZE, MAX_BATCH, PRIO_AGING_MS);
+}
+
+int run_benchmark(int argc, char *argv[]) {
+    const char *engine_list = "sem,cond,mpmc,ring,shard,prio";
+    int producers = 1, consumers = 1, capacity = INITIAL_QUEUE_SIZE;
+    int hash_only = 0;
+    total_messages = 1000000;
+    parse_dist("uniform", &dist);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "be:p:c:q:n:s:a:k:r:A:w:S:m:HP:G:t:x")) != -1) {
+        switch (opt) {
+            case 'b': break;
+            case 'e': engine_list = optarg; break;
+            case 'p': producers = atoi(optarg); break;
+            case 'c': consumers = atoi(optarg); break;
+            case 'q': capacity = atoi(optarg); break;
+            case 'n': total_messages = atol(optarg); break;
+            case 'k': batch = atoi(optarg); break;
+            case 'r': resize_ms = atoi(optarg); break;
+            case 'm': monitor_us = atoi(optarg); break;
+            case 'H': hash_only = 1; break;
+            case 'G': prio_aging_ms = atoi(optarg); break;
+            case 'x': report_counters = 1; break;
+            case 't':
+                if (pin_parse(optarg, &bench_pins) != 0) {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'P':
+                if (strcmp(optarg, "wfq") == 0) {
+                    prio_policy = PRIO_WEIGHTED;
+                } else if (strcmp(optarg, "strict") == 0) {
+                    prio_policy = PRIO_STRICT;
+                } else {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'S':
+                if (strcmp(optarg, "rr") == 0) {
+                    shard_policy = SHARD_ROUND_ROBIN;
+                } else if (strcmp(optarg, "type") == 0) {
+                    shard_policy = SHARD_BY_TYPE;
+                } else {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w':
+                if (strcmp(optarg, "auto") == 0) {
+                    spin_configure(SPIN_AUTO);
+                } else if (strcmp(optarg, "spin") == 0) {
+                    spin_configure(SPIN_ON);
+                } else if (strcmp(optarg, "park") == 0) {
+                    spin_configure(SPIN_OFF);
+                } else {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'A':
+                autosize_config = (autosize_config_t){.interval_ms = 20};
+                if (sscanf(optarg, "%d-%d", &autosize_config.min_capacity, &autosize_config.max_capacity) != 2 ||
+                    autosize_config.min_capacity < 1 ||
+                    autosize_config.max_capacity < autosize_config.min_capacity) {
+                    fprintf(stderr, "Invalid autosize bounds '%s'\n", optarg);
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                autosize_enabled = 1;
+                break;
+            case 'a':
+                if (strcmp(optarg, "pool") == 0) {
+                    msg_pool_enabled = 1;
+                } else if (strcmp(optarg, "malloc") == 0) {
+                    msg_pool_enabled = 0;
+                } else {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's':
+                if (parse_dist(optarg, &dist) != 0) {
+                    fprintf(stderr, "Invalid size distribution '%s'\n", optarg);
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                bench_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc || producers < 1 || consumers < 1 || producers > MAX_THREADS ||
+        consumers > MAX_THREADS || capacity < 1 || total_messages < 1 ||
+        batch < 1 || batch > MAX_BATCH || resize_ms < 0 || monitor_us < -1 || prio_aging_ms < 0) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    if (hash_only) {
+        return run_hash_bench();
+    }
+
+    printf("%-5s %4s %4s %6s %3s %10s %12s %9s %9s %9s %9s %10s %10s %9s %6s\n",
+           "queue", "P", "C", "cap", "k", "messages", "msgs/s",
+           "enq_p50", "enq_p99", "deq_p50", "deq_p99", "prod_waits", "cons_waits", "locks/msg", "bad");
+
+    char list[256];
+    snprintf(list, sizeof(list), "%s", engine_list);
+    char *save = NULL;
+    int rc = 0;
+    for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int found = 0;
+        for (int i = 0; i < ENGINE_COUNT; ++i) {
+            if (strcmp(name, engines[i].name) == 0) {
+                found = 1;
+                if (run_engine(&engines[i], producers, consumers, capacity) != 0) rc = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown queue '%s' (sem|cond|mpmc|ring|shard|prio)\n", name);
+            rc = 1;
+        }
+    }
+    printf("Latencies in ns, allocator: %s, spin waits: %s.\n",
+           msg_pool_enabled ? "pool" : "malloc", spin_enabled() ? "on" : "off");
+    if (bench_pins.producers.count || bench_pins.consumers.count) {
+        char pcpus[128], ccpus[128];
+        pin_format(&bench_pins.producers, pcpus, sizeof(pcpus));
+        pin_format(&bench_pins.consumers, ccpus, sizeof(ccpus));
+        printf("Pinned: producers on CPUs %s, consumers on CPUs %s.\n", pcpus, ccpus);
+    }
+    if (msg_pool_enabled) {
+        msg_pool_stats_t st;
+        msg_pool_get_stats(&st);
+        printf("Message pool: %ld slabs, %ld magazines taken from depot, %ld returned.\n",
+               st.slabs, st.depot_gets, st.depot_puts);
+    }
+    msg_pool_destroy();
+    return rc;
+}
@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Неинтерактивный режим замера очередей: prod_cons -b [параметры].
+// Производители и потребители гоняют настоящие enqueue_* / dequeue_* без
+// задержек и печати; на выходе - сообщений в секунду, p50/p99 задержки
+// постановки и извлечения и число уходов в ожидание по каждой очереди.
+int run_benchmark(int argc, char *argv[]);
+
+#endif
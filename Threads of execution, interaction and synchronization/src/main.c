@@ -2,7 +2,16 @@
 #include "message.h"
 #include "queue_sem.h"
 #include "queue_cond.h"
+#include "queue_mpmc.h"
+#include "queue_ring.h"
+#include "queue_shard.h"
+#include "queue_prio.h"
+#include "affinity.h"
 #include "thread_funcs.h"
+#include "bench.h"
+#include "msg_pool.h"
+#include "autosize.h"
+#include "spin_wait.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,8 +22,17 @@
 
 void show_status_sem();
 void show_status_cond();
+void show_status_mpmc();
+void show_status_ring();
+void show_status_shard();
+void show_status_prio();
 void request_resize_sem(char op);
 void request_resize_cond(char op);
+void request_resize_mpmc(char op);
+void request_resize_ring(char op);
+void request_resize_shard(char op);
+void request_resize_prio(char op);
+
 void run_lab_logic(
     void* (*producer_func)(void*),
     void* (*consumer_func)(void*),
@@ -24,11 +42,26 @@ void run_lab_logic(
     const char* lab_name);
 void signal_cleanup_sem();
 void signal_cleanup_cond();
+void signal_cleanup_mpmc();
+void signal_cleanup_ring();
+void signal_cleanup_shard();
+void signal_cleanup_prio();
 void clear_stdin_buffer();
+void show_autosize_status();
+void show_spin_status(spin_policy_t *produce, spin_policy_t *consume);
 
 
-int main() {
+int main(int argc, char *argv[]) {
     srand(time(NULL)); 
+    spin_configure(SPIN_AUTO);
+
+    // -t P:C - закрепить потоки лабораторных за ядрами; любые другие
+    // аргументы - режим замера.
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+        if (pin_parse(argv[2], &pin_config) != 0) return 1;
+    } else if (argc > 1) {
+        return run_benchmark(argc, argv);
+    }
 
     char choice;
     int run_main_loop = 1;
@@ -38,6 +71,10 @@ int main() {
         printf("\n--- Main Menu ---\n");
         printf("1: Run Lab. 5.1 (Semaphores)\n");
         printf("2: Run Lab. 5.2 (Cond. Variables)\n");
+        printf("3: Run Lab. 5.3 (Lock-free MPMC ring)\n");
+        printf("4: Run Lab. 5.4 (Inline byte ring)\n");
+        printf("5: Run Lab. 5.5 (Sharded queues, work stealing)\n");
+        printf("6: Run Lab. 5.6 (Priority lanes by message type)\n");
         printf("q: Exit\n");
         printf("Your choice: ");
 
@@ -49,9 +86,11 @@ int main() {
             case '1':
                 printf("\n--- starting lab 5.1 ---\n");
                 if (init_queue_sem(&queue, INITIAL_QUEUE_SIZE) == 0) {
+                    autosize_start(&autosize_ops_sem, &autosize_defaults);
                     run_lab_logic(producer_thread_sem, consumer_thread_sem,
                                   show_status_sem, request_resize_sem,
                                   signal_cleanup_sem, "semaphores");
+                    autosize_stop();
                     destroy_queue_sem(&queue);
                     printf("\n--- lab 5.1 complited ---\n");
                 } else {
@@ -63,9 +102,11 @@ int main() {
             case '2':
                 printf("\n--- starting lab 5.2 ---\n");
                 if (init_queue_cond(&queue_cond, INITIAL_QUEUE_SIZE) == 0) {
+                     autosize_start(&autosize_ops_cond, &autosize_defaults);
                      run_lab_logic(producer_thread_cond, consumer_thread_cond,
                                    show_status_cond, request_resize_cond,
                                    signal_cleanup_cond, "condition var");
+                     autosize_stop();
                     destroy_queue_cond(&queue_cond);
                      printf("\n--- lab 5.2 complited ---\n");
                 } else {
@@ -73,6 +114,58 @@ int main() {
                 }
                 break;
 
+            case '3':
+                printf("\n--- starting lab 5.3 ---\n");
+                if (init_queue_mpmc(&queue_mpmc, INITIAL_QUEUE_SIZE) == 0) {
+                    run_lab_logic(producer_thread_mpmc, consumer_thread_mpmc,
+                                  show_status_mpmc, request_resize_mpmc,
+                                  signal_cleanup_mpmc, "lock-free MPMC");
+                    destroy_queue_mpmc(&queue_mpmc);
+                    printf("\n--- lab 5.3 complited ---\n");
+                } else {
+                    fprintf(stderr, "Error initializing queue (MPMC)\n");
+                }
+                break;
+
+            case '4':
+                printf("\n--- starting lab 5.4 ---\n");
+                if (init_queue_ring(&queue_ring, INITIAL_QUEUE_SIZE) == 0) {
+                    run_lab_logic(producer_thread_ring, consumer_thread_ring,
+                                  show_status_ring, request_resize_ring,
+                                  signal_cleanup_ring, "inline ring");
+                    destroy_queue_ring(&queue_ring);
+                    printf("\n--- lab 5.4 complited ---\n");
+                } else {
+                    fprintf(stderr, "Error initializing queue (Ring)\n");
+                }
+                break;
+
+            case '5':
+                printf("\n--- starting lab 5.5 ---\n");
+                if (init_queue_shard(&queue_shard, INITIAL_QUEUE_SIZE, SHARD_ROUND_ROBIN) == 0) {
+                    run_lab_logic(producer_thread_shard, consumer_thread_shard,
+                                  show_status_shard, request_resize_shard,
+                                  signal_cleanup_shard, "sharded");
+                    destroy_queue_shard(&queue_shard);
+                    printf("\n--- lab 5.5 complited ---\n");
+                } else {
+                    fprintf(stderr, "Error initializing queue (Shard)\n");
+                }
+                break;
+
+            case '6':
+                printf("\n--- starting lab 5.6 ---\n");
+                if (init_queue_prio(&queue_prio, INITIAL_QUEUE_SIZE, PRIO_WEIGHTED, PRIO_AGING_MS) == 0) {
+                    run_lab_logic(producer_thread_prio, consumer_thread_prio,
+                                  show_status_prio, request_resize_prio,
+                                  signal_cleanup_prio, "priority lanes");
+                    destroy_queue_prio(&queue_prio);
+                    printf("\n--- lab 5.6 complited ---\n");
+                } else {
+                    fprintf(stderr, "Error initializing queue (Prio)\n");
+                }
+                break;
+
             case 'q':
                 printf("Exit: \n");
                 run_main_loop = 0; 
@@ -84,85 +177,228 @@ int main() {
         }
     }
 
+    msg_pool_destroy();
     return 0; 
 }
 
 void show_status_sem() {
-    pthread_mutex_lock(&queue.mutex); 
+    // Снимок без мьютекса очереди: печать в терминал не держит
+    // производителей и потребителей.
+    queue_snapshot_t st;
+    snapshot_queue_sem(&queue, &st);
     printf("\n--- STATUS (Semaphores) ---\n");
-    printf("Queue capacity: %d\n",queue.capacity);
-    printf("Elements occupied: %d\n",queue.count);
-    printf("Free slots: %d\n",queue.capacity -queue.count);
+    printf("Queue capacity: %d\n", st.capacity);
+    printf("Elements occupied: %d\n", st.count);
+    printf("Free slots: %d\n", st.capacity - st.count);
     int empty_val, filled_val;
     sem_getvalue(&queue.empty_slots, &empty_val);
     sem_getvalue(&queue.filled_slots, &filled_val);
     printf("Semaphore empty_slots:  %d\n", empty_val);
     printf("Semaphore filled_slots: %d\n", filled_val);
-    printf("Total added:    %ld\n", queue.total_added);
-    printf("Total extracted:    %ld\n", queue.total_extracted);
-    printf("Active producers: %d\n", producer_count);
-    printf("Active consumers:   %d\n", consumer_count);
-    printf("Resize request: %d (Target: %d)\n", queue.resize_request, queue.new_capacity_request);
+    printf("Total added:    %ld\n", st.total_added);
+    printf("Total extracted:    %ld\n", st.total_extracted);
+    printf("Producer waits: %ld\n", atomic_load(&queue.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue.empty_waits));
+    printf("Lock acquisitions: %ld (batch size %d)\n", st.lock_ops, (int)batch_size);
+    printf("Active producers: %d\n", atomic_load(&producer_count));
+    printf("Active consumers:   %d\n", atomic_load(&consumer_count));
+    printf("Slot debt: %d\n", st.slot_debt);
+    printf("Epoch: %lu (segments: %d)\n", st.epoch, st.segments);
+    show_spin_status(&queue.produce_spin, &queue.consume_spin);
+    show_autosize_status();
     printf("------------------------\n");
-    pthread_mutex_unlock(&queue.mutex);
 }
 
 void show_status_cond() {
-    pthread_mutex_lock(&queue_cond.mutex);
+    queue_snapshot_t st;
+    snapshot_queue_cond(&queue_cond, &st);
     printf("\n--- STATUS (Cond. Var.) ---\n");
-    printf("Queue capacity: %d\n", queue_cond.capacity);
-    printf("Elements occupied: %d\n", queue_cond.count);
-    printf("Free spaces: %d\n", queue_cond.capacity - queue_cond.count);
-    printf("Total added: %ld\n", queue_cond.total_added);
-    printf("Total extracted: %ld\n", queue_cond.total_extracted);
-    printf("Active producers: %d\n", producer_count);
-    printf("Active consumers: %d\n", consumer_count);
-    printf("Resize request: %d (Target: %d)\n", queue_cond.resize_request, queue_cond.new_capacity_request);
-        printf("Resize in progress: %d\n", queue_cond.resize_in_progress);
+    printf("Queue capacity: %d\n", st.capacity);
+    printf("Elements occupied: %d\n", st.count);
+    printf("Free spaces: %d\n", st.capacity - st.count);
+    printf("Total added: %ld\n", st.total_added);
+    printf("Total extracted: %ld\n", st.total_extracted);
+    printf("Producer waits: %ld\n", atomic_load(&queue_cond.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue_cond.empty_waits));
+    printf("Lock acquisitions: %ld (batch size %d)\n", st.lock_ops, (int)batch_size);
+    printf("Active producers: %d\n", atomic_load(&producer_count));
+    printf("Active consumers: %d\n", atomic_load(&consumer_count));
+    printf("Epoch: %lu (segments: %d)\n", st.epoch, st.segments);
+    show_spin_status(&queue_cond.produce_spin, &queue_cond.consume_spin);
+    show_autosize_status();
         printf("---------------------------------------\n");
-        pthread_mutex_unlock(&queue_cond.mutex);
+}
+
+void show_status_mpmc() {
+    size_t added = atomic_load(&queue_mpmc.enqueue_pos);
+    size_t extracted = atomic_load(&queue_mpmc.dequeue_pos);
+    int count = count_mpmc(&queue_mpmc);
+    printf("\n--- STATUS (MPMC) ---\n");
+    printf("Queue capacity: %d\n", queue_mpmc.capacity);
+    printf("Elements occupied: %d\n", count);
+    printf("Free slots: %d\n", queue_mpmc.capacity - count);
+    printf("Total added:    %zu\n", added);
+    printf("Total extracted:    %zu\n", extracted);
+    printf("Producer waits: %ld\n", atomic_load(&queue_mpmc.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue_mpmc.empty_waits));
+    printf("Active producers: %d\n", producer_count);
+    printf("Active consumers:   %d\n", consumer_count);
+    printf("------------------------\n");
+}
+
+void show_status_ring() {
+    pthread_mutex_lock(&queue_ring.mutex);
+    printf("\n--- STATUS (Inline ring) ---\n");
+    printf("Queue capacity: %d max-size messages (%zu bytes)\n", queue_ring.capacity, queue_ring.size);
+    printf("Elements occupied: %d\n", queue_ring.count);
+    printf("Bytes occupied: %zu\n", queue_ring.tail - queue_ring.head);
+    printf("Total added:    %ld\n", queue_ring.total_added);
+    printf("Total extracted:    %ld\n", queue_ring.total_extracted);
+    printf("Wrap markers:   %ld\n", queue_ring.wraps);
+    printf("Producer waits: %ld\n", atomic_load(&queue_ring.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue_ring.empty_waits));
+    printf("Active producers: %d\n", producer_count);
+    printf("Active consumers:   %d\n", consumer_count);
+    printf("------------------------\n");
+    pthread_mutex_unlock(&queue_ring.mutex);
+}
+
+void show_status_shard() {
+    shard_totals_t t;
+    shard_get_totals(&queue_shard, &t);
+    printf("\n--- STATUS (Sharded) ---\n");
+    printf("Queue capacity: %d (%d per shard, %d shards owned, %d orphaned)\n", t.capacity,
+           queue_shard.shard_capacity, t.owners, atomic_load(&queue_shard.orphaned));
+    printf("Elements occupied: %d\n", t.count);
+    printf("Total added:    %ld\n", t.total_added);
+    printf("Total extracted:    %ld (stolen: %ld in %ld steals)\n", t.total_extracted, t.stolen,
+           atomic_load(&queue_shard.steals));
+    printf("Producer waits: %ld\n", atomic_load(&queue_shard.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue_shard.empty_waits));
+    int limit = atomic_load(&queue_shard.shard_limit);
+    for (int i = 0; i < limit; ++i) {
+        // Строки шардов - без мьютексов: printf под мьютексом держал бы шард.
+        QueueShard *sh = &queue_shard.shards[i];
+        printf("  Shard %d%s: %d/%d, added %ld, extracted %ld, stolen %ld\n", i,
+               atomic_load(&sh->owner_active) ? "" : " (no owner)",
+               atomic_load(&sh->count_hint), queue_shard.shard_capacity, atomic_load(&sh->added),
+               atomic_load(&sh->extracted), atomic_load(&sh->stolen));
+    }
+    printf("Active producers: %d\n", producer_count);
+    printf("Active consumers:   %d\n", consumer_count);
+    printf("------------------------\n");
+}
+
+void show_status_prio() {
+    prio_stats_t st;
+    prio_get_stats(&queue_prio, &st);
+    printf("\n--- STATUS (Priority lanes) ---\n");
+    printf("Policy: %s, aging after %ld ms\n",
+           st.policy == PRIO_STRICT ? "strict" : "weighted", st.aging_ns / 1000000L);
+    printf("Elements occupied: %d\n", st.count);
+    printf("Producer waits: %ld\n", atomic_load(&queue_prio.full_waits));
+    printf("Consumer waits: %ld\n", atomic_load(&queue_prio.empty_waits));
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        prio_lane_stats_t *l = &st.lanes[i];
+        printf("  Lane %-6s (weight %d): %d/%d, added %ld, extracted %ld, aged %ld, "
+               "wait avg %.1f ms, max %.1f ms, head %.1f ms\n",
+               prio_lane_names[i], l->weight, l->count, l->capacity, l->added, l->extracted, l->aged,
+               l->wait_ns_avg / 1e6, l->wait_ns_max / 1e6, l->head_age_ns / 1e6);
+    }
+    printf("Active producers: %d\n", atomic_load(&producer_count));
+    printf("Active consumers:   %d\n", atomic_load(&consumer_count));
+    printf("------------------------\n");
+}
+
+void show_spin_status(spin_policy_t *produce, spin_policy_t *consume) {
+    printf("Spin waits: %s, producers %ld hits / %ld parks (budget %d), consumers %ld hits / %ld parks (budget %d)\n",
+           spin_enabled() ? "on" : "off",
+           atomic_load(&produce->hits), atomic_load(&produce->parks), spin_budget(produce),
+           atomic_load(&consume->hits), atomic_load(&consume->parks), spin_budget(consume));
+}
+
+void show_autosize_status() {
+    autosize_status_t st;
+    autosize_get_status(&st);
+    printf("Autosize: %s (%d..%d), grows: %ld, shrinks: %ld\n", autosize_enabled ? "on" : "off",
+           autosize_defaults.min_capacity, autosize_defaults.max_capacity, st.grows, st.shrinks);
+    printf("Rates: in %.1f msg/s, out %.1f msg/s\n", st.in_rate, st.out_rate);
+    printf("Last autosize decision: %s\n", st.last);
 }
 
 void request_resize_sem(char op) {
-    pthread_mutex_lock(&queue.mutex);
-    if (queue.resize_request == 0) {
-        int current_capacity = queue.capacity;
-        int target_size = (op == '+') ? current_capacity + 5 : current_capacity - 5;
-        if (target_size <= 0 && op == '-') {
-            printf("Cannot reduce size further (semaphores).\n");
-        } else {
-            queue.new_capacity_request = target_size;
-            queue.resize_request = (op == '+') ? 1 : -1;
-            printf("Request for %s queue to %d (semaphores).\n", 
-                (op == '+') ? "increase" : "decrease", target_size);
-        }
-    } else {
-        printf("Resize request already in queue (semaphores).\n");
+    queue_snapshot_t st;
+    snapshot_queue_sem(&queue, &st);
+    int target_size = (op == '+') ? st.capacity + 5 : st.capacity - 5;
+    if (target_size <= 0) {
+        printf("Cannot reduce size further (semaphores).\n");
+        return;
     }
-    pthread_mutex_unlock(&queue.mutex);
+    if (resize_queue_sem(&queue, target_size) != 0) {
+        printf("Resize failed (semaphores).\n");
+        return;
+    }
+    snapshot_queue_sem(&queue, &st);
+    printf("Queue resized to %d (semaphores), epoch %lu.\n", target_size, st.epoch);
 }
 
 void request_resize_cond(char op) {
-    pthread_mutex_lock(&queue_cond.mutex);
-    if (queue_cond.resize_request == 0 && !queue_cond.resize_in_progress) {
-        int current_capacity = queue_cond.capacity;
-        int target_size = (op == '+') ? current_capacity + 5 : current_capacity - 5;
-        if (target_size <= 0 && op == '-') {
-            printf("Main: Cannot reduce size further (condition var).\n");
-        } else {
-            queue_cond.new_capacity_request = target_size;
-            queue_cond.resize_request = (op == '+') ? 1 : -1;
-            printf("Main: Request for %s queue to %d (condition var).\n",
-                (op == '+') ? "increase" : "decrease", target_size);
-            pthread_cond_signal(&queue_cond.can_consume); 
-            if (op == '-') {
-                 pthread_cond_broadcast(&queue_cond.can_produce); 
-            }
-        }
-    } else {
-        printf("A resize request is already in progress or pending (condition var.).\n");
+    queue_snapshot_t st;
+    snapshot_queue_cond(&queue_cond, &st);
+    int target_size = (op == '+') ? st.capacity + 5 : st.capacity - 5;
+    if (target_size <= 0) {
+        printf("Main: Cannot reduce size further (condition var).\n");
+        return;
     }
-    pthread_mutex_unlock(&queue_cond.mutex);
+    if (resize_queue_cond(&queue_cond, target_size) != 0) {
+        printf("Main: Resize failed (condition var).\n");
+        return;
+    }
+    snapshot_queue_cond(&queue_cond, &st);
+    printf("Main: Queue resized to %d (condition var), epoch %lu.\n", target_size, st.epoch);
+}
+
+void request_resize_mpmc(char op) {
+    (void)op;
+    printf("Resize is not supported for the lock-free ring (capacity %d is fixed).\n", queue_mpmc.capacity);
+}
+
+void request_resize_ring(char op) {
+    (void)op;
+    printf("Resize is not supported for the inline ring (%zu bytes).\n", queue_ring.size);
+}
+
+void request_resize_shard(char op) {
+    (void)op;
+    printf("Resize is not supported for the sharded queue (%d per shard).\n", queue_shard.shard_capacity);
+}
+
+void request_resize_prio(char op) {
+    (void)op;
+    printf("Resize is not supported for priority lanes (%d per lane).\n", queue_prio.lanes[0].capacity);
+}
+
+// pthread_create с ядром из списка (если задан -t); 0 - успех, иначе errno.
+static int create_pinned(pthread_t *tid, const cpu_list_t *cpus, int index, void* (*func)(void*), void *arg) {
+    pthread_attr_t attr;
+    int rc = pthread_attr_init(&attr);
+    if (rc != 0) return errno = rc;
+    if (pin_attr_set(&attr, cpus, index) != 0) {
+        pthread_attr_destroy(&attr);
+        return errno = EINVAL;
+    }
+    rc = pthread_create(tid, &attr, func, arg);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) errno = rc;
+    return rc;
+}
+
+static const char *pin_note(const cpu_list_t *cpus, int index) {
+    static char note[32];
+    int cpu = pin_cpu_for(cpus, index);
+    if (cpu < 0) return "";
+    snprintf(note, sizeof(note), " on CPU %d", cpu);
+    return note;
 }
 
 void run_lab_logic(
@@ -191,6 +427,9 @@ void run_lab_logic(
     printf(" p: Add producer            c: Add consumer\n");
     printf(" P: Remove producer         C: Remove consumer\n");
     printf(" +: Increase queue by 5     -: Decrease queue by 5\n");
+    printf(" b: Batch size 1/4/16 (semaphores, condition var)\n");
+    printf(" a: Autosize on/off (semaphores, condition var)\n");
+    printf(" w: Weighted/strict priority (priority lanes)\n");
     printf(" s: Show status             q: Exit (%s)\n", lab_name);
 
     while (keep_running) {
@@ -205,11 +444,12 @@ void run_lab_logic(
                         thread_arg_t *arg = malloc(sizeof(thread_arg_t));
                         if (!arg) { perror("malloc thread arg failed"); next_producer_id--; break; }
                         arg->id = current_id; arg->seed = rand();
-                        if (pthread_create(&producer_threads[current_id], NULL, producer_func, arg) != 0) {
+                        if (create_pinned(&producer_threads[current_id], &pin_config.producers, current_id, producer_func, arg) != 0) {
                             perror("Error creating producer thread");
                             producer_active[current_id] = 0; next_producer_id--; free(arg);
                         } else {
-                             producer_count++; printf("Producer was created %d (%s)\n", current_id, lab_name);
+                             producer_count++; printf("Producer was created %d (%s)%s\n", current_id, lab_name,
+                                                      pin_note(&pin_config.producers, current_id));
                         }
                     } else printf("Max number of producers reached.\n");
                     break;
@@ -220,11 +460,12 @@ void run_lab_logic(
                         thread_arg_t *arg = malloc(sizeof(thread_arg_t));
                         if (!arg) { perror("malloc thread arg failed"); next_consumer_id--; break; }
                         arg->id = current_id; arg->seed = rand();
-                        if (pthread_create(&consumer_threads[current_id], NULL, consumer_func, arg) != 0) {
+                        if (create_pinned(&consumer_threads[current_id], &pin_config.consumers, current_id, consumer_func, arg) != 0) {
                              perror("Error creating consumer thread");
                              consumer_active[current_id] = 0; next_consumer_id--; free(arg);
                         } else {
-                             consumer_count++; printf("Consumer was created %d (%s)\n", current_id, lab_name);
+                             consumer_count++; printf("Consumer was created %d (%s)%s\n", current_id, lab_name,
+                                                      pin_note(&pin_config.consumers, current_id));
                          }
                      } else printf("Max number of consumers reached.\n");
                     break;
@@ -250,6 +491,33 @@ void run_lab_logic(
                     break;
                  case '+': request_resize_func('+'); break;
                  case '-': request_resize_func('-'); break;
+                 case 'b':
+                    batch_size = batch_size == 1 ? 4 : batch_size == 4 ? MAX_BATCH : 1;
+                    printf("Batch size: %d\n", (int)batch_size);
+                    break;
+                 case 'a': {
+                    autosize_status_t st;
+                    autosize_get_status(&st);
+                    if (!st.running) {
+                        printf("Autosize is not supported for %s.\n", lab_name);
+                        break;
+                    }
+                    autosize_enabled = !autosize_enabled;
+                    printf("Autosize: %s\n", autosize_enabled ? "on" : "off");
+                    break;
+                 }
+                 case 'w': {
+                    if (!queue_prio.ready) {
+                        printf("Priority policy is not used by %s.\n", lab_name);
+                        break;
+                    }
+                    prio_stats_t st;
+                    prio_get_stats(&queue_prio, &st);
+                    prio_policy_t next = st.policy == PRIO_STRICT ? PRIO_WEIGHTED : PRIO_STRICT;
+                    prio_set_policy(&queue_prio, next);
+                    printf("Priority policy: %s\n", next == PRIO_STRICT ? "strict" : "weighted");
+                    break;
+                 }
                  case 's': show_status_func(); break;
                  case 'q':
                     printf("Main: Shutdown (%s)...\n", lab_name);
@@ -281,6 +549,9 @@ void run_lab_logic(
 }
 
 void signal_cleanup_sem() {
+    // Пока очередь работает, лишние токены сломали бы учёт слотов; снятый
+    // поток сам заметит флаг по таймауту sem_clockwait (1 с).
+    if (keep_running) return;
     pthread_mutex_lock(&queue.mutex);
     int cap = queue.capacity;
     pthread_mutex_unlock(&queue.mutex);
@@ -298,6 +569,37 @@ void signal_cleanup_cond() {
     pthread_mutex_unlock(&queue_cond.mutex);
 }
 
+void signal_cleanup_mpmc() {
+    // Потоки MPMC не блокируются: пустое/полное кольцо они пережидают в
+    // коротком nanosleep и сами замечают снятие флагов.
+}
+
+void signal_cleanup_ring() {
+    pthread_mutex_lock(&queue_ring.mutex);
+    pthread_cond_broadcast(&queue_ring.can_reserve);
+    pthread_cond_broadcast(&queue_ring.can_read);
+    pthread_mutex_unlock(&queue_ring.mutex);
+}
+
+void signal_cleanup_shard() {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        QueueShard *sh = &queue_shard.shards[i];
+        pthread_mutex_lock(&sh->mutex);
+        pthread_cond_broadcast(&sh->can_produce);
+        pthread_cond_broadcast(&sh->can_consume);
+        pthread_mutex_unlock(&sh->mutex);
+    }
+}
+
+void signal_cleanup_prio() {
+    pthread_mutex_lock(&queue_prio.mutex);
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        pthread_cond_broadcast(&queue_prio.lanes[i].can_produce);
+    }
+    pthread_cond_broadcast(&queue_prio.can_consume);
+    pthread_mutex_unlock(&queue_prio.mutex);
+}
+
 void clear_stdin_buffer() {
     int c;
     while ((c = getchar()) != '\n' && c != EOF);
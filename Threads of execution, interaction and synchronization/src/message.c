@@ -1,4 +1,5 @@
 #include "message.h"
+#include "msg_pool.h"
 #include "utils.h"
 #include <stdio.h>
 #include <string.h>
@@ -13,20 +14,27 @@ uint16_t calculate_hash(const Message *msg) {
         return 0;
     }
 
-    size_t data_len = msg->size + 1; 
-    size_t padded_data_size = PADDED_DATA_SIZE(msg->size); 
-
-    hash_val ^= msg->type;
-    hash_val ^= msg->size;
+    // Длина данных size + 1 не больше PADDED_DATA_SIZE(size) по построению,
+    // поэтому проверка границ на каждом байте не нужна. XOR не зависит от
+    // порядка: данные сворачиваются словами по 8 байт, слово - в байт,
+    // остаток добирается побайтово. Результат тот же, что у побайтового XOR.
+    size_t data_len = msg->size + 1;
+    uint64_t acc = 0;
+    size_t i = 0;
+    for (; i + sizeof(acc) <= data_len; i += sizeof(acc)) {
+        uint64_t word;
+        memcpy(&word, msg->data + i, sizeof(word));
+        acc ^= word;
+    }
+    acc ^= acc >> 32;
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
 
-    for (size_t i = 0; i < data_len; ++i) {
-       if (i >= padded_data_size) {
-             fprintf(stderr, "CRITICAL ERROR in calculate_hash: Read index %zu out of bounds (max allowed index %zu) for msg->size %u\n",
-                     i, padded_data_size - 1, msg->size);
-             return 0xFFFF;
-         }
-         hash_val ^= msg->data[i];
+    uint8_t folded = (uint8_t)acc ^ msg->type ^ msg->size;
+    for (; i < data_len; ++i) {
+        folded ^= msg->data[i];
     }
+    hash_val = folded;
 
     hash_val = (hash_val << 8) | (hash_val >> 8);
     return hash_val;
@@ -34,15 +42,27 @@ uint16_t calculate_hash(const Message *msg) {
 
 Message* create_message(unsigned int *seed) {
     uint8_t data_size_field = rand_r(seed) % (MAX_DATA_SIZE + 1); 
-    size_t alloc_size = TOTAL_MESSAGE_SIZE(data_size_field)+1;
-    size_t padded_data_size = PADDED_DATA_SIZE(data_size_field); 
+    return create_message_sized(seed, data_size_field);
+}
 
-    Message *msg = (Message *)malloc(alloc_size);
+Message* create_message_sized(unsigned int *seed, uint8_t data_size_field) {
+    Message *msg = msg_pool_enabled ? (Message *)msg_pool_alloc(data_size_field)
+                                    : (Message *)malloc(MESSAGE_ALLOC_SIZE(data_size_field));
     if (!msg) {
         perror("Failed to allocate message");
         return NULL;
     }
 
+    if (fill_message(msg, seed, data_size_field) != 0) {
+        destroy_message(msg);
+        return NULL;
+    }
+    return msg;
+}
+
+int fill_message(Message *msg, unsigned int *seed, uint8_t data_size_field) {
+    size_t padded_data_size = PADDED_DATA_SIZE(data_size_field); 
+
     msg->type = rand_r(seed) % 256;
     msg->size = data_size_field;
     msg->hash = 0;
@@ -53,8 +73,7 @@ Message* create_message(unsigned int *seed) {
         if (i >= padded_data_size) {
              fprintf(stderr, "CRITICAL ERROR in create_message: Write index %zu out of bounds (max allowed index %zu) for size_field %u\n",
                      i, padded_data_size - 1, data_size_field);
-             free(msg);
-             return NULL;
+             return -1;
          }
         msg->data[i] = rand_r(seed) % 256;
     }
@@ -66,11 +85,15 @@ Message* create_message(unsigned int *seed) {
 
     msg->hash = calculate_hash(msg);
 
-    return msg;
+    return 0;
 }
 
 void destroy_message(Message *msg) {
     if (msg) {
-        free(msg);
+        if (msg_pool_enabled) {
+            msg_pool_free(msg);
+        } else {
+            free(msg);
+        }
     }
 }
\ No newline at end of file
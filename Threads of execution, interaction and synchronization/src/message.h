@@ -14,9 +14,17 @@ typedef struct {
 #define MESSAGE_HEADER_SIZE (sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint8_t))
 #define PADDED_DATA_SIZE(s) ((((s) + 1) + 3) & ~3)
 #define TOTAL_MESSAGE_SIZE(s) (MESSAGE_HEADER_SIZE + PADDED_DATA_SIZE(s))
+// Память под сообщение: data начинается со смещения offsetof(Message, data),
+// на байт дальше MESSAGE_HEADER_SIZE.
+#define MESSAGE_ALLOC_SIZE(s) (TOTAL_MESSAGE_SIZE(s) + 1)
 
 uint16_t calculate_hash(const Message *msg);
 Message* create_message(unsigned int *seed);
+// Как create_message, но с заданным полем size (длина данных - size + 1).
+Message* create_message_sized(unsigned int *seed, uint8_t size_field);
+// Заполняет уже выделенные MESSAGE_ALLOC_SIZE(size_field) байт: тип, данные,
+// нулевое выравнивание и хеш. 0 - успех.
+int fill_message(Message *msg, unsigned int *seed, uint8_t size_field);
 void destroy_message(Message *msg);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "msg_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct magazine {
+    struct magazine *next;
+    int count;
+    void *items[MSG_POOL_MAGAZINE];
+} magazine_t;
+
+typedef struct slab {
+    struct slab *next;
+    long pad;               // объекты начинаются с границы 16 байт
+} slab_t;
+
+// Склад размерного класса: полные и пустые магазины и нарезаемый слэб.
+typedef struct {
+    pthread_mutex_t mutex;
+    magazine_t *full;
+    magazine_t *empty;
+    slab_t *slabs;
+    char *slab_pos;
+    size_t slab_left;
+} depot_t;
+
+// Кэш потока: по два магазина на класс (loaded и previous), чтобы поток,
+// чередующий выделение и освобождение на границе магазина, не ходил на склад.
+typedef struct {
+    magazine_t *loaded[MSG_POOL_CLASSES];
+    magazine_t *previous[MSG_POOL_CLASSES];
+} thread_cache_t;
+
+int msg_pool_enabled = 1;
+
+static depot_t depots[MSG_POOL_CLASSES];
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static _Thread_local thread_cache_t *tls_cache;
+
+static atomic_long stat_slabs;
+static atomic_long stat_depot_gets;
+static atomic_long stat_depot_puts;
+
+static int size_class(uint8_t size_field) {
+    return PADDED_DATA_SIZE(size_field) / 4 - 1;
+}
+
+// Размер блока: столько же, сколько create_message просит у malloc.
+static size_t class_stride(int cls) {
+    size_t size = MESSAGE_ALLOC_SIZE((size_t)cls * 4);
+    return (size + 7) & ~(size_t)7;
+}
+
+static void cache_flush(thread_cache_t *cache) {
+    for (int c = 0; c < MSG_POOL_CLASSES; ++c) {
+        magazine_t *mags[2] = {cache->loaded[c], cache->previous[c]};
+        if (!mags[0] && !mags[1]) continue;
+        depot_t *d = &depots[c];
+        pthread_mutex_lock(&d->mutex);
+        for (int i = 0; i < 2; ++i) {
+            magazine_t *m = mags[i];
+            if (!m) continue;
+            if (m->count > 0) {
+                m->next = d->full;
+                d->full = m;
+            } else {
+                m->next = d->empty;
+                d->empty = m;
+            }
+        }
+        pthread_mutex_unlock(&d->mutex);
+        cache->loaded[c] = NULL;
+        cache->previous[c] = NULL;
+    }
+}
+
+static void cache_destructor(void *arg) {
+    thread_cache_t *cache = arg;
+    cache_flush(cache);
+    free(cache);
+}
+
+static void pool_init(void) {
+    for (int c = 0; c < MSG_POOL_CLASSES; ++c) {
+        pthread_mutex_init(&depots[c].mutex, NULL);
+    }
+    if (pthread_key_create(&cache_key, cache_destructor) != 0) {
+        perror("msg_pool: pthread_key_create");
+    }
+}
+
+static thread_cache_t *get_cache(void) {
+    if (tls_cache) return tls_cache;
+    pthread_once(&pool_once, pool_init);
+    tls_cache = calloc(1, sizeof(thread_cache_t));
+    if (tls_cache) pthread_setspecific(cache_key, tls_cache);
+    return tls_cache;
+}
+
+static magazine_t *depot_take_empty(depot_t *d) {
+    magazine_t *m = d->empty;
+    if (m) {
+        d->empty = m->next;
+    } else {
+        m = malloc(sizeof(magazine_t));
+    }
+    if (m) {
+        m->next = NULL;
+        m->count = 0;
+    }
+    return m;
+}
+
+// Полный магазин со склада, а если их нет - нарезанный из слэба.
+static magazine_t *depot_take_full(depot_t *d, int cls) {
+    magazine_t *m = d->full;
+    if (m) {
+        d->full = m->next;
+        m->next = NULL;
+        atomic_fetch_add_explicit(&stat_depot_gets, 1, memory_order_relaxed);
+        return m;
+    }
+
+    m = depot_take_empty(d);
+    if (!m) return NULL;
+    size_t stride = class_stride(cls);
+    while (m->count < MSG_POOL_MAGAZINE) {
+        if (d->slab_left < stride) {
+            slab_t *slab = malloc(MSG_POOL_SLAB_BYTES);
+            if (!slab) break;
+            slab->next = d->slabs;
+            d->slabs = slab;
+            d->slab_pos = (char *)(slab + 1);
+            d->slab_left = MSG_POOL_SLAB_BYTES - sizeof(slab_t);
+            atomic_fetch_add_explicit(&stat_slabs, 1, memory_order_relaxed);
+        }
+        m->items[m->count++] = d->slab_pos;
+        d->slab_pos += stride;
+        d->slab_left -= stride;
+    }
+    if (m->count == 0) {
+        m->next = d->empty;
+        d->empty = m;
+        return NULL;
+    }
+    return m;
+}
+
+void *msg_pool_alloc(uint8_t size_field) {
+    thread_cache_t *cache = get_cache();
+    if (!cache) return NULL;
+    int c = size_class(size_field);
+
+    magazine_t *m = cache->loaded[c];
+    if (m && m->count > 0) return m->items[--m->count];
+
+    magazine_t *prev = cache->previous[c];
+    if (prev && prev->count > 0) {
+        cache->previous[c] = m;
+        cache->loaded[c] = prev;
+        return prev->items[--prev->count];
+    }
+
+    depot_t *d = &depots[c];
+    pthread_mutex_lock(&d->mutex);
+    magazine_t *full = depot_take_full(d, c);
+    if (full && m) {
+        m->next = d->empty;
+        d->empty = m;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    if (!full) return NULL;
+
+    cache->loaded[c] = full;
+    return full->items[--full->count];
+}
+
+void msg_pool_free(Message *msg) {
+    thread_cache_t *cache = get_cache();
+    if (!cache) {
+        fprintf(stderr, "msg_pool: no thread cache, leaking message\n");
+        return;
+    }
+    int c = size_class(msg->size);
+
+    magazine_t *m = cache->loaded[c];
+    if (m && m->count < MSG_POOL_MAGAZINE) {
+        m->items[m->count++] = msg;
+        return;
+    }
+
+    magazine_t *prev = cache->previous[c];
+    if (m && prev && prev->count == 0) {
+        cache->previous[c] = m;
+        cache->loaded[c] = prev;
+        prev->items[prev->count++] = msg;
+        return;
+    }
+
+    // Оба магазина полны (или их ещё нет): previous пачкой уходит на склад,
+    // loaded становится previous, в loaded - пустой магазин со склада.
+    depot_t *d = &depots[c];
+    pthread_mutex_lock(&d->mutex);
+    if (prev && prev->count > 0) {
+        prev->next = d->full;
+        d->full = prev;
+        atomic_fetch_add_explicit(&stat_depot_puts, 1, memory_order_relaxed);
+    } else if (prev) {
+        prev->next = d->empty;
+        d->empty = prev;
+    }
+    magazine_t *empty = depot_take_empty(d);
+    pthread_mutex_unlock(&d->mutex);
+    if (!empty) {
+        fprintf(stderr, "msg_pool: failed to allocate magazine, leaking message\n");
+        cache->previous[c] = m;
+        cache->loaded[c] = NULL;
+        return;
+    }
+
+    cache->previous[c] = m;
+    cache->loaded[c] = empty;
+    empty->items[empty->count++] = msg;
+}
+
+void msg_pool_get_stats(msg_pool_stats_t *st) {
+    st->slabs = atomic_load(&stat_slabs);
+    st->depot_gets = atomic_load(&stat_depot_gets);
+    st->depot_puts = atomic_load(&stat_depot_puts);
+}
+
+void msg_pool_destroy(void) {
+    pthread_once(&pool_once, pool_init);
+    if (tls_cache) {
+        cache_flush(tls_cache);
+        free(tls_cache);
+        tls_cache = NULL;
+        pthread_setspecific(cache_key, NULL);
+    }
+
+    for (int c = 0; c < MSG_POOL_CLASSES; ++c) {
+        depot_t *d = &depots[c];
+        pthread_mutex_lock(&d->mutex);
+        magazine_t *lists[2] = {d->full, d->empty};
+        for (int i = 0; i < 2; ++i) {
+            while (lists[i]) {
+                magazine_t *next = lists[i]->next;
+                free(lists[i]);
+                lists[i] = next;
+            }
+        }
+        while (d->slabs) {
+            slab_t *next = d->slabs->next;
+            free(d->slabs);
+            d->slabs = next;
+        }
+        d->full = NULL;
+        d->empty = NULL;
+        d->slab_pos = NULL;
+        d->slab_left = 0;
+        pthread_mutex_unlock(&d->mutex);
+    }
+    atomic_store(&stat_slabs, 0);
+    atomic_store(&stat_depot_gets, 0);
+    atomic_store(&stat_depot_puts, 0);
+}
@@ -0,0 +1,34 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include "message.h"
+#include "utils.h"
+#include <stddef.h>
+
+// Пул памяти для Message: размерные классы по PADDED_DATA_SIZE (шаг 4 байта,
+// 64 класса), у каждого потока свои магазины свободных блоков. Освобождение
+// на чужом потоке (потребитель освобождает то, что выделил производитель)
+// идёт в магазин освобождающего потока; заполненный магазин целиком, одним
+// захватом мьютекса, уходит в общий склад класса, откуда его забирают
+// выделяющие потоки. Новые блоки нарезаются из слэбов по 64 КБ.
+#define MSG_POOL_CLASSES (PADDED_DATA_SIZE(MAX_DATA_SIZE) / 4)
+#define MSG_POOL_MAGAZINE 32
+#define MSG_POOL_SLAB_BYTES (64 * 1024)
+
+typedef struct {
+    long slabs;             // выделено слэбов
+    long depot_gets;        // магазинов взято со склада
+    long depot_puts;        // магазинов сдано на склад
+} msg_pool_stats_t;
+
+// 0 - create_message/destroy_message используют malloc/free.
+// Переключать только пока нет живых сообщений.
+extern int msg_pool_enabled;
+
+void *msg_pool_alloc(uint8_t size_field);
+void msg_pool_free(Message *msg);
+void msg_pool_get_stats(msg_pool_stats_t *st);
+// Возвращает все слэбы системе; вызывать, когда потоки завершены.
+void msg_pool_destroy(void);
+
+#endif
@@ -7,87 +7,191 @@
 
 CircularQueue_Cond queue_cond;
 
+// Под мьютексом, перед каждым его освобождением после изменения счётчиков:
+// подсказки для кручения и снимок для show_status_cond.
+static void publish_cond(CircularQueue_Cond *q) {
+    atomic_store_explicit(&q->count_hint, q->count, memory_order_relaxed);
+    atomic_store_explicit(&q->room_hint, q->capacity - q->count, memory_order_relaxed);
+    queue_snapshot_t s = {
+        .capacity = q->capacity, .count = q->count,
+        .total_added = q->total_added, .total_extracted = q->total_extracted,
+        .lock_ops = q->lock_ops, .epoch = q->ring.epoch, .segments = q->ring.segments,
+    };
+    queue_stats_publish(&q->stats, &s);
+}
+
+void snapshot_queue_cond(CircularQueue_Cond *q, queue_snapshot_t *s) {
+    queue_stats_read(&q->stats, s);
+}
+
+static int has_room_cond(void *arg) {
+    CircularQueue_Cond *q = arg;
+    return atomic_load_explicit(&q->room_hint, memory_order_relaxed) > 0;
+}
+
+static int has_messages_cond(void *arg) {
+    CircularQueue_Cond *q = arg;
+    return atomic_load_explicit(&q->count_hint, memory_order_relaxed) > 0;
+}
+
 int init_queue_cond(CircularQueue_Cond *q, int size) {
-    q->buffer = (Message **)malloc(size * sizeof(Message *));
-    if (!q->buffer) {
+    if (segment_chain_init(&q->ring, size) != 0) {
         perror("Failed to allocate queue buffer (Cond Var)");
         return -1;
     }
 
     q->capacity = size;
-    q->head = 0;
-    q->tail = 0;
     q->count = 0;
     q->total_added = 0;
     q->total_extracted = 0;
-    q->resize_request = 0;
-    q->new_capacity_request = 0;
-    q->resize_in_progress = 0; 
+    q->lock_ops = 0;
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+    atomic_init(&q->count_hint, 0);
+    atomic_init(&q->room_hint, size);
+    spin_policy_init(&q->produce_spin);
+    spin_policy_init(&q->consume_spin);
+    queue_stats_init(&q->stats);
+    publish_cond(q);
 
     if (pthread_mutex_init(&q->mutex, NULL) != 0) {
         perror("Mutex initialization failed (Cond Var)");
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
-    if (pthread_cond_init(&q->can_produce, NULL) != 0) {
+    if (init_cond_monotonic(&q->can_produce) != 0) {
         perror("Condition variable can_produce initialization failed");
         pthread_mutex_destroy(&q->mutex);
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
-    if (pthread_cond_init(&q->can_consume, NULL) != 0) {
+    if (init_cond_monotonic(&q->can_consume) != 0) {
         perror("Condition variable can_consume initialization failed");
         pthread_cond_destroy(&q->can_produce);
         pthread_mutex_destroy(&q->mutex);
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
     return 0;
 }
 
-int resize_queue_internal_cond(CircularQueue_Cond *q, int new_capacity) {
-     if (new_capacity <= 0) {
+int resize_queue_cond(CircularQueue_Cond *q, int new_capacity) {
+    if (new_capacity <= 0) {
         fprintf(stderr, "Resize Error: Invalid new capacity %d (Cond Var)\n", new_capacity);
         return -1;
     }
+    QueueSegment *seg = segment_create(new_capacity);
+    if (!seg) {
+        fprintf(stderr, "Resize Error: Failed to allocate new buffer of size %d (Cond Var)\n", new_capacity);
+        return -1;
+    }
 
-     if (new_capacity < q->count) {
-          fprintf(stderr, "Resize Error: New capacity %d < current count %d. Cannot shrink (Cond Var).\n", new_capacity, q->count);
-          return -1;
-     }
-
-     q->resize_in_progress = 1; 
-     printf("Resizing queue (Cond Var) from %d to %d (Count: %d)...\n", q->capacity, new_capacity, q->count);
+    QueueSegment *retired = NULL;
+    pthread_mutex_lock(&q->mutex);
+    int old_capacity = q->capacity;
+    if (new_capacity == old_capacity) {
+        pthread_mutex_unlock(&q->mutex);
+        free(seg);
+        return 0;
+    }
+    segment_chain_append(&q->ring, seg, &retired);
+    q->capacity = new_capacity;
+    publish_cond(q);
+    if (new_capacity > old_capacity) {
+        pthread_cond_broadcast(&q->can_produce);
+    }
+    pthread_mutex_unlock(&q->mutex);
 
-     Message **new_buffer = (Message **)malloc(new_capacity * sizeof(Message *));
-     if (!new_buffer) {
-          fprintf(stderr, "Resize Error: Failed to allocate new buffer of size %d (Cond Var)\n", new_capacity);
-          q->resize_in_progress = 0; 
-          return -1;
-     }
+    segments_free(retired);
+    return 0;
+}
 
-     int current_index = q->head;
-     for (int i = 0; i < q->count; ++i) {
-         new_buffer[i] = q->buffer[current_index];
-         current_index = (current_index + 1) % q->capacity;
-     }
+int enqueue_batch_cond(CircularQueue_Cond *q, Message **msgs, int n, const struct timespec *deadline) {
+    int rc = QUEUE_OK;
+    spin_wait(&q->produce_spin, has_room_cond, q);
+    pthread_mutex_lock(&q->mutex);
+    q->lock_ops++;
+    if (q->count >= q->capacity) {
+        atomic_fetch_add_explicit(&q->full_waits, 1, memory_order_relaxed);
+    }
+    while (q->count >= q->capacity && keep_running) {
+        rc = cond_wait_deadline(&q->can_produce, &q->mutex, deadline);
+        if (rc != QUEUE_OK) break;
+    }
+    if (q->count >= q->capacity) {
+        publish_cond(q);
+        pthread_mutex_unlock(&q->mutex);
+        return rc != QUEUE_OK ? rc : QUEUE_TIMEOUT;
+    }
 
-     free(q->buffer); 
+    int k = q->capacity - q->count;
+    if (k > n) k = n;
+    for (int i = 0; i < k; ++i) {
+        segment_chain_push(&q->ring, msgs[i]);
+    }
+    q->count += k;
+    q->total_added += k;
+    publish_cond(q);
+
+    if (k > 1) {
+        pthread_cond_broadcast(&q->can_consume);
+    } else {
+        pthread_cond_signal(&q->can_consume);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return k;
+}
 
-     q->buffer = new_buffer;
-     q->head = 0;
-     q->tail = q->count;
-     q->capacity = new_capacity;
+int dequeue_batch_cond(CircularQueue_Cond *q, Message **msgs, int n, const struct timespec *deadline) {
+    int rc = QUEUE_OK;
+    QueueSegment *retired = NULL;
+    spin_wait(&q->consume_spin, has_messages_cond, q);
+    pthread_mutex_lock(&q->mutex);
+    q->lock_ops++;
+    if (q->count == 0) {
+        atomic_fetch_add_explicit(&q->empty_waits, 1, memory_order_relaxed);
+    }
+    while (q->count == 0 && keep_running) {
+        rc = cond_wait_deadline(&q->can_consume, &q->mutex, deadline);
+        if (rc != QUEUE_OK) break;
+    }
+    if (q->count == 0) {
+        publish_cond(q);
+        pthread_mutex_unlock(&q->mutex);
+        return rc != QUEUE_OK ? rc : QUEUE_TIMEOUT;
+    }
 
-     printf("Resize complete (Cond Var). New capacity: %d, Count: %d\n", q->capacity, q->count);
-     q->resize_in_progress = 0; 
+    int k = q->count < n ? q->count : n;
+    for (int i = 0; i < k; ++i) {
+        msgs[i] = segment_chain_pop(&q->ring, &retired);
+    }
+    q->count -= k;
+    q->total_extracted += k;
+    publish_cond(q);
+
+    // После уменьшения ниже count место появится не сразу - будить некого.
+    if (q->count < q->capacity) {
+        if (k > 1) {
+            pthread_cond_broadcast(&q->can_produce);
+        } else {
+            pthread_cond_signal(&q->can_produce);
+        }
+    }
+    pthread_mutex_unlock(&q->mutex);
 
-     pthread_cond_broadcast(&q->can_produce);
-     pthread_cond_broadcast(&q->can_consume);
+    segments_free(retired);
+    return k;
+}
 
-     return 0; 
+int enqueue_cond(CircularQueue_Cond *q, Message *msg, const struct timespec *deadline) {
+    int rc = enqueue_batch_cond(q, &msg, 1, deadline);
+    return rc == 1 ? QUEUE_OK : rc;
 }
 
+int dequeue_cond(CircularQueue_Cond *q, Message **msg, const struct timespec *deadline) {
+    int rc = dequeue_batch_cond(q, msg, 1, deadline);
+    return rc == 1 ? QUEUE_OK : rc;
+}
 
 void destroy_queue_cond(CircularQueue_Cond *q) {
     if (pthread_mutex_lock(&q->mutex) != 0) {
@@ -96,24 +200,10 @@ void destroy_queue_cond(CircularQueue_Cond *q) {
 
     printf("Destroying queue (Cond Var)...\n");
 
-    while (q->count > 0) {
-        Message *msg = q->buffer[q->head];
-        q->head = (q->head + 1) % q->capacity;
-        q->count--;
-        if (msg) {
-            destroy_message(msg);
-        }
-    }
-
-    free(q->buffer);
-    q->buffer = NULL;
+    segment_chain_destroy(&q->ring);
     q->capacity = 0;
     q->count = 0;
-    q->head = 0;
-    q->tail = 0;
-
-    q->resize_request = 0;
-    q->resize_in_progress = 1; 
+    publish_cond(q);
 
     keep_running = 0; 
     pthread_cond_broadcast(&q->can_produce);
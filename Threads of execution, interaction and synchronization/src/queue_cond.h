@@ -3,26 +3,39 @@
 
 #include "message.h"
 #include "utils.h"
+#include "queue_segment.h"
+#include "spin_wait.h"
+#include "queue_stats.h"
 #include <pthread.h> 
+#include <stdatomic.h>
 
 typedef struct {
-    Message **buffer;       
+    // Всё, что меняется под мьютексом, лежит рядом с ним; head и tail
+    // под одним мьютексом не разделить (см. queue_sem.h).
+    pthread_mutex_t mutex;      
+    SegmentChain ring;      // сегменты по эпохам, см. queue_segment.h
     int capacity;          
-    int head;           
-    int tail;             
     int count;             
 
     long total_added;       
     long total_extracted; 
+    long lock_ops;          // захватов мьютекса операциями постановки/извлечения
 
-    pthread_mutex_t mutex;      
-    pthread_cond_t can_produce;  
-    pthread_cond_t can_consume;  
+    // На can_produce спят производители, на can_consume - потребители.
+    _Alignas(CACHE_LINE) pthread_cond_t can_produce;  
+    _Alignas(CACHE_LINE) pthread_cond_t can_consume;  
 
-    volatile sig_atomic_t resize_request;
-    int new_capacity_request;
-    volatile sig_atomic_t resize_in_progress; 
+    // Копии count и capacity - count, обновляемые под мьютексом: по ним
+    // ожидающие крутятся, не захватывая мьютекс. Каждая подсказка - на
+    // строке своей стороны, вместе с её счётчиками, а не на строке мьютекса.
+    _Alignas(CACHE_LINE) atomic_int room_hint;
+    atomic_long full_waits;   // производитель уснул на can_produce
+    spin_policy_t produce_spin;
+    _Alignas(CACHE_LINE) atomic_int count_hint;
+    atomic_long empty_waits;  // потребитель уснул на can_consume
+    spin_policy_t consume_spin;
 
+    queue_stats_t stats;      // копия счётчиков для чтения без мьютекса
 } CircularQueue_Cond;
 
 extern CircularQueue_Cond queue_cond;
@@ -31,6 +44,22 @@ int init_queue_cond(CircularQueue_Cond *q, int size);
 
 void destroy_queue_cond(CircularQueue_Cond *q);
 
-int resize_queue_internal_cond(CircularQueue_Cond *q, int new_capacity);
+// Меняет ёмкость сразу, из любого потока, без копирования сообщений.
+// После уменьшения ниже count производители ждут, пока очередь не
+// опустеет до новой ёмкости. 0 - успех.
+int resize_queue_cond(CircularQueue_Cond *q, int new_capacity);
+
+// deadline - абсолютное время CLOCK_MONOTONIC, NULL - ждать без ограничения.
+// Перед сном поток крутится на count_hint/room_hint (spin_wait.h).
+// Ожидание прерывается и при keep_running == 0.
+// Возвращают QUEUE_OK / QUEUE_TIMEOUT / QUEUE_ERROR.
+int enqueue_cond(CircularQueue_Cond *q, Message *msg, const struct timespec *deadline);
+int dequeue_cond(CircularQueue_Cond *q, Message **msg, const struct timespec *deadline);
+// Пакетные варианты: до n сообщений за один захват мьютекса. Возвращают
+// число перемещённых сообщений либо QUEUE_TIMEOUT / QUEUE_ERROR.
+int enqueue_batch_cond(CircularQueue_Cond *q, Message **msgs, int n, const struct timespec *deadline);
+int dequeue_batch_cond(CircularQueue_Cond *q, Message **msgs, int n, const struct timespec *deadline);
+// Снимок счётчиков без захвата мьютекса, из любого потока.
+void snapshot_queue_cond(CircularQueue_Cond *q, queue_snapshot_t *s);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "queue_mpmc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+CircularQueue_Mpmc queue_mpmc;
+
+int init_queue_mpmc(CircularQueue_Mpmc *q, int size) {
+    if (size <= 0) {
+        fprintf(stderr, "Invalid queue size %d (MPMC)\n", size);
+        return -1;
+    }
+
+    int capacity = 1;
+    while (capacity < size) capacity <<= 1;
+    if (capacity != size) {
+        printf("MPMC queue capacity rounded up from %d to %d (power of two).\n", size, capacity);
+    }
+
+    q->buffer = (MpmcCell *)malloc(capacity * sizeof(MpmcCell));
+    if (!q->buffer) {
+        perror("Failed to allocate queue buffer (MPMC)");
+        return -1;
+    }
+    for (int i = 0; i < capacity; ++i) {
+        atomic_init(&q->buffer[i].sequence, (size_t)i);
+        q->buffer[i].msg = NULL;
+    }
+
+    q->capacity = capacity;
+    q->mask = (size_t)capacity - 1;
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+    return 0;
+}
+
+int enqueue_mpmc(CircularQueue_Mpmc *q, Message *msg) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        MpmcCell *cell = &q->buffer[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            // Ячейка свободна на этом круге - пытаемся занять позицию.
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->msg = msg;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (dif < 0) {
+            return -1;  // потребитель ещё не освободил ячейку: очередь полна
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+int dequeue_mpmc(CircularQueue_Mpmc *q, Message **msg) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        MpmcCell *cell = &q->buffer[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *msg = cell->msg;
+                // Освобождаем ячейку для производителя следующего круга.
+                atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+                return 0;
+            }
+        } else if (dif < 0) {
+            return -1;  // производитель ещё не записал ячейку: очередь пуста
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+int count_mpmc(CircularQueue_Mpmc *q) {
+    size_t deq = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    size_t enq = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    intptr_t n = (intptr_t)(enq - deq);
+    if (n < 0) return 0;
+    if (n > q->capacity) return q->capacity;
+    return (int)n;
+}
+
+void destroy_queue_mpmc(CircularQueue_Mpmc *q) {
+    printf("Destroying queue (MPMC)...\n");
+
+    Message *msg;
+    while (dequeue_mpmc(q, &msg) == 0) {
+        if (msg) {
+            destroy_message(msg);
+        }
+    }
+
+    free(q->buffer);
+    q->buffer = NULL;
+    q->capacity = 0;
+    q->mask = 0;
+
+    printf("Queue (MPMC) destroyed.\n");
+}
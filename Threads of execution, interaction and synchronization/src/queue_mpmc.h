@@ -0,0 +1,41 @@
+#ifndef QUEUE_MPMC_H
+#define QUEUE_MPMC_H
+
+#include "message.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Ограниченное MPMC-кольцо Вьюкова: номер последовательности в каждой ячейке
+// говорит, чей сейчас ход - производителя или потребителя, поэтому операции
+// обходятся одним CAS по общей позиции, без мьютекса и семафоров.
+typedef struct {
+    atomic_size_t sequence;
+    Message *msg;
+} MpmcCell;
+
+typedef struct {
+    MpmcCell *buffer;
+    size_t mask;            // capacity - 1, ёмкость - степень двойки
+    int capacity;
+
+    // Позиции и есть счётчики total_added / total_extracted, отдельных
+    // атомарных счётчиков на горячем пути нет.
+    _Alignas(CACHE_LINE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE) atomic_size_t dequeue_pos;
+
+    _Alignas(CACHE_LINE) atomic_long full_waits;     // производитель застал кольцо полным
+    atomic_long empty_waits;    // потребитель застал кольцо пустым
+} CircularQueue_Mpmc;
+
+extern CircularQueue_Mpmc queue_mpmc;
+
+int init_queue_mpmc(CircularQueue_Mpmc *q, int size);
+void destroy_queue_mpmc(CircularQueue_Mpmc *q);
+
+// 0 - успех, -1 - кольцо сейчас полно / пусто.
+int enqueue_mpmc(CircularQueue_Mpmc *q, Message *msg);
+int dequeue_mpmc(CircularQueue_Mpmc *q, Message **msg);
+int count_mpmc(CircularQueue_Mpmc *q);
+
+#endif
@@ -0,0 +1,266 @@
+#include "queue_prio.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+CircularQueue_Prio queue_prio;
+
+const int prio_weights[PRIO_LANES] = {8, 4, 1};
+const char *const prio_lane_names[PRIO_LANES] = {"high", "normal", "bulk"};
+
+int prio_lane_of(uint8_t type) {
+    if (type < PRIO_HIGH_TYPES) return 0;
+    if (type < PRIO_NORMAL_TYPES) return 1;
+    return 2;
+}
+
+static void destroy_lanes(CircularQueue_Prio *q, int n) {
+    for (int i = 0; i < n; ++i) {
+        pthread_cond_destroy(&q->lanes[i].can_produce);
+        free(q->lanes[i].buffer);
+        q->lanes[i].buffer = NULL;
+    }
+}
+
+int init_queue_prio(CircularQueue_Prio *q, int size, prio_policy_t policy, int aging_ms) {
+    if (size <= 0) {
+        fprintf(stderr, "Invalid queue size %d (Prio)\n", size);
+        return -1;
+    }
+
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        PrioLane *lane = &q->lanes[i];
+        lane->buffer = malloc(sizeof(PrioEntry) * size);
+        if (!lane->buffer) {
+            perror("Failed to allocate lane buffer (Prio)");
+            destroy_lanes(q, i);
+            return -1;
+        }
+        if (init_cond_monotonic(&lane->can_produce) != 0) {
+            perror("Condition variable can_produce initialization failed (Prio)");
+            free(lane->buffer);
+            destroy_lanes(q, i);
+            return -1;
+        }
+        lane->capacity = size;
+        lane->head = 0;
+        lane->tail = 0;
+        lane->count = 0;
+        lane->credit = prio_weights[i];
+        lane->added = 0;
+        lane->extracted = 0;
+        lane->aged = 0;
+        lane->wait_ns_total = 0;
+        lane->wait_ns_max = 0;
+    }
+
+    q->count = 0;
+    q->policy = policy;
+    q->aging_ns = aging_ms * 1000000L;
+    q->high_since_aged = PRIO_AGED_EVERY;
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+
+    if (pthread_mutex_init(&q->mutex, NULL) != 0) {
+        perror("Mutex initialization failed (Prio)");
+        destroy_lanes(q, PRIO_LANES);
+        return -1;
+    }
+    if (init_cond_monotonic(&q->can_consume) != 0) {
+        perror("Condition variable can_consume initialization failed (Prio)");
+        pthread_mutex_destroy(&q->mutex);
+        destroy_lanes(q, PRIO_LANES);
+        return -1;
+    }
+    q->ready = 1;
+    return 0;
+}
+
+void prio_set_policy(CircularQueue_Prio *q, prio_policy_t policy) {
+    pthread_mutex_lock(&q->mutex);
+    q->policy = policy;
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        q->lanes[i].credit = prio_weights[i];
+    }
+    pthread_mutex_unlock(&q->mutex);
+}
+
+int enqueue_prio(CircularQueue_Prio *q, Message *msg, const struct timespec *deadline) {
+    int rc = QUEUE_OK;
+    PrioLane *lane = &q->lanes[prio_lane_of(msg->type)];
+
+    pthread_mutex_lock(&q->mutex);
+    if (lane->count >= lane->capacity) {
+        atomic_fetch_add_explicit(&q->full_waits, 1, memory_order_relaxed);
+    }
+    while (lane->count >= lane->capacity && keep_running) {
+        rc = cond_wait_deadline(&lane->can_produce, &q->mutex, deadline);
+        if (rc != QUEUE_OK) break;
+    }
+    if (lane->count >= lane->capacity) {
+        pthread_mutex_unlock(&q->mutex);
+        return rc != QUEUE_OK ? rc : QUEUE_TIMEOUT;
+    }
+
+    lane->buffer[lane->tail] = (PrioEntry){.msg = msg, .enqueued_ns = monotonic_ns()};
+    lane->tail = (lane->tail + 1) % lane->capacity;
+    lane->count++;
+    lane->added++;
+    q->count++;
+
+    pthread_cond_signal(&q->can_consume);
+    pthread_mutex_unlock(&q->mutex);
+    return QUEUE_OK;
+}
+
+// Полоса по старению или политике (под мьютексом, q->count > 0).
+static int choose_lane(CircularQueue_Prio *q, long now, int *aged) {
+    *aged = 0;
+    // Старение: самая давняя голова среди менее срочных полос, если она
+    // ждёт дольше порога. При непустой срочной полосе - не чаще раза на
+    // PRIO_AGED_EVERY срочных выборок: иначе при постоянном отставании
+    // менее срочные полосы всегда "состарены" и срочная обслуживается последней.
+    if (q->aging_ns > 0 && (q->lanes[0].count == 0 || q->high_since_aged >= PRIO_AGED_EVERY)) {
+        int oldest = -1;
+        long oldest_ns = 0;
+        for (int i = 1; i < PRIO_LANES; ++i) {
+            PrioLane *lane = &q->lanes[i];
+            if (lane->count == 0) continue;
+            long enq = lane->buffer[lane->head].enqueued_ns;
+            if (now - enq >= q->aging_ns && (oldest < 0 || enq < oldest_ns)) {
+                oldest = i;
+                oldest_ns = enq;
+            }
+        }
+        if (oldest >= 0) {
+            *aged = 1;
+            return oldest;
+        }
+    }
+
+    if (q->policy == PRIO_STRICT) {
+        for (int i = 0; i < PRIO_LANES; ++i) {
+            if (q->lanes[i].count > 0) return i;
+        }
+        return -1;
+    }
+
+    // Взвешенный круг: первая непустая полоса с неизрасходованной долей;
+    // когда доли всех непустых полос исчерпаны, начинается новый раунд.
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < PRIO_LANES; ++i) {
+            PrioLane *lane = &q->lanes[i];
+            if (lane->count > 0 && lane->credit > 0) {
+                lane->credit--;
+                return i;
+            }
+        }
+        for (int i = 0; i < PRIO_LANES; ++i) {
+            q->lanes[i].credit = prio_weights[i];
+        }
+    }
+    return -1;
+}
+
+// Полоса, из которой брать (под мьютексом, q->count > 0). *aged = 1, если
+// выбор сделан старением.
+static int pick_lane(CircularQueue_Prio *q, long now, int *aged) {
+    int i = choose_lane(q, now, aged);
+    if (*aged) {
+        q->high_since_aged = 0;
+    } else if (i == 0 && q->high_since_aged < PRIO_AGED_EVERY) {
+        q->high_since_aged++;
+    }
+    return i;
+}
+
+int dequeue_prio(CircularQueue_Prio *q, Message **msg, int *lane_out, const struct timespec *deadline) {
+    int rc = QUEUE_OK;
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->count == 0) {
+        atomic_fetch_add_explicit(&q->empty_waits, 1, memory_order_relaxed);
+    }
+    while (q->count == 0 && keep_running) {
+        rc = cond_wait_deadline(&q->can_consume, &q->mutex, deadline);
+        if (rc != QUEUE_OK) break;
+    }
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->mutex);
+        return rc != QUEUE_OK ? rc : QUEUE_TIMEOUT;
+    }
+
+    long now = monotonic_ns();
+    int aged;
+    int i = pick_lane(q, now, &aged);
+    PrioLane *lane = &q->lanes[i];
+    PrioEntry entry = lane->buffer[lane->head];
+    lane->head = (lane->head + 1) % lane->capacity;
+    lane->count--;
+    lane->extracted++;
+    lane->aged += aged;
+    long waited = now - entry.enqueued_ns;
+    lane->wait_ns_total += waited;
+    if (waited > lane->wait_ns_max) lane->wait_ns_max = waited;
+    q->count--;
+
+    pthread_cond_signal(&lane->can_produce);
+    pthread_mutex_unlock(&q->mutex);
+
+    *msg = entry.msg;
+    if (lane_out) *lane_out = i;
+    return QUEUE_OK;
+}
+
+void prio_get_stats(CircularQueue_Prio *q, prio_stats_t *st) {
+    pthread_mutex_lock(&q->mutex);
+    long now = monotonic_ns();
+    st->count = q->count;
+    st->policy = q->policy;
+    st->aging_ns = q->aging_ns;
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        PrioLane *lane = &q->lanes[i];
+        prio_lane_stats_t *ls = &st->lanes[i];
+        ls->capacity = lane->capacity;
+        ls->count = lane->count;
+        ls->weight = prio_weights[i];
+        ls->added = lane->added;
+        ls->extracted = lane->extracted;
+        ls->aged = lane->aged;
+        ls->wait_ns_avg = lane->extracted ? lane->wait_ns_total / lane->extracted : 0;
+        ls->wait_ns_max = lane->wait_ns_max;
+        ls->head_age_ns = lane->count ? now - lane->buffer[lane->head].enqueued_ns : 0;
+    }
+    pthread_mutex_unlock(&q->mutex);
+}
+
+void destroy_queue_prio(CircularQueue_Prio *q) {
+    if (pthread_mutex_lock(&q->mutex) != 0) {
+        perror("Failed to lock mutex for destroy (Prio)");
+    }
+
+    printf("Destroying queue (Prio)...\n");
+    int dropped = 0;
+    for (int i = 0; i < PRIO_LANES; ++i) {
+        PrioLane *lane = &q->lanes[i];
+        while (lane->count > 0) {
+            destroy_message(lane->buffer[lane->head].msg);
+            lane->head = (lane->head + 1) % lane->capacity;
+            lane->count--;
+            dropped++;
+        }
+        pthread_cond_broadcast(&lane->can_produce);
+    }
+    if (dropped > 0) {
+        printf("Dropped %d messages left in the lanes.\n", dropped);
+    }
+    q->count = 0;
+    q->ready = 0;
+    pthread_cond_broadcast(&q->can_consume);
+    pthread_mutex_unlock(&q->mutex);
+
+    destroy_lanes(q, PRIO_LANES);
+    if (pthread_cond_destroy(&q->can_consume) != 0) perror("Failed to destroy can_consume condition variable (Prio)");
+    if (pthread_mutex_destroy(&q->mutex) != 0) perror("Failed to destroy mutex (Prio)");
+
+    printf("Queue (Prio) destroyed.\n");
+}
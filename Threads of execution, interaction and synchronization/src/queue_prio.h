@@ -0,0 +1,104 @@
+#ifndef QUEUE_PRIO_H
+#define QUEUE_PRIO_H
+
+#include "message.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Очередь с полосами приоритета: Message.type определяет класс, у каждого
+// класса своё кольцо и своё ожидание места, так что поток массовых
+// сообщений не занимает место срочных. Потребитель выбирает полосу по
+// политике: строгий приоритет (всегда самая срочная непустая) или
+// взвешенный круг (за раунд полоса i отдаёт до prio_weights[i] сообщений).
+// Старение: если голова менее срочной полосы ждёт дольше aging_ns, она
+// берётся вне очереди - ни одна полоса не голодает. Пока срочная полоса
+// не пуста, вне очереди берётся не больше одного сообщения на
+// PRIO_AGED_EVERY срочных, так что старение не переворачивает приоритет.
+#define PRIO_LANES 3
+#define PRIO_HIGH_TYPES 32      // типы 0..31 - срочные (полоса 0)
+#define PRIO_NORMAL_TYPES 128   // 32..127 - обычные (1), остальные - массовые (2)
+#define PRIO_AGING_MS 500       // порог старения в лабораторной
+#define PRIO_AGED_EVERY 8       // срочных выборок на одну по старению
+
+typedef enum {
+    PRIO_WEIGHTED,
+    PRIO_STRICT
+} prio_policy_t;
+
+typedef struct {
+    Message *msg;
+    long enqueued_ns;       // CLOCK_MONOTONIC, для задержки в очереди
+} PrioEntry;
+
+typedef struct {
+    PrioEntry *buffer;
+    int capacity;
+    int head;
+    int tail;
+    int count;
+    int credit;             // сколько ещё можно взять в текущем раунде
+    long added;
+    long extracted;
+    long aged;              // взято вне очереди по старению
+    long wait_ns_total;     // сумма задержек извлечённых сообщений
+    long wait_ns_max;
+    pthread_cond_t can_produce;
+} PrioLane;
+
+typedef struct {
+    PrioLane lanes[PRIO_LANES];
+    int count;              // по всем полосам
+    prio_policy_t policy;
+    long aging_ns;
+    int high_since_aged;    // выборок из срочной полосы после последней по старению
+    int ready;              // 1 между init и destroy
+
+    pthread_mutex_t mutex;
+    pthread_cond_t can_consume;
+
+    atomic_long full_waits;
+    atomic_long empty_waits;
+} CircularQueue_Prio;
+
+typedef struct {
+    int capacity;
+    int count;
+    int weight;
+    long added;
+    long extracted;
+    long aged;
+    long wait_ns_avg;
+    long wait_ns_max;
+    long head_age_ns;       // сколько ждёт голова полосы, 0 - пусто
+} prio_lane_stats_t;
+
+typedef struct {
+    int count;
+    prio_policy_t policy;
+    long aging_ns;
+    prio_lane_stats_t lanes[PRIO_LANES];
+} prio_stats_t;
+
+extern CircularQueue_Prio queue_prio;
+extern const int prio_weights[PRIO_LANES];
+extern const char *const prio_lane_names[PRIO_LANES];
+
+// size - ёмкость каждой полосы, aging_ms - порог старения (0 - без старения).
+int init_queue_prio(CircularQueue_Prio *q, int size, prio_policy_t policy, int aging_ms);
+void destroy_queue_prio(CircularQueue_Prio *q);
+
+int prio_lane_of(uint8_t type);
+void prio_set_policy(CircularQueue_Prio *q, prio_policy_t policy);
+
+// deadline - абсолютное время CLOCK_MONOTONIC, NULL - ждать без ограничения.
+// Ожидание прерывается и при keep_running == 0.
+// Возвращают QUEUE_OK / QUEUE_TIMEOUT / QUEUE_ERROR.
+int enqueue_prio(CircularQueue_Prio *q, Message *msg, const struct timespec *deadline);
+// lane (может быть NULL) - из какой полосы взято сообщение.
+int dequeue_prio(CircularQueue_Prio *q, Message **msg, int *lane, const struct timespec *deadline);
+
+// Копия счётчиков; мьютекс держится только на время копирования.
+void prio_get_stats(CircularQueue_Prio *q, prio_stats_t *st);
+
+#endif
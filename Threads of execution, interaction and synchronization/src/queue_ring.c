@@ -0,0 +1,213 @@
+#include "queue_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+CircularQueue_Ring queue_ring;
+
+static RingRecord *record_at(CircularQueue_Ring *q, size_t pos) {
+    return (RingRecord *)(q->buffer + pos % q->size);
+}
+
+static RingRecord *record_of(Message *msg) {
+    return (RingRecord *)msg - 1;
+}
+
+int init_queue_ring(CircularQueue_Ring *q, int size) {
+    if (size <= 0) {
+        fprintf(stderr, "Invalid queue size %d (Ring)\n", size);
+        return -1;
+    }
+    // Запись, не поместившаяся до конца буфера, занимает ещё и хвост под
+    // маркер, поэтому меньше двух максимальных записей буфер быть не может.
+    int slots = size < 2 ? 2 : size;
+    q->size = (size_t)slots * RING_MAX_RECORD;
+    q->buffer = aligned_alloc(RING_ALIGN, q->size);
+    if (!q->buffer) {
+        perror("Failed to allocate queue buffer (Ring)");
+        return -1;
+    }
+
+    q->capacity = size;
+    q->head = 0;
+    q->read = 0;
+    q->tail = 0;
+    q->count = 0;
+    q->total_added = 0;
+    q->total_extracted = 0;
+    q->wraps = 0;
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+
+    if (pthread_mutex_init(&q->mutex, NULL) != 0) {
+        perror("Mutex initialization failed (Ring)");
+        free(q->buffer);
+        return -1;
+    }
+    if (init_cond_monotonic(&q->can_reserve) != 0) {
+        perror("Condition variable can_reserve initialization failed");
+        pthread_mutex_destroy(&q->mutex);
+        free(q->buffer);
+        return -1;
+    }
+    if (init_cond_monotonic(&q->can_read) != 0) {
+        perror("Condition variable can_read initialization failed");
+        pthread_cond_destroy(&q->can_reserve);
+        pthread_mutex_destroy(&q->mutex);
+        free(q->buffer);
+        return -1;
+    }
+    return 0;
+}
+
+Message *ring_reserve(CircularQueue_Ring *q, uint8_t size_field, const struct timespec *deadline) {
+    size_t need = RING_RECORD_SIZE(size_field);
+    int waited = 0;
+
+    pthread_mutex_lock(&q->mutex);
+    size_t contig;
+    for (;;) {
+        contig = q->size - q->tail % q->size;
+        size_t total = need <= contig ? need : contig + need;
+        if (q->size - (q->tail - q->head) >= total) break;
+        if (!keep_running) {
+            pthread_mutex_unlock(&q->mutex);
+            return NULL;
+        }
+        if (!waited) {
+            atomic_fetch_add_explicit(&q->full_waits, 1, memory_order_relaxed);
+            waited = 1;
+        }
+        int rc = cond_wait_deadline(&q->can_reserve, &q->mutex, deadline);
+        if (rc != QUEUE_OK) {
+            if (rc == QUEUE_ERROR) fprintf(stderr, "ring_reserve: pthread_cond_wait failed: %d\n", errno);
+            pthread_mutex_unlock(&q->mutex);
+            return NULL;
+        }
+    }
+
+    if (need > contig) {
+        RingRecord *wrap = record_at(q, q->tail);
+        wrap->len = (uint32_t)contig;
+        wrap->state = RING_WRAP;
+        q->tail += contig;
+        q->wraps++;
+    }
+    RingRecord *rec = record_at(q, q->tail);
+    rec->len = (uint32_t)need;
+    rec->state = RING_RESERVED;
+    q->tail += need;
+    q->count++;
+    pthread_mutex_unlock(&q->mutex);
+
+    return (Message *)(rec + 1);
+}
+
+void ring_commit(CircularQueue_Ring *q, Message *msg) {
+    pthread_mutex_lock(&q->mutex);
+    record_of(msg)->state = RING_COMMITTED;
+    q->total_added++;
+    // Если запись не первая в очереди, разбуженный потребитель снова уснёт,
+    // а сообщение достанется по цепочке из ring_acquire.
+    pthread_cond_signal(&q->can_read);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+// Первая непрочитанная запись, минуя маркеры конца круга; NULL - кольцо пусто.
+static RingRecord *next_readable(CircularQueue_Ring *q, size_t *pos) {
+    while (*pos != q->tail) {
+        RingRecord *rec = record_at(q, *pos);
+        if (rec->state != RING_WRAP) return rec;
+        *pos += rec->len;
+    }
+    return NULL;
+}
+
+Message *ring_acquire(CircularQueue_Ring *q, const struct timespec *deadline) {
+    int waited = 0;
+
+    pthread_mutex_lock(&q->mutex);
+    RingRecord *rec;
+    for (;;) {
+        rec = next_readable(q, &q->read);
+        if (rec && rec->state == RING_COMMITTED) break;
+        if (!keep_running) {
+            pthread_mutex_unlock(&q->mutex);
+            return NULL;
+        }
+        if (!waited) {
+            atomic_fetch_add_explicit(&q->empty_waits, 1, memory_order_relaxed);
+            waited = 1;
+        }
+        int rc = cond_wait_deadline(&q->can_read, &q->mutex, deadline);
+        if (rc != QUEUE_OK) {
+            if (rc == QUEUE_ERROR) fprintf(stderr, "ring_acquire: pthread_cond_wait failed: %d\n", errno);
+            pthread_mutex_unlock(&q->mutex);
+            return NULL;
+        }
+    }
+
+    rec->state = RING_CLAIMED;
+    q->read += rec->len;
+    q->total_extracted++;
+
+    // Следующая запись уже готова - будим ещё одного потребителя.
+    size_t pos = q->read;
+    RingRecord *next = next_readable(q, &pos);
+    if (next && next->state == RING_COMMITTED) {
+        pthread_cond_signal(&q->can_read);
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    return (Message *)(rec + 1);
+}
+
+void ring_release(CircularQueue_Ring *q, Message *msg) {
+    pthread_mutex_lock(&q->mutex);
+    record_of(msg)->state = RING_DONE;
+
+    // Место возвращается только с начала кольца: head проходит подряд
+    // идущие прочитанные записи и маркеры.
+    size_t old_head = q->head;
+    while (q->head != q->read) {
+        RingRecord *rec = record_at(q, q->head);
+        if (rec->state == RING_DONE) {
+            q->count--;
+        } else if (rec->state != RING_WRAP) {
+            break;
+        }
+        q->head += rec->len;
+    }
+    if (q->head != old_head) {
+        pthread_cond_broadcast(&q->can_reserve);
+    }
+    pthread_mutex_unlock(&q->mutex);
+}
+
+void destroy_queue_ring(CircularQueue_Ring *q) {
+    if (pthread_mutex_lock(&q->mutex) != 0) {
+        perror("Failed to lock mutex for destroy (Ring)");
+    }
+
+    printf("Destroying queue (Ring)...\n");
+    if (q->count > 0) {
+        printf("Dropping %d messages left in the ring.\n", q->count);
+    }
+
+    free(q->buffer);
+    q->buffer = NULL;
+    q->size = 0;
+    q->capacity = 0;
+    q->head = q->read = q->tail = 0;
+    q->count = 0;
+
+    pthread_cond_broadcast(&q->can_reserve);
+    pthread_cond_broadcast(&q->can_read);
+    pthread_mutex_unlock(&q->mutex);
+
+    if (pthread_cond_destroy(&q->can_reserve) != 0) perror("Failed to destroy can_reserve condition variable");
+    if (pthread_cond_destroy(&q->can_read) != 0) perror("Failed to destroy can_read condition variable");
+    if (pthread_mutex_destroy(&q->mutex) != 0) perror("Failed to destroy mutex (Ring)");
+
+    printf("Queue (Ring) destroyed.\n");
+}
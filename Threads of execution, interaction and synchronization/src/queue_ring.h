@@ -0,0 +1,75 @@
+#ifndef QUEUE_RING_H
+#define QUEUE_RING_H
+
+#include "message.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Байтовое кольцо: сообщения лежат прямо в буфере очереди, друг за другом,
+// каждое с 8-байтным заголовком записи. Производитель резервирует место под
+// сообщение нужного размера (ring_reserve), заполняет его на месте и
+// публикует (ring_commit); потребитель получает указатель на сообщение в
+// кольце (ring_acquire), проверяет хеш и освобождает место (ring_release).
+// Ни malloc, ни копирования сообщений нет. Если запись не помещается до
+// конца буфера, хвост закрывается маркером RING_WRAP и запись начинается
+// с начала буфера.
+
+typedef enum {
+    RING_RESERVED = 1,      // место выделено, производитель пишет
+    RING_COMMITTED,         // сообщение готово к чтению
+    RING_CLAIMED,           // потребитель читает
+    RING_DONE,              // прочитано, место можно вернуть
+    RING_WRAP               // пустой хвост буфера до конца круга
+} ring_state_t;
+
+typedef struct {
+    uint32_t len;           // длина записи вместе с заголовком, кратна 8
+    uint32_t state;         // ring_state_t
+} RingRecord;
+
+#define RING_ALIGN 8
+#define RING_RECORD_SIZE(s) \
+    ((sizeof(RingRecord) + MESSAGE_ALLOC_SIZE(s) + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1))
+#define RING_MAX_RECORD RING_RECORD_SIZE(MAX_DATA_SIZE)
+
+typedef struct {
+    unsigned char *buffer;
+    size_t size;            // байт в буфере, кратно RING_ALIGN
+    int capacity;           // сколько сообщений максимального размера гарантированно помещается
+
+    // Позиции - сквозные смещения в байтах (позиция в буфере - по модулю size):
+    // head - начало самой старой неосвобождённой записи, read - следующая
+    // запись для потребителя, tail - место следующего резерва.
+    size_t head;
+    size_t read;
+    size_t tail;
+    int count;              // сообщений в кольце (от RESERVED до DONE)
+
+    long total_added;
+    long total_extracted;
+    long wraps;             // поставлено маркеров RING_WRAP
+
+    pthread_mutex_t mutex;
+    pthread_cond_t can_reserve;
+    pthread_cond_t can_read;
+
+    atomic_long full_waits;
+    atomic_long empty_waits;
+} CircularQueue_Ring;
+
+extern CircularQueue_Ring queue_ring;
+
+// size - в сообщениях максимального размера, как у остальных очередей.
+int init_queue_ring(CircularQueue_Ring *q, int size);
+void destroy_queue_ring(CircularQueue_Ring *q);
+
+// deadline - абсолютное время CLOCK_MONOTONIC, NULL - ждать без ограничения.
+// Ожидание прерывается и при keep_running == 0. NULL - время вышло.
+Message *ring_reserve(CircularQueue_Ring *q, uint8_t size_field, const struct timespec *deadline);
+void ring_commit(CircularQueue_Ring *q, Message *msg);
+Message *ring_acquire(CircularQueue_Ring *q, const struct timespec *deadline);
+void ring_release(CircularQueue_Ring *q, Message *msg);
+
+#endif
@@ -0,0 +1,94 @@
+#include "queue_segment.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+QueueSegment *segment_create(int size) {
+    QueueSegment *seg = malloc(sizeof(QueueSegment) + (size_t)size * sizeof(Message *));
+    if (!seg) return NULL;
+    seg->next = NULL;
+    seg->size = size;
+    seg->head = 0;
+    seg->tail = 0;
+    seg->count = 0;
+    return seg;
+}
+
+void segments_free(QueueSegment *list) {
+    while (list) {
+        QueueSegment *next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+static void retire(QueueSegment *seg, QueueSegment **retired) {
+    seg->next = *retired;
+    *retired = seg;
+}
+
+int segment_chain_init(SegmentChain *c, int size) {
+    QueueSegment *seg = segment_create(size);
+    if (!seg) return -1;
+    c->oldest = seg;
+    c->newest = seg;
+    c->epoch = 0;
+    c->segments = 1;
+    return 0;
+}
+
+void segment_chain_append(SegmentChain *c, QueueSegment *seg, QueueSegment **retired) {
+    if (c->oldest == c->newest && c->newest->count == 0) {
+        retire(c->newest, retired);
+        c->oldest = seg;
+        c->segments = 0;
+    } else {
+        c->newest->next = seg;
+    }
+    c->newest = seg;
+    c->epoch++;
+    c->segments++;
+}
+
+void segment_chain_push(SegmentChain *c, Message *msg) {
+    QueueSegment *seg = c->newest;
+    seg->slots[seg->tail] = msg;
+    seg->tail = (seg->tail + 1) % seg->size;
+    seg->count++;
+}
+
+Message *segment_chain_pop(SegmentChain *c, QueueSegment **retired) {
+    QueueSegment *seg = c->oldest;
+    while (seg->count == 0 && seg->next) {
+        c->oldest = seg->next;
+        c->segments--;
+        retire(seg, retired);
+        seg = c->oldest;
+    }
+    if (seg->count == 0) return NULL;
+
+    Message *msg = seg->slots[seg->head];
+    seg->head = (seg->head + 1) % seg->size;
+    seg->count--;
+    if (seg->count == 0 && seg->next) {
+        c->oldest = seg->next;
+        c->segments--;
+        retire(seg, retired);
+    }
+    return msg;
+}
+
+int segment_chain_destroy(SegmentChain *c) {
+    QueueSegment *retired = NULL;
+    int dropped = 0;
+    Message *msg;
+    while (c->oldest && (msg = segment_chain_pop(c, &retired)) != NULL) {
+        destroy_message(msg);
+        dropped++;
+    }
+    segments_free(retired);
+    segments_free(c->oldest);
+    c->oldest = NULL;
+    c->newest = NULL;
+    c->segments = 0;
+    return dropped;
+}
@@ -0,0 +1,44 @@
+#ifndef QUEUE_SEGMENT_H
+#define QUEUE_SEGMENT_H
+
+#include "message.h"
+
+// Сегмент - кольцо указателей фиксированного размера, одна эпоха очереди.
+// Изменение размера не копирует сообщения: к цепочке добавляется новый
+// сегмент нужного размера, производители пишут только в него (newest),
+// а потребители дочитывают старые сегменты по порядку (oldest) и
+// выбрасывают опустевшие. Порядок FIFO сохраняется.
+// Все функции вызываются под мьютексом очереди.
+typedef struct queue_segment {
+    struct queue_segment *next;   // следующая (более новая) эпоха
+    int size;
+    int head;
+    int tail;
+    int count;
+    Message *slots[];
+} QueueSegment;
+
+typedef struct {
+    QueueSegment *oldest;   // отсюда читают потребители
+    QueueSegment *newest;   // сюда пишут производители, size == ёмкость очереди
+    unsigned long epoch;    // сколько раз менялся размер
+    int segments;           // сегментов в цепочке
+} SegmentChain;
+
+// Выделение сегмента - без мьютекса, до захвата очереди.
+QueueSegment *segment_create(int size);
+void segments_free(QueueSegment *list);
+
+int segment_chain_init(SegmentChain *c, int size);
+// Делает seg новейшим сегментом. Пустой прежний newest, если он же
+// oldest, сразу уходит в retired.
+void segment_chain_append(SegmentChain *c, QueueSegment *seg, QueueSegment **retired);
+// Место в newest должно быть (это гарантирует учёт ёмкости очереди).
+void segment_chain_push(SegmentChain *c, Message *msg);
+// NULL - цепочка пуста. Дочитанные сегменты уходят в retired, чтобы
+// освободить их уже после снятия мьютекса.
+Message *segment_chain_pop(SegmentChain *c, QueueSegment **retired);
+// Уничтожает оставшиеся сообщения и все сегменты; возвращает их число.
+int segment_chain_destroy(SegmentChain *c);
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE             // sem_clockwait
 #include "queue_sem.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,32 +7,50 @@
 
 CircularQueue_Sem queue;
 
+// Под мьютексом, перед каждым его освобождением после изменения счётчиков.
+static void publish_stats_sem(CircularQueue_Sem *q) {
+    queue_snapshot_t s = {
+        .capacity = q->capacity, .count = q->count,
+        .total_added = q->total_added, .total_extracted = q->total_extracted,
+        .lock_ops = q->lock_ops, .slot_debt = q->slot_debt,
+        .epoch = q->ring.epoch, .segments = q->ring.segments,
+    };
+    queue_stats_publish(&q->stats, &s);
+}
+
+void snapshot_queue_sem(CircularQueue_Sem *q, queue_snapshot_t *s) {
+    queue_stats_read(&q->stats, s);
+}
+
 int init_queue_sem(CircularQueue_Sem *q, int size) {
-    q->buffer = (Message **)malloc(size * sizeof(Message *));
-    if (!q->buffer) {
+    if (segment_chain_init(&q->ring, size) != 0) {
         perror("Failed to allocate queue buffer");
         return -1;
     }
 
     q->capacity = size;
-    q->head = 0;
-    q->tail = 0;
     q->count = 0;
+    q->slot_debt = 0;
     q->total_added = 0;
     q->total_extracted = 0;
-    q->resize_request = 0;
-    q->new_capacity_request = 0;
+    q->lock_ops = 0;
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+    spin_policy_init(&q->produce_spin);
+    spin_policy_init(&q->consume_spin);
+    queue_stats_init(&q->stats);
+    publish_stats_sem(q);
 
     if (pthread_mutex_init(&q->mutex, NULL) != 0) {
         perror("Mutex initialization failed");
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
 
     if (sem_init(&q->empty_slots, 0, size) != 0) {
         perror("Semaphore empty_slots initialization failed");
         pthread_mutex_destroy(&q->mutex);
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
 
@@ -39,73 +58,153 @@ int init_queue_sem(CircularQueue_Sem *q, int size) {
         perror("Semaphore filled_slots initialization failed");
         sem_destroy(&q->empty_slots);
         pthread_mutex_destroy(&q->mutex);
-        free(q->buffer);
+        segment_chain_destroy(&q->ring);
         return -1;
     }
     return 0; 
 }
 
+// Гасит долг слотов из n освободившихся токенов empty_slots (под мьютексом);
+// возвращает, сколько токенов осталось вернуть в семафор.
+static int repay_debt_sem(CircularQueue_Sem *q, int n) {
+    int pay = n < q->slot_debt ? n : q->slot_debt;
+    q->slot_debt -= pay;
+    return n - pay;
+}
+
+static int try_slot_sem(void *sem) {
+    return sem_trywait(sem) == 0;
+}
 
-int resize_queue_internal_sem(CircularQueue_Sem *q, int new_capacity) {
+// Сначала sem_trywait и кручение; если слот так и не появился, поток
+// уходит в futex-ожидание, и это отмечается в счётчике waits.
+static int wait_slot_sem(sem_t *sem, spin_policy_t *spin, atomic_long *waits, const struct timespec *deadline) {
+    if (spin_wait(spin, try_slot_sem, sem)) return QUEUE_OK;
+    atomic_fetch_add_explicit(waits, 1, memory_order_relaxed);
+    int rc = deadline ? sem_clockwait(sem, CLOCK_MONOTONIC, deadline) : sem_wait(sem);
+    if (rc == 0) return QUEUE_OK;
+    if (errno == ETIMEDOUT) return QUEUE_TIMEOUT;
+    if (errno == EINTR) return QUEUE_RETRY;
+    return QUEUE_ERROR;
+}
+
+// Ждёт первый слот, остальные до max добирает без ожидания.
+// Возвращает число полученных слотов или код ошибки wait_slot_sem.
+static int take_slots_sem(sem_t *sem, spin_policy_t *spin, atomic_long *waits, int max, const struct timespec *deadline) {
+    int rc = wait_slot_sem(sem, spin, waits, deadline);
+    if (rc != QUEUE_OK) return rc == QUEUE_RETRY ? 0 : rc;
+    int taken = 1;
+    while (taken < max && sem_trywait(sem) == 0) taken++;
+    return taken;
+}
+
+static void put_slots_sem(sem_t *sem, int n) {
+    for (int i = 0; i < n; ++i) sem_post(sem);
+}
+
+int resize_queue_sem(CircularQueue_Sem *q, int new_capacity) {
     if (new_capacity <= 0) {
         fprintf(stderr, "Resize Error: Invalid new capacity %d\n", new_capacity);
         return -1;
     }
-
-    if (new_capacity < q->count) {
-         fprintf(stderr, "Resize Error: New capacity %d < current count %d. Cannot shrink.\n", new_capacity, q->count);
-         return -1;
-    }
-
-    Message **new_buffer = (Message **)malloc(new_capacity * sizeof(Message *));
-    if (!new_buffer) {
+    QueueSegment *seg = segment_create(new_capacity);
+    if (!seg) {
         fprintf(stderr, "Resize Error: Failed to allocate new buffer of size %d\n", new_capacity);
         return -1;
     }
 
-    printf("Resizing queue from %d to %d (current count: %d)...\n", q->capacity, new_capacity, q->count);
-
-    int current_index = q->head;
-    for (int i = 0; i < q->count; ++i) {
-        new_buffer[i] = q->buffer[current_index];
-        current_index = (current_index + 1) % q->capacity; 
+    QueueSegment *retired = NULL;
+    int post = 0;
+    pthread_mutex_lock(&q->mutex);
+    int old_capacity = q->capacity;
+    if (new_capacity == old_capacity) {
+        pthread_mutex_unlock(&q->mutex);
+        free(seg);
+        return 0;
     }
+    segment_chain_append(&q->ring, seg, &retired);
+    q->capacity = new_capacity;
+    if (new_capacity > old_capacity) {
+        post = repay_debt_sem(q, new_capacity - old_capacity);
+    } else {
+        // Свободные токены изымаются сразу, остальные - в долг: их погасят
+        // потребители, освобождая слоты, и производители с лишними токенами.
+        int take = old_capacity - new_capacity;
+        while (take > 0 && sem_trywait(&q->empty_slots) == 0) take--;
+        q->slot_debt += take;
+    }
+    publish_stats_sem(q);
+    pthread_mutex_unlock(&q->mutex);
 
-    free(q->buffer); 
+    put_slots_sem(&q->empty_slots, post);
+    segments_free(retired);
+    return 0;
+}
 
-    q->buffer = new_buffer;
-    q->head = 0;          
-    q->tail = q->count;  
-    int old_capacity = q->capacity;
-    q->capacity = new_capacity;
+int enqueue_batch_sem(CircularQueue_Sem *q, Message **msgs, int n, const struct timespec *deadline) {
+    int slots = take_slots_sem(&q->empty_slots, &q->produce_spin, &q->full_waits, n, deadline);
+    if (slots <= 0) return slots;
+
+    pthread_mutex_lock(&q->mutex);
+    q->lock_ops++;
+    int k = q->capacity - q->count;
+    if (k < 0) k = 0;
+    if (k > slots) k = slots;
+    for (int i = 0; i < k; ++i) {
+        segment_chain_push(&q->ring, msgs[i]);
+    }
+    q->count += k;
+    q->total_added += k;
+    // Токенов больше, чем места, только если очередь уменьшили: лишние
+    // идут в счёт долга.
+    int unused = repay_debt_sem(q, slots - k);
+    publish_stats_sem(q);
+    pthread_mutex_unlock(&q->mutex);
+
+    put_slots_sem(&q->empty_slots, unused);
+    put_slots_sem(&q->filled_slots, k);
+    return k;
+}
 
-    int diff = new_capacity - old_capacity;
-    if (diff > 0) { 
-        for (int i = 0; i < diff; ++i) {
-            if (sem_post(&q->empty_slots) != 0) {
-                perror("sem_post failed during resize up");
-            }
-        }
-    } else if (diff < 0) { 
-        int failed_trywaits = 0;
-        for (int i = 0; i < -diff; ++i) {
-            if (sem_trywait(&q->empty_slots) != 0) {
-                if (errno == EAGAIN) {
-                    failed_trywaits++; 
-                } else {
-                    perror("sem_trywait failed during resize down");
-                }
-            }
-        }
-        if(failed_trywaits > 0) {
-             printf("Note: During resize down, %d empty slots could not be immediately removed via trywait.\n", failed_trywaits);
-        }
+int dequeue_batch_sem(CircularQueue_Sem *q, Message **msgs, int n, const struct timespec *deadline) {
+    int slots = take_slots_sem(&q->filled_slots, &q->consume_spin, &q->empty_waits, n, deadline);
+    if (slots <= 0) return slots;
+
+    QueueSegment *retired = NULL;
+    pthread_mutex_lock(&q->mutex);
+    q->lock_ops++;
+    if (q->count == 0) {
+        publish_stats_sem(q);
+        pthread_mutex_unlock(&q->mutex);
+        put_slots_sem(&q->filled_slots, slots);
+        fprintf(stderr, "Consumer woke up but queue empty! Sem count should prevent this.\n");
+        return 0;
+    }
+    int k = q->count < slots ? q->count : slots;
+    for (int i = 0; i < k; ++i) {
+        msgs[i] = segment_chain_pop(&q->ring, &retired);
     }
+    q->count -= k;
+    q->total_extracted += k;
+    int freed = repay_debt_sem(q, k);
+    publish_stats_sem(q);
+    pthread_mutex_unlock(&q->mutex);
 
-    printf("Resize complete. New capacity: %d, Count: %d\n", q->capacity, q->count);
-    return 0;
+    segments_free(retired);
+    put_slots_sem(&q->filled_slots, slots - k);
+    put_slots_sem(&q->empty_slots, freed);
+    return k;
 }
 
+int enqueue_sem(CircularQueue_Sem *q, Message *msg, const struct timespec *deadline) {
+    int rc = enqueue_batch_sem(q, &msg, 1, deadline);
+    return rc == 1 ? QUEUE_OK : rc == 0 ? QUEUE_RETRY : rc;
+}
+
+int dequeue_sem(CircularQueue_Sem *q, Message **msg, const struct timespec *deadline) {
+    int rc = dequeue_batch_sem(q, msg, 1, deadline);
+    return rc == 1 ? QUEUE_OK : rc == 0 ? QUEUE_RETRY : rc;
+}
 
 void destroy_queue_sem(CircularQueue_Sem *q) {
 
@@ -114,21 +213,11 @@ void destroy_queue_sem(CircularQueue_Sem *q) {
     }
 
     printf("Destroying queue (Sem)...\n");
-    while (q->count > 0) {
-        Message *msg = q->buffer[q->head];
-        q->head = (q->head + 1) % q->capacity;
-        q->count--;
-        if (msg) { 
-            destroy_message(msg);
-        }
-    }
-
-    free(q->buffer); 
-    q->buffer = NULL;
+    segment_chain_destroy(&q->ring);
     q->capacity = 0;
     q->count = 0;
-    q->head = 0;
-    q->tail = 0;
+    q->slot_debt = 0;
+    publish_stats_sem(q);
 
     pthread_mutex_unlock(&q->mutex);
 
@@ -3,31 +3,69 @@
 
 #include "message.h"
 #include "utils.h"    
+#include "queue_segment.h"
+#include "spin_wait.h"
+#include "queue_stats.h"
 #include <pthread.h>
 #include <semaphore.h> 
+#include <stdatomic.h>
 
 typedef struct {
-    Message **buffer;     
+    // Всё, что меняется под мьютексом, лежит рядом с ним. Индексы
+    // производителя (tail) и потребителя (head) на разные строки не
+    // разнести: обе стороны под тем же захватом пишут count и сам мьютекс,
+    // так что строка всё равно переходит к ядру на каждой операции.
+    pthread_mutex_t mutex; 
+    SegmentChain ring;     // сегменты по эпохам, см. queue_segment.h
     int capacity;          
-    int head;              
-    int tail;             
     int count;             
+    // Токены empty_slots, которые ещё нужно изъять после уменьшения очереди:
+    // их гасят освобождаемые потребителями слоты и лишние токены
+    // производителей. Всегда sem(empty) + count + занятые потоками токены
+    // == capacity + slot_debt.
+    int slot_debt;
 
     long total_added;     
     long total_extracted;   
+    long lock_ops;          // захватов мьютекса операциями постановки/извлечения
 
-    pthread_mutex_t mutex; 
-    sem_t empty_slots;     
-    sem_t filled_slots;  
+    // Семафоры трогают без мьютекса обе стороны - каждому своя строка,
+    // чтобы sem_post одной стороны не выбивал у другой строку мьютекса.
+    _Alignas(CACHE_LINE) sem_t empty_slots;     
+    _Alignas(CACHE_LINE) sem_t filled_slots;  
 
-    volatile sig_atomic_t resize_request; 
-    int new_capacity_request; 
+    // Пишут только производители.
+    _Alignas(CACHE_LINE) atomic_long full_waits;   // производитель ушёл в sem_*wait(empty_slots)
+    spin_policy_t produce_spin;
+    // Пишут только потребители.
+    _Alignas(CACHE_LINE) atomic_long empty_waits;  // потребитель ушёл в sem_*wait(filled_slots)
+    spin_policy_t consume_spin;
+
+    queue_stats_t stats;      // копия счётчиков для чтения без мьютекса
 } CircularQueue_Sem;
 
 extern CircularQueue_Sem queue;
 
 int init_queue_sem(CircularQueue_Sem *q, int size);
 void destroy_queue_sem(CircularQueue_Sem *q);
-int resize_queue_internal_sem(CircularQueue_Sem *q, int new_capacity);
+// Меняет ёмкость сразу, из любого потока: мьютекс держится O(1), сообщения
+// не копируются, производители не останавливаются. Уменьшать можно и ниже
+// текущего count - производители подождут, пока очередь не опустеет до
+// новой ёмкости. 0 - успех.
+int resize_queue_sem(CircularQueue_Sem *q, int new_capacity);
+
+// deadline - абсолютное время CLOCK_MONOTONIC, NULL - ждать без ограничения.
+// Перед сном поток крутится sem_trywait в пределах бюджета (spin_wait.h).
+// Возвращают QUEUE_OK / QUEUE_TIMEOUT / QUEUE_RETRY / QUEUE_ERROR.
+int enqueue_sem(CircularQueue_Sem *q, Message *msg, const struct timespec *deadline);
+int dequeue_sem(CircularQueue_Sem *q, Message **msg, const struct timespec *deadline);
+// Пакетные варианты: до n сообщений за один захват мьютекса. Первый слот
+// ждут как обычно, остальные добирают sem_trywait. Возвращают число
+// перемещённых сообщений, 0 - повторить (токены ушли в slot_debt или
+// сигнал ложный), либо QUEUE_TIMEOUT / QUEUE_ERROR.
+int enqueue_batch_sem(CircularQueue_Sem *q, Message **msgs, int n, const struct timespec *deadline);
+int dequeue_batch_sem(CircularQueue_Sem *q, Message **msgs, int n, const struct timespec *deadline);
+// Снимок счётчиков без захвата мьютекса, из любого потока.
+void snapshot_queue_sem(CircularQueue_Sem *q, queue_snapshot_t *s);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "queue_shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+CircularQueue_Shard queue_shard;
+
+// Следующий шард для политики SHARD_ROUND_ROBIN - свой у каждого производителя.
+static _Thread_local unsigned int rr_next;
+
+static void destroy_shards(CircularQueue_Shard *q, int n) {
+    for (int i = 0; i < n; ++i) {
+        QueueShard *sh = &q->shards[i];
+        pthread_cond_destroy(&sh->can_produce);
+        pthread_cond_destroy(&sh->can_consume);
+        pthread_mutex_destroy(&sh->mutex);
+        free(sh->buffer);
+    }
+    free(q->shards);
+    q->shards = NULL;
+}
+
+static int init_shard(QueueShard *sh, int size) {
+    sh->buffer = malloc((size_t)size * sizeof(Message *));
+    if (!sh->buffer) return -1;
+    if (pthread_mutex_init(&sh->mutex, NULL) != 0) {
+        free(sh->buffer);
+        return -1;
+    }
+    if (init_cond_monotonic(&sh->can_consume) != 0) {
+        pthread_mutex_destroy(&sh->mutex);
+        free(sh->buffer);
+        return -1;
+    }
+    if (init_cond_monotonic(&sh->can_produce) != 0) {
+        pthread_cond_destroy(&sh->can_consume);
+        pthread_mutex_destroy(&sh->mutex);
+        free(sh->buffer);
+        return -1;
+    }
+    atomic_init(&sh->added, 0);
+    atomic_init(&sh->extracted, 0);
+    atomic_init(&sh->stolen, 0);
+    atomic_init(&sh->count_hint, 0);
+    atomic_init(&sh->owner_active, 0);
+    return 0;
+}
+
+// Счётчик шарда пишет только держатель его мьютекса, поэтому хватает
+// обычных чтения и записи без атомарного сложения.
+static void counter_add(atomic_long *c, long k) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + k, memory_order_relaxed);
+}
+
+int init_queue_shard(CircularQueue_Shard *q, int size, shard_policy_t policy) {
+    if (size <= 0) {
+        fprintf(stderr, "Invalid queue size %d (Shard)\n", size);
+        return -1;
+    }
+    q->shards = aligned_alloc(CACHE_LINE, MAX_THREADS * sizeof(QueueShard));
+    if (!q->shards) {
+        perror("Failed to allocate shards");
+        return -1;
+    }
+    memset(q->shards, 0, MAX_THREADS * sizeof(QueueShard));
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        if (init_shard(&q->shards[i], size) != 0) {
+            perror("Failed to initialize shard");
+            destroy_shards(q, i);
+            return -1;
+        }
+    }
+    q->shard_capacity = size;
+    q->policy = policy;
+    atomic_init(&q->shard_limit, 0);
+    atomic_init(&q->full_waits, 0);
+    atomic_init(&q->empty_waits, 0);
+    atomic_init(&q->steals, 0);
+    atomic_init(&q->orphaned, 0);
+    return 0;
+}
+
+// Под мьютексом шарда.
+static void set_orphan(CircularQueue_Shard *q, QueueShard *sh, int orphan) {
+    if (sh->orphan == orphan) return;
+    sh->orphan = orphan;
+    atomic_fetch_add(&q->orphaned, orphan ? 1 : -1);
+}
+
+void shard_attach(CircularQueue_Shard *q, int id) {
+    QueueShard *sh = &q->shards[id];
+    pthread_mutex_lock(&sh->mutex);
+    atomic_store(&sh->owner_active, 1);
+    set_orphan(q, sh, 0);
+    pthread_mutex_unlock(&sh->mutex);
+    int limit = atomic_load(&q->shard_limit);
+    while (limit <= id && !atomic_compare_exchange_weak(&q->shard_limit, &limit, id + 1)) {}
+}
+
+void shard_detach(CircularQueue_Shard *q, int id) {
+    QueueShard *sh = &q->shards[id];
+    pthread_mutex_lock(&sh->mutex);
+    atomic_store(&sh->owner_active, 0);
+    int left = sh->count;
+    if (left > 0) set_orphan(q, sh, 1);
+    pthread_mutex_unlock(&sh->mutex);
+    if (left == 0) return;
+
+    // В шарде остались сообщения - будим остальных владельцев, чтобы они их
+    // забрали. Под мьютексом шарда: иначе сигнал мог бы проскочить до сна.
+    int limit = atomic_load(&q->shard_limit);
+    for (int i = 0; i < limit; ++i) {
+        QueueShard *other = &q->shards[i];
+        if (i == id || !atomic_load(&other->owner_active)) continue;
+        pthread_mutex_lock(&other->mutex);
+        pthread_cond_broadcast(&other->can_consume);
+        pthread_mutex_unlock(&other->mutex);
+    }
+}
+
+// Шард работающего потребителя, начиная с выбранного политикой; если
+// работающих нет, сообщение ждёт в выбранном шарде вора или владельца.
+static int pick_shard(CircularQueue_Shard *q, const Message *msg) {
+    int limit = atomic_load_explicit(&q->shard_limit, memory_order_relaxed);
+    if (limit == 0) return 0;
+    unsigned int start = (q->policy == SHARD_BY_TYPE ? msg->type : rr_next++) % (unsigned int)limit;
+    for (int i = 0; i < limit; ++i) {
+        int s = (int)((start + i) % limit);
+        if (atomic_load_explicit(&q->shards[s].owner_active, memory_order_relaxed)) return s;
+    }
+    return (int)start;
+}
+
+static void push_shard(CircularQueue_Shard *q, QueueShard *sh, Message *msg) {
+    sh->buffer[sh->tail] = msg;
+    sh->tail = (sh->tail + 1) % q->shard_capacity;
+    sh->count++;
+    counter_add(&sh->added, 1);
+    atomic_store_explicit(&sh->count_hint, sh->count, memory_order_relaxed);
+    if (!atomic_load_explicit(&sh->owner_active, memory_order_relaxed)) set_orphan(q, sh, 1);
+    pthread_cond_signal(&sh->can_consume);
+}
+
+int enqueue_shard(CircularQueue_Shard *q, Message *msg, const struct timespec *deadline) {
+    int s = pick_shard(q, msg);
+    int limit = atomic_load_explicit(&q->shard_limit, memory_order_relaxed);
+
+    // Выбранный шард полон - пробуем шарды остальных владельцев.
+    for (int i = 0; i < (limit > 0 ? limit : 1); ++i) {
+        int idx = (s + i) % (limit > 0 ? limit : 1);
+        QueueShard *sh = &q->shards[idx];
+        if (i > 0 && !atomic_load_explicit(&sh->owner_active, memory_order_relaxed)) continue;
+        pthread_mutex_lock(&sh->mutex);
+        if (sh->count < q->shard_capacity) {
+            push_shard(q, sh, msg);
+            pthread_mutex_unlock(&sh->mutex);
+            return QUEUE_OK;
+        }
+        pthread_mutex_unlock(&sh->mutex);
+    }
+
+    // Полны все - ждём места в выбранном.
+    QueueShard *sh = &q->shards[s];
+    int rc = QUEUE_OK;
+    pthread_mutex_lock(&sh->mutex);
+    if (sh->count >= q->shard_capacity) {
+        atomic_fetch_add_explicit(&q->full_waits, 1, memory_order_relaxed);
+    }
+    while (sh->count >= q->shard_capacity && keep_running) {
+        rc = cond_wait_deadline(&sh->can_produce, &sh->mutex, deadline);
+        if (rc != QUEUE_OK) break;
+    }
+    if (sh->count >= q->shard_capacity) {
+        pthread_mutex_unlock(&sh->mutex);
+        return rc != QUEUE_OK ? rc : QUEUE_TIMEOUT;
+    }
+    push_shard(q, sh, msg);
+    pthread_mutex_unlock(&sh->mutex);
+    return QUEUE_OK;
+}
+
+static void after_take(CircularQueue_Shard *q, QueueShard *sh, int k) {
+    sh->count -= k;
+    if (sh->count == 0) set_orphan(q, sh, 0);
+    counter_add(&sh->extracted, k);
+    atomic_store_explicit(&sh->count_hint, sh->count, memory_order_relaxed);
+    if (k > 1) {
+        pthread_cond_broadcast(&sh->can_produce);
+    } else {
+        pthread_cond_signal(&sh->can_produce);
+    }
+}
+
+// Крадёт до n сообщений (не больше половины) из хвоста самого загруженного
+// чужого шарда; владелец тем временем берёт из головы.
+static int steal_shard(CircularQueue_Shard *q, int id, Message **msgs, int n) {
+    int limit = atomic_load_explicit(&q->shard_limit, memory_order_relaxed);
+    int victim = -1, best = 0;
+    for (int i = 0; i < limit; ++i) {
+        if (i == id) continue;
+        int c = atomic_load_explicit(&q->shards[i].count_hint, memory_order_relaxed);
+        if (c > best) {
+            best = c;
+            victim = i;
+        }
+    }
+    if (victim < 0) return 0;
+
+    QueueShard *sh = &q->shards[victim];
+    pthread_mutex_lock(&sh->mutex);
+    int k = (sh->count + 1) / 2;
+    if (k > n) k = n;
+    for (int i = 0; i < k; ++i) {
+        sh->tail = (sh->tail - 1 + q->shard_capacity) % q->shard_capacity;
+        msgs[i] = sh->buffer[sh->tail];
+    }
+    counter_add(&sh->stolen, k);
+    if (k > 0) after_take(q, sh, k);
+    pthread_mutex_unlock(&sh->mutex);
+
+    if (k > 0) atomic_fetch_add_explicit(&q->steals, 1, memory_order_relaxed);
+    return k;
+}
+
+// Берёт до n сообщений из головы первого шарда без владельца.
+static int take_orphan(CircularQueue_Shard *q, Message **msgs, int n) {
+    int limit = atomic_load_explicit(&q->shard_limit, memory_order_relaxed);
+    for (int i = 0; i < limit; ++i) {
+        QueueShard *sh = &q->shards[i];
+        if (atomic_load_explicit(&sh->owner_active, memory_order_relaxed) ||
+            atomic_load_explicit(&sh->count_hint, memory_order_relaxed) == 0) continue;
+        pthread_mutex_lock(&sh->mutex);
+        int k = 0;
+        if (sh->orphan) {
+            k = sh->count < n ? sh->count : n;
+            for (int j = 0; j < k; ++j) {
+                msgs[j] = sh->buffer[sh->head];
+                sh->head = (sh->head + 1) % q->shard_capacity;
+            }
+            if (k > 0) after_take(q, sh, k);
+        }
+        pthread_mutex_unlock(&sh->mutex);
+        if (k > 0) return k;
+    }
+    return 0;
+}
+
+static int others_have_work(CircularQueue_Shard *q, int id) {
+    int limit = atomic_load_explicit(&q->shard_limit, memory_order_relaxed);
+    for (int i = 0; i < limit; ++i) {
+        if (i != id && atomic_load_explicit(&q->shards[i].count_hint, memory_order_relaxed) > 0) return 1;
+    }
+    return 0;
+}
+
+int dequeue_batch_shard(CircularQueue_Shard *q, int id, Message **msgs, int n, const struct timespec *deadline) {
+    QueueShard *home = &q->shards[id];
+    int waited = 0;
+    for (;;) {
+        if (atomic_load_explicit(&q->orphaned, memory_order_relaxed) > 0) {
+            int k = take_orphan(q, msgs, n);
+            if (k > 0) return k;
+        }
+
+        pthread_mutex_lock(&home->mutex);
+        if (home->count > 0) {
+            int k = home->count < n ? home->count : n;
+            for (int i = 0; i < k; ++i) {
+                msgs[i] = home->buffer[home->head];
+                home->head = (home->head + 1) % q->shard_capacity;
+            }
+            after_take(q, home, k);
+            pthread_mutex_unlock(&home->mutex);
+            return k;
+        }
+        pthread_mutex_unlock(&home->mutex);
+
+        int k = steal_shard(q, id, msgs, n);
+        if (k > 0) return k;
+        if (!keep_running) return QUEUE_TIMEOUT;
+
+        // Спим до дедлайна, а пока в чужих шардах есть работа - недолго,
+        // чтобы снова попробовать украсть.
+        pthread_mutex_lock(&home->mutex);
+        if (home->count == 0) {
+            if (!waited) {
+                atomic_fetch_add_explicit(&q->empty_waits, 1, memory_order_relaxed);
+                waited = 1;
+            }
+            const struct timespec *until = deadline;
+            struct timespec poll;
+            if (others_have_work(q, id)) {
+                clock_gettime(CLOCK_MONOTONIC, &poll);
+                poll.tv_nsec += SHARD_IDLE_POLL_NS;
+                if (poll.tv_nsec >= 1000000000L) {
+                    poll.tv_sec++;
+                    poll.tv_nsec -= 1000000000L;
+                }
+                if (!deadline || poll.tv_sec < deadline->tv_sec ||
+                    (poll.tv_sec == deadline->tv_sec && poll.tv_nsec < deadline->tv_nsec)) {
+                    until = &poll;
+                }
+            }
+            int rc = cond_wait_deadline(&home->can_consume, &home->mutex, until);
+            if (rc == QUEUE_ERROR || (rc == QUEUE_TIMEOUT && until == deadline)) {
+                pthread_mutex_unlock(&home->mutex);
+                return rc;
+            }
+        }
+        pthread_mutex_unlock(&home->mutex);
+    }
+}
+
+int dequeue_shard(CircularQueue_Shard *q, int id, Message **msg, const struct timespec *deadline) {
+    int rc = dequeue_batch_shard(q, id, msg, 1, deadline);
+    return rc == 1 ? QUEUE_OK : rc;
+}
+
+void shard_get_totals(CircularQueue_Shard *q, shard_totals_t *t) {
+    memset(t, 0, sizeof(*t));
+    for (int i = 0; i < MAX_THREADS; ++i) pthread_mutex_lock(&q->shards[i].mutex);
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        QueueShard *sh = &q->shards[i];
+        t->count += sh->count;
+        t->total_added += atomic_load_explicit(&sh->added, memory_order_relaxed);
+        t->total_extracted += atomic_load_explicit(&sh->extracted, memory_order_relaxed);
+        t->stolen += atomic_load_explicit(&sh->stolen, memory_order_relaxed);
+        t->owners += atomic_load(&sh->owner_active);
+    }
+    for (int i = MAX_THREADS - 1; i >= 0; --i) pthread_mutex_unlock(&q->shards[i].mutex);
+    t->capacity = q->shard_capacity * t->owners;
+}
+
+void shard_read_totals(CircularQueue_Shard *q, shard_totals_t *t) {
+    memset(t, 0, sizeof(*t));
+    // Пока потребителей не было, сообщения ждут в шарде 0 (pick_shard).
+    int limit = atomic_load(&q->shard_limit);
+    if (limit == 0) limit = 1;
+    for (int i = 0; i < limit; ++i) {
+        QueueShard *sh = &q->shards[i];
+        t->count += atomic_load_explicit(&sh->count_hint, memory_order_relaxed);
+        t->total_added += atomic_load_explicit(&sh->added, memory_order_relaxed);
+        t->total_extracted += atomic_load_explicit(&sh->extracted, memory_order_relaxed);
+        t->stolen += atomic_load_explicit(&sh->stolen, memory_order_relaxed);
+        t->owners += atomic_load_explicit(&sh->owner_active, memory_order_relaxed);
+    }
+    t->capacity = q->shard_capacity * t->owners;
+}
+
+void destroy_queue_shard(CircularQueue_Shard *q) {
+    printf("Destroying queue (Shard)...\n");
+    int dropped = 0;
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        QueueShard *sh = &q->shards[i];
+        pthread_mutex_lock(&sh->mutex);
+        while (sh->count > 0) {
+            destroy_message(sh->buffer[sh->head]);
+            sh->head = (sh->head + 1) % q->shard_capacity;
+            sh->count--;
+            dropped++;
+        }
+        pthread_cond_broadcast(&sh->can_produce);
+        pthread_cond_broadcast(&sh->can_consume);
+        pthread_mutex_unlock(&sh->mutex);
+    }
+    if (dropped > 0) {
+        printf("Dropping %d messages left in the shards.\n", dropped);
+    }
+    destroy_shards(q, MAX_THREADS);
+    printf("Queue (Shard) destroyed.\n");
+}
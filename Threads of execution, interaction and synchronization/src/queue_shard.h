@@ -0,0 +1,88 @@
+#ifndef QUEUE_SHARD_H
+#define QUEUE_SHARD_H
+
+#include "message.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Сколько спит потребитель без работы, если в чужих шардах есть что
+// украсть, прежде чем проверить их снова.
+#define SHARD_IDLE_POLL_NS 1000000L
+
+// Шардированная очередь: у каждого потребителя свой шард - кольцо под своим
+// мьютексом. Производитель кладёт сообщение в шард одного из работающих
+// потребителей (по кругу или по Message.type), потребитель берёт из головы
+// своего шарда, а когда тот пуст - крадёт из хвоста самого загруженного
+// чужого шарда. Шарды ушедших потребителей разбираются раньше своего, по
+// порядку. Общего мьютекса нет; общие счётчики - суммы по шардам.
+typedef struct {
+    _Alignas(CACHE_LINE) pthread_mutex_t mutex;
+    pthread_cond_t can_consume;
+    pthread_cond_t can_produce;
+    Message **buffer;
+    int head;
+    int tail;
+    int count;
+    int orphan;             // владельца нет, а сообщения есть
+    // Меняются под мьютексом шарда, читаются без него (shard_read_totals).
+    atomic_long added;
+    atomic_long extracted;  // владельцем и ворами
+    atomic_long stolen;     // из них украдено
+    atomic_int count_hint;  // count для выбора жертвы и сумм без мьютекса
+    atomic_int owner_active;
+} QueueShard;
+
+typedef enum {
+    SHARD_ROUND_ROBIN,
+    SHARD_BY_TYPE
+} shard_policy_t;
+
+typedef struct {
+    QueueShard *shards;     // MAX_THREADS шардов, номер шарда - id потребителя
+    int shard_capacity;
+    atomic_int shard_limit; // шарды с номерами >= limit ещё ни разу не заняты
+    shard_policy_t policy;
+
+    atomic_long full_waits;
+    atomic_long empty_waits;
+    atomic_long steals;     // удачных краж (по вызовам, не по сообщениям)
+    atomic_int orphaned;    // шардов с orphan == 1: их разбирают в первую очередь
+} CircularQueue_Shard;
+
+typedef struct {
+    int capacity;           // суммарно по шардам
+    int count;
+    long total_added;
+    long total_extracted;
+    long stolen;
+    int owners;             // шардов с работающим потребителем
+} shard_totals_t;
+
+extern CircularQueue_Shard queue_shard;
+
+// size - ёмкость одного шарда.
+int init_queue_shard(CircularQueue_Shard *q, int size, shard_policy_t policy);
+void destroy_queue_shard(CircularQueue_Shard *q);
+
+// Потребитель id становится владельцем шарда id (и отпускает его на выходе;
+// оставшиеся там сообщения разберут воры).
+void shard_attach(CircularQueue_Shard *q, int id);
+void shard_detach(CircularQueue_Shard *q, int id);
+
+// deadline - абсолютное время CLOCK_MONOTONIC, NULL - ждать без ограничения.
+// Ожидание прерывается и при keep_running == 0.
+// Возвращают QUEUE_OK / QUEUE_TIMEOUT / QUEUE_ERROR.
+int enqueue_shard(CircularQueue_Shard *q, Message *msg, const struct timespec *deadline);
+// Пакет до n сообщений из своего шарда id, а если он пуст - из хвоста
+// чужого. Возвращает число сообщений либо QUEUE_TIMEOUT / QUEUE_ERROR.
+int dequeue_batch_shard(CircularQueue_Shard *q, int id, Message **msgs, int n, const struct timespec *deadline);
+int dequeue_shard(CircularQueue_Shard *q, int id, Message **msg, const struct timespec *deadline);
+
+// Точный срез: все шарды блокируются по порядку номеров. Только для 's'.
+void shard_get_totals(CircularQueue_Shard *q, shard_totals_t *t);
+// Суммы без мьютексов: каждый счётчик точен, но срез в целом может
+// разойтись на сообщения, переданные во время чтения. Для строк потоков.
+void shard_read_totals(CircularQueue_Shard *q, shard_totals_t *t);
+
+#endif
@@ -0,0 +1,53 @@
+#include "queue_stats.h"
+#include <sched.h>
+
+void queue_stats_init(queue_stats_t *st) {
+    atomic_init(&st->seq, 0);
+    atomic_init(&st->capacity, 0);
+    atomic_init(&st->count, 0);
+    atomic_init(&st->total_added, 0);
+    atomic_init(&st->total_extracted, 0);
+    atomic_init(&st->lock_ops, 0);
+    atomic_init(&st->slot_debt, 0);
+    atomic_init(&st->epoch, 0);
+    atomic_init(&st->segments, 0);
+}
+
+void queue_stats_publish(queue_stats_t *st, const queue_snapshot_t *s) {
+    unsigned seq = atomic_load_explicit(&st->seq, memory_order_relaxed);
+    atomic_store_explicit(&st->seq, seq + 1, memory_order_relaxed);
+    // Нечётный seq должен стать виден раньше любого из новых значений.
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&st->capacity, s->capacity, memory_order_relaxed);
+    atomic_store_explicit(&st->count, s->count, memory_order_relaxed);
+    atomic_store_explicit(&st->total_added, s->total_added, memory_order_relaxed);
+    atomic_store_explicit(&st->total_extracted, s->total_extracted, memory_order_relaxed);
+    atomic_store_explicit(&st->lock_ops, s->lock_ops, memory_order_relaxed);
+    atomic_store_explicit(&st->slot_debt, s->slot_debt, memory_order_relaxed);
+    atomic_store_explicit(&st->epoch, s->epoch, memory_order_relaxed);
+    atomic_store_explicit(&st->segments, s->segments, memory_order_relaxed);
+    atomic_store_explicit(&st->seq, seq + 2, memory_order_release);
+}
+
+void queue_stats_read(queue_stats_t *st, queue_snapshot_t *s) {
+    for (;;) {
+        unsigned before = atomic_load_explicit(&st->seq, memory_order_acquire);
+        if (before & 1) {
+            // Писатель посреди записи; на одном процессоре он не допишет,
+            // пока читатель не уступит ему время.
+            sched_yield();
+            continue;
+        }
+        s->capacity = atomic_load_explicit(&st->capacity, memory_order_relaxed);
+        s->count = atomic_load_explicit(&st->count, memory_order_relaxed);
+        s->total_added = atomic_load_explicit(&st->total_added, memory_order_relaxed);
+        s->total_extracted = atomic_load_explicit(&st->total_extracted, memory_order_relaxed);
+        s->lock_ops = atomic_load_explicit(&st->lock_ops, memory_order_relaxed);
+        s->slot_debt = atomic_load_explicit(&st->slot_debt, memory_order_relaxed);
+        s->epoch = atomic_load_explicit(&st->epoch, memory_order_relaxed);
+        s->segments = atomic_load_explicit(&st->segments, memory_order_relaxed);
+        // Все чтения полей - до повторного чтения seq.
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&st->seq, memory_order_relaxed) == before) return;
+    }
+}
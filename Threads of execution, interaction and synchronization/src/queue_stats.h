@@ -0,0 +1,45 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+#include "utils.h"
+#include <stdatomic.h>
+
+// Счётчики очереди для чтения без её мьютекса. Очередь пишет их под своим
+// мьютексом (писатель всегда один) в конце каждой операции; читатель
+// (show_status_*, регулятор ёмкости, поток мониторинга) берёт
+// согласованный снимок по seqlock: читает поля между двумя чтениями seq
+// и повторяет, если seq нечётный или изменился. Читатель ничего не
+// захватывает и не замедляет путь данных, кроме промаха по строке кэша
+// со счётчиками - поэтому блок выровнен по своей строке и не делит её
+// с мьютексом и кольцом очереди.
+
+typedef struct {
+    int capacity;
+    int count;
+    long total_added;
+    long total_extracted;
+    long lock_ops;
+    int slot_debt;              // только у очереди на семафорах
+    unsigned long epoch;
+    int segments;
+} queue_snapshot_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_uint seq;     // нечётный - идёт запись
+    atomic_int capacity;
+    atomic_int count;
+    atomic_long total_added;
+    atomic_long total_extracted;
+    atomic_long lock_ops;
+    atomic_int slot_debt;
+    atomic_ulong epoch;
+    atomic_int segments;
+} queue_stats_t;
+
+void queue_stats_init(queue_stats_t *st);
+// Только под мьютексом очереди.
+void queue_stats_publish(queue_stats_t *st, const queue_snapshot_t *s);
+// Из любого потока, без блокировок.
+void queue_stats_read(queue_stats_t *st, queue_snapshot_t *s);
+
+#endif
@@ -0,0 +1,54 @@
+#include "spin_wait.h"
+#include <unistd.h>
+
+static int enabled;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void spin_configure(spin_mode_t mode) {
+    // На одном процессоре кручение бесполезно: тот, кого ждём, не может
+    // выполняться, пока мы крутимся.
+    enabled = mode == SPIN_ON || (mode == SPIN_AUTO && sysconf(_SC_NPROCESSORS_ONLN) > 1);
+}
+
+int spin_enabled(void) {
+    return enabled;
+}
+
+void spin_policy_init(spin_policy_t *p) {
+    atomic_init(&p->estimate, SPIN_MIN);
+    atomic_init(&p->hits, 0);
+    atomic_init(&p->parks, 0);
+}
+
+int spin_budget(spin_policy_t *p) {
+    int budget = 2 * atomic_load_explicit(&p->estimate, memory_order_relaxed) + SPIN_MIN;
+    return budget < SPIN_MAX ? budget : SPIN_MAX;
+}
+
+int spin_wait(spin_policy_t *p, int (*ready)(void *arg), void *arg) {
+    if (ready(arg)) return 1;
+    if (!enabled) return 0;
+
+    int budget = spin_budget(p);
+    int est = atomic_load_explicit(&p->estimate, memory_order_relaxed);
+    for (int i = 1; i <= budget; ++i) {
+        cpu_relax();
+        if (ready(arg)) {
+            // Оценка - скользящее среднее с весом 1/8; гонки между потоками
+            // тут безвредны, теряется лишь одно обновление.
+            atomic_store_explicit(&p->estimate, est + (i - est) / 8, memory_order_relaxed);
+            atomic_fetch_add_explicit(&p->hits, 1, memory_order_relaxed);
+            return 1;
+        }
+    }
+    atomic_store_explicit(&p->estimate, est - est / 4, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->parks, 1, memory_order_relaxed);
+    return 0;
+}
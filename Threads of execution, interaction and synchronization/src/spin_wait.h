@@ -0,0 +1,37 @@
+#ifndef SPIN_WAIT_H
+#define SPIN_WAIT_H
+
+#include <stdatomic.h>
+
+// Гибридное ожидание: прежде чем уснуть на futex (sem_*wait,
+// pthread_cond_*wait), поток немного крутится с инструкцией pause, проверяя
+// условие. Бюджет кручения подстраивается под то, сколько обычно длится
+// ожидание: удачные кручения тянут оценку к своей длине, неудачные (всё
+// равно пришлось уснуть) уменьшают её - при длинных паузах поток почти
+// сразу засыпает, при коротких передача идёт без системных вызовов.
+#define SPIN_MIN 16         // итераций, даже если оценка нулевая
+#define SPIN_MAX 4096
+
+typedef enum {
+    SPIN_AUTO,              // крутиться, только если процессоров больше одного
+    SPIN_ON,
+    SPIN_OFF                // сразу засыпать, как раньше
+} spin_mode_t;
+
+typedef struct {
+    atomic_int estimate;    // средняя длина удачного кручения, итераций
+    atomic_long hits;       // дождались, не засыпая
+    atomic_long parks;      // бюджет вышел - ушли в futex
+} spin_policy_t;
+
+// Вызывать до запуска потоков.
+void spin_configure(spin_mode_t mode);
+int spin_enabled(void);
+
+void spin_policy_init(spin_policy_t *p);
+int spin_budget(spin_policy_t *p);
+// Крутится, пока ready(arg) не вернёт ненулевое, но не дольше бюджета.
+// 1 - условие выполнено (сразу или во время кручения), 0 - пора спать.
+int spin_wait(spin_policy_t *p, int (*ready)(void *arg), void *arg);
+
+#endif
@@ -1,424 +1,418 @@
 #include "thread_funcs.h"
 #include "message.h"
-#include "queue_sem.h"  
-#include "queue_cond.h" 
+#include "queue_sem.h"
+#include "queue_cond.h"
+#include "queue_mpmc.h"
+#include "queue_ring.h"
+#include "queue_shard.h"
+#include "queue_prio.h"
 #include "utils.h"
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
-#include <unistd.h> 
-#include <time.h>   
-#include <errno.h>  
-#include <pthread.h> 
-
-void* producer_thread_sem(void* arg) {
-    thread_arg_t *t_arg = (thread_arg_t *)arg;
-    int id = t_arg->id;
-    unsigned int seed = t_arg->seed; 
-    long messages_produced_by_thread = 0;
-
-    printf("Producer %d [Thread %lu]: Started (Semaphores).\n", id, pthread_self());
-
-    while (keep_running && producer_active[id]) {
-   
-        if (queue.resize_request != 0) {
-            struct timespec ts = {0, 10000000L}; 
-            nanosleep(&ts, NULL); 
-            continue; 
-        }
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+// Счётчики очереди для строк потоков.
+typedef struct {
+    long total_added;
+    long total_extracted;
+    int count;
+    int capacity;
+} lab_totals_t;
+
+// Очередь лабораторной для общих producer_thread / consumer_thread.
+// enqueue / dequeue возвращают число перемещённых сообщений, 0 - повторить,
+// либо QUEUE_TIMEOUT / QUEUE_ERROR.
+typedef struct {
+    const char *name;       // в строках запуска и выхода: "Semaphores", ...
+    const char *tag;        // в строках сообщений: "", " Cond", ...
+    int batched;            // пачками по batch_size, иначе поштучно
+    int show_type;          // печатать Message.type
+    int stop_on_error;      // ошибка ожидания останавливает всю лабораторную
+    const char *enqueue_error;  // для perror
+    const char *dequeue_error;
+    int (*enqueue)(Message **msgs, int n, const struct timespec *deadline);
+    // id - номер потребителя; *lane - полоса сообщения (если есть lane_names).
+    int (*dequeue)(int id, Message **msgs, int n, int *lane, const struct timespec *deadline);
+    // Очереди, хранящие сообщения в себе: место берётся reserve и
+    // заполняется на месте; прочитанное возвращается release (иначе -
+    // destroy_message).
+    Message *(*reserve)(uint8_t size_field, const struct timespec *deadline);
+    void (*commit)(Message *msg);
+    void (*release)(Message *msg);
+    // Итоги для строк потоков (необязательно).
+    void (*totals)(lab_totals_t *t);
+    // Полосы приоритета (необязательно): имена и полоса по типу.
+    const char *const *lane_names;
+    int (*lane_of)(uint8_t type);
+    // Вызываются в потоке потребителя до и после работы, и в любом потоке
+    // при выходе (разбудить остальных).
+    void (*consumer_start)(int id);
+    void (*consumer_stop)(int id);
+    void (*thread_exit)(void);
+} lab_engine_t;
+
+static void deadline_in_1s(struct timespec *ts) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += 1;
+}
 
-        struct timespec wait_time;
-        clock_gettime(CLOCK_REALTIME, &wait_time); 
-        wait_time.tv_sec += 1;
-        if (sem_timedwait(&queue.empty_slots, &wait_time) == -1) {
-             if (errno == ETIMEDOUT) {
-                 if (!keep_running || !producer_active[id]) break;
-                 continue;
-             } else {
-                 perror("Producer sem_timedwait(empty)");
-                 producer_active[id] = 0;
-                 break;
-             }
-        }
+static void sleep_ns(long ns) {
+    struct timespec ts = {ns / 1000000000L, ns % 1000000000L};
+    nanosleep(&ts, NULL);
+}
 
-        if (!keep_running || !producer_active[id]) {
-             sem_post(&queue.empty_slots);
-             break;
-        }
+// Пауза после каждого шага: время прочитать вывод и случайная "работа".
+static void lab_pause(unsigned int *seed) {
+    sleep_ns(600000000L);
+    sleep_ns((rand_r(seed) % 1000 + 500) * 1000000L);
+}
 
-        Message *msg = create_message(&seed);
+// Дополняет пачку неотправленных сообщений до batch; возвращает её размер.
+static int fill_batch(const lab_engine_t *e, Message **msgs, int pending, int batch, unsigned int *seed, int id) {
+    while (pending < batch) {
+        Message *msg = create_message(seed);
         if (!msg) {
-            sem_post(&queue.empty_slots);
-            fprintf(stderr, "Producer %d: Failed to create message, skipping.\n", id);
-            struct timespec error_delay_psem = {0, 100000000L}; 
-            nanosleep(&error_delay_psem, NULL); 
-            continue;
-        }
-
-        pthread_mutex_lock(&queue.mutex);
-
-        if (queue.count >= queue.capacity || queue.resize_request != 0) {
-             pthread_mutex_unlock(&queue.mutex);
-             sem_post(&queue.empty_slots);
-             destroy_message(msg);
-             struct timespec retry_delay_psem = {0, 10000000L}; 
-             nanosleep(&retry_delay_psem, NULL); 
-             printf("Producer %d: Queue full or resize pending after creating message, retrying.\n", id);
-             continue;
+            fprintf(stderr, "Producer %d%s: Failed to create message, skipping.\n", id, e->tag);
+            break;
         }
-
-        queue.buffer[queue.tail] = msg;
-        queue.tail = (queue.tail + 1) % queue.capacity;
-        queue.count++;
-        queue.total_added++;
-        long current_total_added = queue.total_added;
-
-        pthread_mutex_unlock(&queue.mutex);
-        sem_post(&queue.filled_slots);
-
-        messages_produced_by_thread++;
-        printf("Producer %d: Added msg (size=%d). Total Added: %ld. Queue: %d/%d\n",
-               id, msg->size + 1, current_total_added, queue.count, queue.capacity);
-
-        struct timespec print_delay = {0, 600000000L};
-        nanosleep(&print_delay, NULL);
-        long sleep_ns_psem = (rand_r(&seed) % 1000 + 500) * 1000000L;
-        struct timespec work_delay_psem = {sleep_ns_psem / 1000000000L, sleep_ns_psem % 1000000000L};
-        nanosleep(&work_delay_psem, NULL); 
+        msgs[pending++] = msg;
     }
-
-    producer_active[id] = 0;
-    printf("Producer %d [Thread %lu]: Exiting (Semaphores). Produced %ld messages.\n", id, pthread_self(), messages_produced_by_thread);
-    free(arg);
-    return NULL;
+    return pending;
 }
 
-void* consumer_thread_sem(void* arg) {
-    thread_arg_t *t_arg = (thread_arg_t *)arg;
-    int id = t_arg->id;
-    unsigned int seed = t_arg->seed;
-    long messages_consumed_by_thread = 0;
-
-    printf("Consumer %d [Thread %lu]: Started (Semaphores).\n", id, pthread_self());
-
-    while (keep_running && consumer_active[id]) {
-
-        pthread_mutex_lock(&queue.mutex);
-        int resize_req = queue.resize_request;
-        int new_cap = queue.new_capacity_request;
-
-        if (resize_req != 0) {
-            printf("Consumer %d: Detected resize request (%d) to %d.\n", id, resize_req, new_cap);
-            if (resize_queue_internal_sem(&queue, new_cap) == 0) {
-                queue.resize_request = 0;
-                printf("Consumer %d: Resize successful.\n", id);
-            } else {
-                queue.resize_request = 0;
-                printf("Consumer %d: Resize failed, clearing request.\n", id);
-            }
-            pthread_mutex_unlock(&queue.mutex);
-            continue;
-        }
-        pthread_mutex_unlock(&queue.mutex);
-
-        struct timespec wait_time;
-        clock_gettime(CLOCK_REALTIME, &wait_time); 
-        wait_time.tv_sec += 1;
-        if (sem_timedwait(&queue.filled_slots, &wait_time) == -1) {
-             if (errno == ETIMEDOUT) {
-                  if (!keep_running || !consumer_active[id]) break;
-                  continue;
-             } else {
-                 perror("Consumer sem_timedwait(filled)");
-                 consumer_active[id] = 0;
-                 break;
-             }
-        }
-
-        if (!keep_running || !consumer_active[id]) {
-             sem_post(&queue.filled_slots);
-             break;
-        }
-
-        pthread_mutex_lock(&queue.mutex);
-
-        if (queue.resize_request == -1 && queue.count <= queue.new_capacity_request) {
-             printf("Consumer %d: Performing pending resize down request before consuming.\n", id);
-             if (resize_queue_internal_sem(&queue, queue.new_capacity_request) == 0) {
-                 queue.resize_request = 0;
-             } else {
-                 queue.resize_request = 0;
-                 printf("Consumer %d: Pending resize down failed.\n", id);
-             }
-             pthread_mutex_unlock(&queue.mutex);
-             sem_post(&queue.filled_slots);
-             continue;
-        }
-        else if (queue.resize_request == 1) {
-             printf("Consumer %d: Performing pending resize up request before consuming.\n", id);
-             if (resize_queue_internal_sem(&queue, queue.new_capacity_request) == 0) {
-                 queue.resize_request = 0;
-             } else {
-                 queue.resize_request = 0;
-                 printf("Consumer %d: Pending resize up failed.\n", id);
-             }
-             pthread_mutex_unlock(&queue.mutex);
-             sem_post(&queue.filled_slots);
-             continue;
-        }
-
-
-         if (queue.count == 0) {
-             pthread_mutex_unlock(&queue.mutex);
-             sem_post(&queue.filled_slots);
-             fprintf(stderr, "Consumer %d: Woke up but queue empty! Sem count should prevent this.\n", id);
-             continue;
-         }
-
-        Message *msg = queue.buffer[queue.head];
-        queue.head = (queue.head + 1) % queue.capacity;
-        queue.count--;
-        queue.total_extracted++;
-        long current_total_extracted = queue.total_extracted;
-        int current_count = queue.count;
-        int current_capacity = queue.capacity;
-
-        pthread_mutex_unlock(&queue.mutex);
-        sem_post(&queue.empty_slots);
-
-        if (msg) {
-            uint16_t expected_hash = msg->hash;
-            uint16_t actual_hash = calculate_hash(msg);
-            messages_consumed_by_thread++;
-            printf("Consumer %d: Got msg (size=%d). Hash %s. Total Extracted: %ld. Queue: %d/%d\n",
-                   id, msg->size + 1, (expected_hash == actual_hash ? "OK" : "FAIL!"),
-                   current_total_extracted, current_count, current_capacity);
-
-            if (expected_hash != actual_hash) {
-                 fprintf(stderr, "Consumer %d: HASH MISMATCH! Expected %04x, Got %04x\n", id, expected_hash, actual_hash);
-            }
+// Убирает из начала пачки sent отправленных сообщений.
+static int shift_batch(Message **msgs, int pending, int sent) {
+    memmove(msgs, msgs + sent, (size_t)(pending - sent) * sizeof(Message *));
+    return pending - sent;
+}
 
-            destroy_message(msg);
-        } else {
-             fprintf(stderr,"Consumer %d: ERROR - dequeued a NULL message!\n", id);
-        }
+// " (size=N[, type=T])[ to/from lane L]" - общая часть строк сообщений.
+static void describe_msg(const lab_engine_t *e, char *buf, size_t len, int size, int type, const char *dir, int lane) {
+    int n = snprintf(buf, len, e->show_type ? " (size=%d, type=%d)" : " (size=%d)", size, type);
+    if (e->lane_names && n >= 0 && (size_t)n < len) {
+        snprintf(buf + n, len - (size_t)n, " %s lane %s", dir, e->lane_names[lane]);
+    }
+}
 
-        struct timespec print_delay = {0, 600000000L};
-        nanosleep(&print_delay, NULL);
-        long sleep_ns_csem = (rand_r(&seed) % 1000 + 500) * 1000000L;
-        struct timespec work_delay_csem = {sleep_ns_csem / 1000000000L, sleep_ns_csem % 1000000000L};
-        nanosleep(&work_delay_csem, NULL); 
+static void print_added(const lab_engine_t *e, int id, int size, int type, const lab_totals_t *t) {
+    char what[64];
+    describe_msg(e, what, sizeof(what), size, type, "to", e->lane_of ? e->lane_of((uint8_t)type) : 0);
+    if (e->totals) {
+        printf("Producer %d%s: Added msg%s. Total Added: %ld. Queue: %d/%d\n",
+               id, e->tag, what, t->total_added, t->count, t->capacity);
+    } else {
+        printf("Producer %d%s: Added msg%s.\n", id, e->tag, what);
     }
+}
 
-    consumer_active[id] = 0;
-    printf("Consumer %d [Thread %lu]: Exiting (Semaphores). Consumed %ld messages.\n", id, pthread_self(), messages_consumed_by_thread);
-    free(arg);
-    return NULL;
+static void print_got(const lab_engine_t *e, int id, int size, int type, int lane, int hash_ok,
+                      const lab_totals_t *t) {
+    char what[64];
+    describe_msg(e, what, sizeof(what), size, type, "from", lane);
+    if (e->totals) {
+        printf("Consumer %d%s: Got msg%s. Hash %s. Total Extracted: %ld. Queue: %d/%d\n",
+               id, e->tag, what, hash_ok ? "OK" : "FAIL!", t->total_extracted, t->count, t->capacity);
+    } else {
+        printf("Consumer %d%s: Got msg%s. Hash %s.\n", id, e->tag, what, hash_ok ? "OK" : "FAIL!");
+    }
 }
 
-void* producer_thread_cond(void* arg) {
+static void* producer_thread(const lab_engine_t *e, void* arg) {
     thread_arg_t *t_arg = (thread_arg_t *)arg;
     int id = t_arg->id;
     unsigned int seed = t_arg->seed;
     long messages_produced_by_thread = 0;
 
-    printf("Producer %d [Thread %lu]: Started (Cond Var).\n", id, pthread_self());
+    printf("Producer %d [Thread %lu]: Started (%s).\n", id, pthread_self(), e->name);
 
+    Message *msgs[MAX_BATCH];
+    int pending = 0;
     while (keep_running && producer_active[id]) {
-        pthread_mutex_lock(&queue_cond.mutex);
-
+        int sizes[MAX_BATCH], types[MAX_BATCH];
+        int rc;
         struct timespec wait_time;
-        clock_gettime(CLOCK_REALTIME, &wait_time); 
-        wait_time.tv_sec += 1;
-
-        while ((queue_cond.count == queue_cond.capacity || queue_cond.resize_request != 0 || queue_cond.resize_in_progress) && keep_running && producer_active[id]) {
-            int wait_result = pthread_cond_timedwait(&queue_cond.can_produce, &queue_cond.mutex, &wait_time);
-            if (wait_result == ETIMEDOUT) {
-                break;
-            } else if (wait_result != 0) {
-                perror("Producer pthread_cond_timedwait");
-                keep_running = 0;
-                producer_active[id] = 0;
+        deadline_in_1s(&wait_time);
+
+        if (e->reserve) {
+            // Сообщение пишется прямо в очередь; до commit его не видят.
+            uint8_t size_field = rand_r(&seed) % (MAX_DATA_SIZE + 1);
+            Message *msg = e->reserve(size_field, &wait_time);
+            if (!msg) continue;
+            fill_message(msg, &seed, size_field);
+            sizes[0] = size_field + 1;
+            types[0] = msg->type;
+            e->commit(msg);
+            rc = 1;
+        } else {
+            pending = fill_batch(e, msgs, pending, e->batched ? batch_size : 1, &seed, id);
+            if (pending == 0) {
+                sleep_ns(100000000L);
+                continue;
+            }
+            // После enqueue сообщения принадлежат очереди - поля запоминаются заранее.
+            for (int i = 0; i < pending; ++i) {
+                sizes[i] = msgs[i]->size + 1;
+                types[i] = msgs[i]->type;
+            }
+            rc = e->enqueue(msgs, pending, &wait_time);
+            if (rc == QUEUE_TIMEOUT) {
+                continue;
+            } else if (rc == 0) {
+                printf("Producer %d%s: Queue was shrunk, retrying.\n", id, e->tag);
+                continue;
+            } else if (rc == QUEUE_ERROR) {
+                perror(e->enqueue_error);
+                if (e->stop_on_error) keep_running = 0;
                 break;
             }
-            clock_gettime(CLOCK_REALTIME, &wait_time); 
-            wait_time.tv_sec += 1;
+            pending = shift_batch(msgs, pending, rc);
         }
 
-        if (!keep_running || !producer_active[id]) {
-            pthread_mutex_unlock(&queue_cond.mutex);
-            break;
-        }
-
-        if (queue_cond.count == queue_cond.capacity || queue_cond.resize_request != 0 || queue_cond.resize_in_progress) {
-             pthread_mutex_unlock(&queue_cond.mutex);
-             struct timespec retry_delay_pcond = {0, 10000000L}; 
-             nanosleep(&retry_delay_pcond, NULL); 
-             continue;
-        }
-
-        Message *msg = create_message(&seed);
-        if (!msg) {
-            pthread_mutex_unlock(&queue_cond.mutex);
-            fprintf(stderr, "Producer %d Cond: Failed to create message, skipping.\n", id);
-            struct timespec error_delay_pcond = {0, 100000000L}; 
-            nanosleep(&error_delay_pcond, NULL);
-            continue;
+        lab_totals_t totals = {0};
+        if (e->totals) e->totals(&totals);
+        for (int i = 0; i < rc; ++i) {
+            print_added(e, id, sizes[i], types[i], &totals);
         }
-
-        queue_cond.buffer[queue_cond.tail] = msg;
-        queue_cond.tail = (queue_cond.tail + 1) % queue_cond.capacity;
-        queue_cond.count++;
-        queue_cond.total_added++;
-        long current_total_added = queue_cond.total_added;
-
-        pthread_cond_signal(&queue_cond.can_consume);
-        pthread_mutex_unlock(&queue_cond.mutex);
-
-        messages_produced_by_thread++;
-        printf("Producer %d Cond: Added msg (size=%d). Total Added: %ld. Queue: %d/%d\n",
-               id, msg->size + 1, current_total_added, queue_cond.count, queue_cond.capacity);
-
-        struct timespec print_delay = {0, 600000000L}; 
-        nanosleep(&print_delay, NULL);
-        long sleep_ns_pcond = (rand_r(&seed) % 1000 + 500) * 1000000L;
-        struct timespec work_delay_pcond = {sleep_ns_pcond / 1000000000L, sleep_ns_pcond % 1000000000L};
-        nanosleep(&work_delay_pcond, NULL);
+        messages_produced_by_thread += rc;
+        lab_pause(&seed);
     }
 
+    for (int i = 0; i < pending; ++i) destroy_message(msgs[i]);
     producer_active[id] = 0;
-    printf("Producer %d [Thread %lu]: Exiting (Cond Var). Produced %ld messages.\n", id, pthread_self(), messages_produced_by_thread);
-
-    pthread_mutex_lock(&queue_cond.mutex);
-    pthread_cond_broadcast(&queue_cond.can_produce);
-    pthread_cond_broadcast(&queue_cond.can_consume);
-    pthread_mutex_unlock(&queue_cond.mutex);
+    printf("Producer %d [Thread %lu]: Exiting (%s). Produced %ld messages.\n", id, pthread_self(), e->name, messages_produced_by_thread);
+    if (e->thread_exit) e->thread_exit();
     free(arg);
     return NULL;
 }
 
-void* consumer_thread_cond(void* arg) {
+static void* consumer_thread(const lab_engine_t *e, void* arg) {
     thread_arg_t *t_arg = (thread_arg_t *)arg;
     int id = t_arg->id;
     unsigned int seed = t_arg->seed;
     long messages_consumed_by_thread = 0;
 
-    printf("Consumer %d [Thread %lu]: Started (Cond Var).\n", id, pthread_self());
+    if (e->consumer_start) e->consumer_start(id);
+    printf("Consumer %d [Thread %lu]: Started (%s).\n", id, pthread_self(), e->name);
 
     while (keep_running && consumer_active[id]) {
-         pthread_mutex_lock(&queue_cond.mutex);
-
-        if (queue_cond.resize_request != 0 && !queue_cond.resize_in_progress) {
-             int new_cap = queue_cond.new_capacity_request;
-             int request_type = queue_cond.resize_request;
-             int can_resize_now = 0;
-
-             if (request_type == 1) {
-                 can_resize_now = 1;
-             } else if (request_type == -1) {
-                 if (queue_cond.count <= new_cap) {
-                      can_resize_now = 1;
-                 }
-             }
-
-             if (can_resize_now) {
-                 printf("Consumer %d Cond: Attempting resize request (%d) to %d\n", id, request_type, new_cap);
-                 if (resize_queue_internal_cond(&queue_cond, new_cap) == 0) {
-                     queue_cond.resize_request = 0;
-                     printf("Consumer %d Cond: Resize successful.\n", id);
-                 } else {
-                     queue_cond.resize_request = 0;
-                     printf("Consumer %d Cond: Resize failed.\n", id);
-                 }
-                 pthread_mutex_unlock(&queue_cond.mutex);
-                 struct timespec resize_delay_ccond = {0, 5000000L}; 
-                 nanosleep(&resize_delay_ccond, NULL); 
-                 continue;
-             }
+        Message *msgs[MAX_BATCH];
+        int lane = 0;
+        struct timespec wait_time;
+        deadline_in_1s(&wait_time);
+        int rc = e->dequeue(id, msgs, e->batched ? batch_size : 1, &lane, &wait_time);
+        if (rc == QUEUE_TIMEOUT || rc == 0) {
+            continue;
+        } else if (rc == QUEUE_ERROR) {
+            perror(e->dequeue_error);
+            if (e->stop_on_error) keep_running = 0;
+            break;
         }
 
-         struct timespec wait_time;
-         clock_gettime(CLOCK_REALTIME, &wait_time); 
-         wait_time.tv_sec += 1;
-
-         while (queue_cond.count == 0 && keep_running && consumer_active[id]) {
-              int wait_result = pthread_cond_timedwait(&queue_cond.can_consume, &queue_cond.mutex, &wait_time);
-              if (wait_result == ETIMEDOUT) {
-                  break;
-              } else if (wait_result != 0) {
-                   perror("Consumer pthread_cond_timedwait");
-                   keep_running = 0;
-                   consumer_active[id] = 0;
-                   break;
-              }
-             clock_gettime(CLOCK_REALTIME, &wait_time); 
-             wait_time.tv_sec += 1;
-         }
-
-         if (!keep_running || !consumer_active[id]) {
-             pthread_mutex_unlock(&queue_cond.mutex);
-             break;
-         }
+        // Сначала проверка и возврат всей пачки (место в кольце освобождается
+        // сразу), потом итоги и печать.
+        int sizes[MAX_BATCH], types[MAX_BATCH], hash_ok[MAX_BATCH];
+        for (int i = 0; i < rc; ++i) {
+            Message *msg = msgs[i];
+            if (!msg) continue;
+            uint16_t expected_hash = msg->hash;
+            uint16_t actual_hash = calculate_hash(msg);
+            sizes[i] = msg->size + 1;
+            types[i] = msg->type;
+            hash_ok[i] = expected_hash == actual_hash;
+            if (!hash_ok[i]) {
+                fprintf(stderr, "Consumer %d%s: HASH MISMATCH! Expected %04x, Got %04x\n", id, e->tag, expected_hash, actual_hash);
+            }
+            if (e->release) {
+                e->release(msg);
+            } else {
+                destroy_message(msg);
+            }
+        }
 
-         if (queue_cond.count == 0) {
-              pthread_mutex_unlock(&queue_cond.mutex);
-              struct timespec retry_delay_ccond = {0, 10000000L}; 
-              nanosleep(&retry_delay_ccond, NULL); 
-              continue;
-         }
+        lab_totals_t totals = {0};
+        if (e->totals) e->totals(&totals);
+        for (int i = 0; i < rc; ++i) {
+            if (!msgs[i]) {
+                fprintf(stderr, "Consumer %d%s: ERROR - dequeued a NULL message!\n", id, e->tag);
+                continue;
+            }
+            messages_consumed_by_thread++;
+            print_got(e, id, sizes[i], types[i], lane, hash_ok[i], &totals);
+        }
+        lab_pause(&seed);
+    }
 
-         Message *msg = queue_cond.buffer[queue_cond.head];
-         queue_cond.head = (queue_cond.head + 1) % queue_cond.capacity;
-         queue_cond.count--;
-         queue_cond.total_extracted++;
-         long current_total_extracted = queue_cond.total_extracted;
-         int current_count = queue_cond.count;
-         int current_capacity = queue_cond.capacity;
+    if (e->consumer_stop) e->consumer_stop(id);
+    consumer_active[id] = 0;
+    printf("Consumer %d [Thread %lu]: Exiting (%s). Consumed %ld messages.\n", id, pthread_self(), e->name, messages_consumed_by_thread);
+    if (e->thread_exit) e->thread_exit();
+    free(arg);
+    return NULL;
+}
 
-         pthread_cond_signal(&queue_cond.can_produce);
+static void totals_snapshot(const queue_snapshot_t *st, lab_totals_t *t) {
+    t->total_added = st->total_added;
+    t->total_extracted = st->total_extracted;
+    t->count = st->count;
+    t->capacity = st->capacity;
+}
 
-         if (queue_cond.resize_request == -1 && !queue_cond.resize_in_progress && queue_cond.count <= queue_cond.new_capacity_request) {
-              printf("Consumer %d Cond: Attempting pending decrease request after consuming.\n", id);
-              if (resize_queue_internal_cond(&queue_cond, queue_cond.new_capacity_request) == 0) {
-                   queue_cond.resize_request = 0;
-                   printf("Consumer %d Cond: Pending decrease successful.\n", id);
-              } else {
-                   queue_cond.resize_request = 0;
-                   printf("Consumer %d Cond: Pending decrease failed.\n", id);
-              }
-         }
+static int lab_enqueue_sem(Message **msgs, int n, const struct timespec *deadline) {
+    return enqueue_batch_sem(&queue, msgs, n, deadline);
+}
+static int lab_dequeue_sem(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)id;
+    (void)lane;
+    return dequeue_batch_sem(&queue, msgs, n, deadline);
+}
+static void lab_totals_sem(lab_totals_t *t) {
+    queue_snapshot_t st;
+    snapshot_queue_sem(&queue, &st);
+    totals_snapshot(&st, t);
+}
 
-         pthread_mutex_unlock(&queue_cond.mutex);
+static int lab_enqueue_cond(Message **msgs, int n, const struct timespec *deadline) {
+    return enqueue_batch_cond(&queue_cond, msgs, n, deadline);
+}
+static int lab_dequeue_cond(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)id;
+    (void)lane;
+    return dequeue_batch_cond(&queue_cond, msgs, n, deadline);
+}
+static void lab_totals_cond(lab_totals_t *t) {
+    queue_snapshot_t st;
+    snapshot_queue_cond(&queue_cond, &st);
+    totals_snapshot(&st, t);
+}
+// Ушедший поток будит остальных: они перепроверят keep_running и свои флаги.
+static void lab_exit_cond(void) {
+    pthread_mutex_lock(&queue_cond.mutex);
+    pthread_cond_broadcast(&queue_cond.can_produce);
+    pthread_cond_broadcast(&queue_cond.can_consume);
+    pthread_mutex_unlock(&queue_cond.mutex);
+}
 
-         if (msg) {
-             uint16_t expected_hash = msg->hash;
-             uint16_t actual_hash = calculate_hash(msg);
-             messages_consumed_by_thread++;
-             printf("Consumer %d Cond: Got msg (size=%d). Hash %s. Total Extracted: %ld. Queue: %d/%d\n",
-                    id, msg->size + 1, (expected_hash == actual_hash ? "OK" : "FAIL!"),
-                    current_total_extracted, current_count, current_capacity);
+// Кольцо MPMC не блокируется: на полном/пустом кольце ждём 10 мс и повторяем.
+static int lab_enqueue_mpmc(Message **msgs, int n, const struct timespec *deadline) {
+    (void)n;
+    (void)deadline;
+    if (enqueue_mpmc(&queue_mpmc, msgs[0]) == 0) return 1;
+    atomic_fetch_add_explicit(&queue_mpmc.full_waits, 1, memory_order_relaxed);
+    sleep_ns(10000000L);
+    return QUEUE_TIMEOUT;
+}
+static int lab_dequeue_mpmc(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)id;
+    (void)n;
+    (void)lane;
+    (void)deadline;
+    if (dequeue_mpmc(&queue_mpmc, &msgs[0]) == 0) return 1;
+    atomic_fetch_add_explicit(&queue_mpmc.empty_waits, 1, memory_order_relaxed);
+    sleep_ns(10000000L);
+    return QUEUE_TIMEOUT;
+}
+static void lab_totals_mpmc(lab_totals_t *t) {
+    t->total_added = (long)atomic_load(&queue_mpmc.enqueue_pos);
+    t->total_extracted = (long)atomic_load(&queue_mpmc.dequeue_pos);
+    t->count = count_mpmc(&queue_mpmc);
+    t->capacity = queue_mpmc.capacity;
+}
 
-             if (expected_hash != actual_hash) {
-                 fprintf(stderr, "Consumer %d Cond: HASH MISMATCH! Expected %04x, Got %04x\n", id, expected_hash, actual_hash);
-             }
-             destroy_message(msg);
-         } else {
-              fprintf(stderr,"Consumer %d Cond: ERROR - dequeued NULL message!\n", id);
-         }
+static Message *lab_reserve_ring(uint8_t size_field, const struct timespec *deadline) {
+    return ring_reserve(&queue_ring, size_field, deadline);
+}
+static void lab_commit_ring(Message *msg) { ring_commit(&queue_ring, msg); }
+static int lab_dequeue_ring(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)id;
+    (void)n;
+    (void)lane;
+    msgs[0] = ring_acquire(&queue_ring, deadline);
+    return msgs[0] ? 1 : QUEUE_TIMEOUT;
+}
+static void lab_release_ring(Message *msg) { ring_release(&queue_ring, msg); }
+static void lab_totals_ring(lab_totals_t *t) {
+    pthread_mutex_lock(&queue_ring.mutex);
+    t->total_added = queue_ring.total_added;
+    t->total_extracted = queue_ring.total_extracted;
+    t->count = queue_ring.count;
+    t->capacity = queue_ring.capacity;
+    pthread_mutex_unlock(&queue_ring.mutex);
+}
 
-         struct timespec print_delay = {0, 600000000L}; 
-         nanosleep(&print_delay, NULL);
-         long sleep_ns_ccond = (rand_r(&seed) % 1000 + 500) * 1000000L;
-         struct timespec work_delay_ccond = {sleep_ns_ccond / 1000000000L, sleep_ns_ccond % 1000000000L};
-         nanosleep(&work_delay_ccond, NULL);
-    }
+static int lab_enqueue_shard(Message **msgs, int n, const struct timespec *deadline) {
+    (void)n;
+    int rc = enqueue_shard(&queue_shard, msgs[0], deadline);
+    return rc == QUEUE_OK ? 1 : rc;
+}
+static int lab_dequeue_shard(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)n;
+    (void)lane;
+    int rc = dequeue_shard(&queue_shard, id, &msgs[0], deadline);
+    return rc == QUEUE_OK ? 1 : rc;
+}
+static void lab_totals_shard(lab_totals_t *t) {
+    shard_totals_t st;
+    shard_read_totals(&queue_shard, &st);
+    t->total_added = st.total_added;
+    t->total_extracted = st.total_extracted;
+    t->count = st.count;
+    t->capacity = st.capacity;
+}
+static void lab_start_shard(int id) { shard_attach(&queue_shard, id); }
+static void lab_stop_shard(int id) { shard_detach(&queue_shard, id); }
 
-    consumer_active[id] = 0;
-    printf("Consumer %d [Thread %lu]: Exiting (Cond Var). Consumed %ld messages.\n", id, pthread_self(), messages_consumed_by_thread);
+static int lab_enqueue_prio(Message **msgs, int n, const struct timespec *deadline) {
+    (void)n;
+    int rc = enqueue_prio(&queue_prio, msgs[0], deadline);
+    return rc == QUEUE_OK ? 1 : rc;
+}
+static int lab_dequeue_prio(int id, Message **msgs, int n, int *lane, const struct timespec *deadline) {
+    (void)id;
+    (void)n;
+    int rc = dequeue_prio(&queue_prio, &msgs[0], lane, deadline);
+    return rc == QUEUE_OK ? 1 : rc;
+}
 
-    pthread_mutex_lock(&queue_cond.mutex);
-    pthread_cond_broadcast(&queue_cond.can_produce);
-    pthread_cond_broadcast(&queue_cond.can_consume);
-    pthread_mutex_unlock(&queue_cond.mutex);
-    free(arg);
-    return NULL;
-}
\ No newline at end of file
+static const lab_engine_t lab_sem = {
+    .name = "Semaphores", .tag = "", .batched = 1,
+    .enqueue_error = "Producer sem_clockwait(empty)", .dequeue_error = "Consumer sem_clockwait(filled)",
+    .enqueue = lab_enqueue_sem, .dequeue = lab_dequeue_sem, .totals = lab_totals_sem};
+static const lab_engine_t lab_cond = {
+    .name = "Cond Var", .tag = " Cond", .batched = 1, .stop_on_error = 1,
+    .enqueue_error = "Producer pthread_cond_timedwait", .dequeue_error = "Consumer pthread_cond_timedwait",
+    .enqueue = lab_enqueue_cond, .dequeue = lab_dequeue_cond, .totals = lab_totals_cond,
+    .thread_exit = lab_exit_cond};
+static const lab_engine_t lab_mpmc = {
+    .name = "MPMC", .tag = " MPMC",
+    .enqueue = lab_enqueue_mpmc, .dequeue = lab_dequeue_mpmc, .totals = lab_totals_mpmc};
+static const lab_engine_t lab_ring = {
+    .name = "Ring", .tag = " Ring",
+    .reserve = lab_reserve_ring, .commit = lab_commit_ring,
+    .dequeue = lab_dequeue_ring, .release = lab_release_ring, .totals = lab_totals_ring};
+static const lab_engine_t lab_shard = {
+    .name = "Shard", .tag = " Shard", .show_type = 1,
+    .enqueue_error = "Producer shard pthread_cond_timedwait", .dequeue_error = "Consumer shard pthread_cond_timedwait",
+    .enqueue = lab_enqueue_shard, .dequeue = lab_dequeue_shard, .totals = lab_totals_shard,
+    .consumer_start = lab_start_shard, .consumer_stop = lab_stop_shard};
+static const lab_engine_t lab_prio = {
+    .name = "Prio", .tag = " Prio", .show_type = 1,
+    .enqueue_error = "Producer prio pthread_cond_timedwait", .dequeue_error = "Consumer prio pthread_cond_timedwait",
+    .enqueue = lab_enqueue_prio, .dequeue = lab_dequeue_prio,
+    .lane_names = prio_lane_names, .lane_of = prio_lane_of};
+
+void* producer_thread_sem(void* arg) { return producer_thread(&lab_sem, arg); }
+void* consumer_thread_sem(void* arg) { return consumer_thread(&lab_sem, arg); }
+void* producer_thread_cond(void* arg) { return producer_thread(&lab_cond, arg); }
+void* consumer_thread_cond(void* arg) { return consumer_thread(&lab_cond, arg); }
+void* producer_thread_mpmc(void* arg) { return producer_thread(&lab_mpmc, arg); }
+void* consumer_thread_mpmc(void* arg) { return consumer_thread(&lab_mpmc, arg); }
+void* producer_thread_ring(void* arg) { return producer_thread(&lab_ring, arg); }
+void* consumer_thread_ring(void* arg) { return consumer_thread(&lab_ring, arg); }
+void* producer_thread_shard(void* arg) { return producer_thread(&lab_shard, arg); }
+void* consumer_thread_shard(void* arg) { return consumer_thread(&lab_shard, arg); }
+void* producer_thread_prio(void* arg) { return producer_thread(&lab_prio, arg); }
+void* consumer_thread_prio(void* arg) { return consumer_thread(&lab_prio, arg); }
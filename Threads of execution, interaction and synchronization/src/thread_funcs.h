@@ -7,5 +7,13 @@ void* producer_thread_sem(void* arg);
 void* producer_thread_cond(void* arg);
 void* consumer_thread_sem(void* arg);
 void* consumer_thread_cond(void* arg);
+void* producer_thread_mpmc(void* arg);
+void* consumer_thread_mpmc(void* arg);
+void* producer_thread_ring(void* arg);
+void* consumer_thread_ring(void* arg);
+void* producer_thread_shard(void* arg);
+void* consumer_thread_shard(void* arg);
+void* producer_thread_prio(void* arg);
+void* consumer_thread_prio(void* arg);
 
 #endif
\ No newline at end of file
@@ -6,10 +6,34 @@ pthread_t producer_threads[MAX_THREADS];
 pthread_t consumer_threads[MAX_THREADS];
 volatile sig_atomic_t producer_active[MAX_THREADS] = {0};
 volatile sig_atomic_t consumer_active[MAX_THREADS] = {0};
-int producer_count = 0;
-int consumer_count = 0;
+atomic_int producer_count = 0;
+atomic_int consumer_count = 0;
 int next_producer_id = 0;
 int next_consumer_id = 0;
+volatile sig_atomic_t batch_size = 1;
+
+int init_cond_monotonic(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    if (pthread_condattr_init(&attr) != 0) return -1;
+    int rc = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (rc == 0) rc = pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return rc;
+}
+
+int cond_wait_deadline(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline) {
+    int rc = deadline ? pthread_cond_timedwait(cond, mutex, deadline) : pthread_cond_wait(cond, mutex);
+    if (rc == 0) return QUEUE_OK;
+    if (rc == ETIMEDOUT) return QUEUE_TIMEOUT;
+    errno = rc;
+    return QUEUE_ERROR;
+}
+
+long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
 
 int kbhit(void) {
     struct termios oldt, newt;
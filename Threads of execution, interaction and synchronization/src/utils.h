@@ -12,11 +12,20 @@
 #include <string.h>  
 #include <time.h>    
 #include <errno.h>  
+#include <stdatomic.h>
 
 #define _POSIX_C_SOURCE 200809L 
 #define INITIAL_QUEUE_SIZE 10     
 #define MAX_THREADS 100          
 #define MAX_DATA_SIZE 255   
+#define MAX_BATCH 16       // наибольший размер пачки enqueue_batch/dequeue_batch
+#define CACHE_LINE 64      // граница, по которой разносятся данные разных сторон очереди
+
+// Результаты enqueue_* / dequeue_*.
+#define QUEUE_OK 0
+#define QUEUE_TIMEOUT -1   // до дедлайна не появилось места / сообщения
+#define QUEUE_RETRY 1      // слоты ушли на уменьшение очереди или сигнал ложный, повторить
+#define QUEUE_ERROR -2     // ошибка ожидания, errno сохранён
 
 extern volatile sig_atomic_t keep_running;
 
@@ -31,12 +40,27 @@ extern pthread_t consumer_threads[MAX_THREADS];
 extern volatile sig_atomic_t producer_active[MAX_THREADS];
 extern volatile sig_atomic_t consumer_active[MAX_THREADS];
 
-extern int producer_count;
-extern int consumer_count;
+// Меняет только главный поток; атомарны, чтобы читать из любого потока.
+extern atomic_int producer_count;
+extern atomic_int consumer_count;
 
 extern int next_producer_id;
 extern int next_consumer_id;
 
+// Размер пачки для потоков очередей на семафорах и условных переменных
+// (1 - поштучно); переключается клавишей 'b'.
+extern volatile sig_atomic_t batch_size;
+
+// Условная переменная с дедлайнами по CLOCK_MONOTONIC: перевод часов не
+// сокращает и не растягивает ожидание. 0 - успех.
+int init_cond_monotonic(pthread_cond_t *cond);
+// Ожидание cond (созданной init_cond_monotonic) до дедлайна - абсолютного
+// времени CLOCK_MONOTONIC; NULL - без ограничения.
+// QUEUE_OK / QUEUE_TIMEOUT / QUEUE_ERROR (код ошибки - в errno).
+int cond_wait_deadline(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline);
+// Текущее время CLOCK_MONOTONIC в наносекундах.
+long monotonic_ns(void);
+
 int kbhit(void);        
 char getch_nonblock();
 